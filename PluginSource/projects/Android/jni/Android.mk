@@ -9,6 +9,12 @@ LOCAL_ARM_MODE := arm
 
 LOCAL_SRC_FILES += $(SRC_DIR)/RenderAPI.cpp
 LOCAL_SRC_FILES += $(SRC_DIR)/RenderingPlugin.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/VertexKernel.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/PluginProfiling.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/TextureProducer.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/PluginThreadPool.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/PlasmaKernel.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/CpuFeatures.cpp
 
 # OpenGL ES
 LOCAL_SRC_FILES += $(SRC_DIR)/RenderAPI_OpenGLCoreES.cpp
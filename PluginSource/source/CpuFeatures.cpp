@@ -0,0 +1,91 @@
+#include "CpuFeatures.h"
+#include "PlatformBase.h"
+
+#if SUPPORT_SSE2
+#	if defined(_MSC_VER)
+#		include <intrin.h>
+#	else
+#		include <cpuid.h>
+#	endif
+#endif
+
+
+#if SUPPORT_SSE2
+
+static void CpuId(int leaf, int subLeaf, unsigned int regs[4])
+{
+#	if defined(_MSC_VER)
+	int r[4];
+	__cpuidex(r, leaf, subLeaf);
+	regs[0] = r[0]; regs[1] = r[1]; regs[2] = r[2]; regs[3] = r[3];
+#	else
+	__cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#	endif
+}
+
+// Which register states the OS saves on context switches (XCR0)
+static unsigned long long ReadXCR0()
+{
+#	if defined(_MSC_VER)
+	return _xgetbv(0);
+#	else
+	unsigned int eax, edx;
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+#	endif
+}
+
+static unsigned int DetectCpuFeatures()
+{
+	unsigned int features = kCpuFeatureSSE2;
+
+	unsigned int regs[4];
+	CpuId(0, 0, regs);
+	const unsigned int maxLeaf = regs[0];
+	if (maxLeaf < 7)
+		return features;
+
+	CpuId(1, 0, regs);
+	const bool osxsave = (regs[2] & (1u << 27)) != 0;
+	const bool avx = (regs[2] & (1u << 28)) != 0;
+	const bool fma = (regs[2] & (1u << 12)) != 0;
+	if (!osxsave || !avx)
+		return features;
+
+	const unsigned long long xcr0 = ReadXCR0();
+	const bool osYmm = (xcr0 & 0x6) == 0x6; // XMM + YMM
+	const bool osZmm = (xcr0 & 0xE6) == 0xE6; // XMM + YMM + opmask + ZMM
+
+	CpuId(7, 0, regs);
+	const bool avx2 = (regs[1] & (1u << 5)) != 0;
+	const bool avx512f = (regs[1] & (1u << 16)) != 0;
+
+	if (osYmm && avx2 && fma)
+	{
+		features |= kCpuFeatureAVX2;
+		if (osZmm && avx512f)
+			features |= kCpuFeatureAVX512;
+	}
+	return features;
+}
+
+#else
+
+static unsigned int DetectCpuFeatures()
+{
+#	if SUPPORT_NEON
+	return kCpuFeatureNEON;
+#	else
+	return 0;
+#	endif
+}
+
+#endif // #if SUPPORT_SSE2
+
+
+unsigned int GetCpuFeatures()
+{
+	// Function local static initialization is thread safe
+	static const unsigned int s_Features = DetectCpuFeatures();
+	return s_Features;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// Runtime detection of the SIMD instruction sets the CPU (and OS) supports, used to pick
+// between code paths compiled for different instruction sets (SUPPORT_AVX2 etc. in PlatformBase.h).
+
+enum CpuFeatureFlags
+{
+	kCpuFeatureSSE2 = 1 << 0,
+	kCpuFeatureAVX2 = 1 << 1, // AVX2 + FMA, with OS support for YMM state
+	kCpuFeatureAVX512 = 1 << 2, // AVX-512F, with OS support for ZMM state
+	kCpuFeatureNEON = 1 << 3,
+};
+
+// Combination of CpuFeatureFlags; detected once, thread safe.
+unsigned int GetCpuFeatures();
@@ -0,0 +1,495 @@
+#include "PlasmaKernel.h"
+#include "CpuFeatures.h"
+#include "PlatformBase.h"
+#include "SimdMath.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <vector>
+
+
+// Reference version; this is exactly what ModifyTexturePixels originally did per pixel.
+static inline unsigned char PlasmaPixel(int x, int y, float t)
+{
+	// Simple "plasma effect": several combined sine waves
+	int vv = int(
+		(127.0f + (127.0f * sinf(x / 7.0f + t))) +
+		(127.0f + (127.0f * sinf(y / 5.0f - t))) +
+		(127.0f + (127.0f * sinf((x + y) / 6.0f - t))) +
+		(127.0f + (127.0f * sinf(sqrtf(float(x*x + y*y)) / 4.0f - t)))
+		) / 4;
+	return (unsigned char)vv;
+}
+
+static inline void PlasmaFillRowScalar(unsigned char* row, int x0, int x1, int y, float t)
+{
+	unsigned char* ptr = row + x0 * 4;
+	for (int x = x0; x < x1; ++x)
+	{
+		unsigned char vv = PlasmaPixel(x, y, t);
+
+		// Write the texture pixel
+		ptr[0] = vv;
+		ptr[1] = vv;
+		ptr[2] = vv;
+		ptr[3] = vv;
+
+		// To next pixel (our pixels are 4 bpp)
+		ptr += 4;
+	}
+}
+
+static void PlasmaFillScalar(unsigned char* pixels, int rowPitch, int x0, int y0, int x1, int y1, float t)
+{
+	for (int y = y0; y < y1; ++y)
+		PlasmaFillRowScalar(pixels + y * rowPitch, x0, x1, y, t);
+}
+
+
+// Vectorized versions: the y/5 term is the same for the whole row, so it is computed once
+// per row (together with the constant 4*127 part). Rest of the pixels that do not fill a whole
+// iteration are done with the reference code.
+
+
+#if SUPPORT_SSE2
+
+static inline __m128i PlasmaPixelsSSE2(__m128 x, float y, __m128 rowBase, __m128 y2, __m128 t)
+{
+	const __m128 sx = SinApproxSSE2(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.0f / 7.0f)), t));
+	const __m128 sxy = SinApproxSSE2(_mm_sub_ps(_mm_mul_ps(_mm_add_ps(x, _mm_set1_ps(y)), _mm_set1_ps(1.0f / 6.0f)), t));
+	const __m128 sr = SinApproxSSE2(_mm_sub_ps(_mm_mul_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), y2)), _mm_set1_ps(0.25f)), t));
+	const __m128 sum = _mm_add_ps(rowBase, _mm_mul_ps(_mm_set1_ps(127.0f), _mm_add_ps(_mm_add_ps(sx, sxy), sr)));
+
+	// Truncate, divide by 4 and replicate into all four channels
+	__m128i v = _mm_srli_epi32(_mm_cvttps_epi32(sum), 2);
+	v = _mm_or_si128(v, _mm_slli_epi32(v, 8));
+	return _mm_or_si128(v, _mm_slli_epi32(v, 16));
+}
+
+static void PlasmaFillSSE2(unsigned char* pixels, int rowPitch, int x0, int y0, int x1, int y1, float t)
+{
+	const __m128 vt = _mm_set1_ps(t);
+	for (int y = y0; y < y1; ++y)
+	{
+		unsigned char* row = pixels + y * rowPitch;
+		const float fy = float(y);
+		const __m128 rowBase = _mm_set1_ps(4.0f * 127.0f + 127.0f * sinf(fy / 5.0f - t));
+		const __m128 y2 = _mm_set1_ps(fy * fy);
+
+		__m128 vx = _mm_add_ps(_mm_set1_ps(float(x0)), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+		int x = x0;
+		for (; x + 8 <= x1; x += 8)
+		{
+			const __m128 vx4 = _mm_add_ps(vx, _mm_set1_ps(4.0f));
+			_mm_storeu_si128((__m128i*)(row + x * 4), PlasmaPixelsSSE2(vx, fy, rowBase, y2, vt));
+			_mm_storeu_si128((__m128i*)(row + x * 4 + 16), PlasmaPixelsSSE2(vx4, fy, rowBase, y2, vt));
+			vx = _mm_add_ps(vx, _mm_set1_ps(8.0f));
+		}
+		PlasmaFillRowScalar(row, x, x1, y, t);
+	}
+}
+
+#endif // #if SUPPORT_SSE2
+
+
+#if SUPPORT_AVX2
+
+SIMD_TARGET_AVX2 static void PlasmaFillAVX2(unsigned char* pixels, int rowPitch, int x0, int y0, int x1, int y1, float t)
+{
+	const __m256 vt = _mm256_set1_ps(t);
+	for (int y = y0; y < y1; ++y)
+	{
+		unsigned char* row = pixels + y * rowPitch;
+		const float fy = float(y);
+		const __m256 rowBase = _mm256_set1_ps(4.0f * 127.0f + 127.0f * sinf(fy / 5.0f - t));
+		const __m256 y2 = _mm256_set1_ps(fy * fy);
+		const __m256 vy = _mm256_set1_ps(fy);
+
+		__m256 vx = _mm256_add_ps(_mm256_set1_ps(float(x0)), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+		int x = x0;
+		for (; x + 8 <= x1; x += 8)
+		{
+			const __m256 sx = SinApproxAVX2(_mm256_fmadd_ps(vx, _mm256_set1_ps(1.0f / 7.0f), vt));
+			const __m256 sxy = SinApproxAVX2(_mm256_fmsub_ps(_mm256_add_ps(vx, vy), _mm256_set1_ps(1.0f / 6.0f), vt));
+			const __m256 sr = SinApproxAVX2(_mm256_fmsub_ps(_mm256_sqrt_ps(_mm256_fmadd_ps(vx, vx, y2)), _mm256_set1_ps(0.25f), vt));
+			const __m256 sum = _mm256_fmadd_ps(_mm256_set1_ps(127.0f), _mm256_add_ps(_mm256_add_ps(sx, sxy), sr), rowBase);
+
+			__m256i v = _mm256_srli_epi32(_mm256_cvttps_epi32(sum), 2);
+			v = _mm256_or_si256(v, _mm256_slli_epi32(v, 8));
+			v = _mm256_or_si256(v, _mm256_slli_epi32(v, 16));
+			_mm256_storeu_si256((__m256i*)(row + x * 4), v);
+
+			vx = _mm256_add_ps(vx, _mm256_set1_ps(8.0f));
+		}
+		PlasmaFillRowScalar(row, x, x1, y, t);
+	}
+}
+
+#endif // #if SUPPORT_AVX2
+
+
+#if SUPPORT_AVX512
+
+SIMD_TARGET_AVX512 static void PlasmaFillAVX512(unsigned char* pixels, int rowPitch, int x0, int y0, int x1, int y1, float t)
+{
+	const __m512 vt = _mm512_set1_ps(t);
+	for (int y = y0; y < y1; ++y)
+	{
+		unsigned char* row = pixels + y * rowPitch;
+		const float fy = float(y);
+		const __m512 rowBase = _mm512_set1_ps(4.0f * 127.0f + 127.0f * sinf(fy / 5.0f - t));
+		const __m512 y2 = _mm512_set1_ps(fy * fy);
+		const __m512 vy = _mm512_set1_ps(fy);
+
+		__m512 vx = _mm512_add_ps(_mm512_set1_ps(float(x0)), _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f));
+		int x = x0;
+		for (; x + 16 <= x1; x += 16)
+		{
+			const __m512 sx = SinApproxAVX512(_mm512_fmadd_ps(vx, _mm512_set1_ps(1.0f / 7.0f), vt));
+			const __m512 sxy = SinApproxAVX512(_mm512_fmsub_ps(_mm512_add_ps(vx, vy), _mm512_set1_ps(1.0f / 6.0f), vt));
+			const __m512 sr = SinApproxAVX512(_mm512_fmsub_ps(_mm512_sqrt_ps(_mm512_fmadd_ps(vx, vx, y2)), _mm512_set1_ps(0.25f), vt));
+			const __m512 sum = _mm512_fmadd_ps(_mm512_set1_ps(127.0f), _mm512_add_ps(_mm512_add_ps(sx, sxy), sr), rowBase);
+
+			__m512i v = _mm512_srli_epi32(_mm512_cvttps_epi32(sum), 2);
+			v = _mm512_or_si512(v, _mm512_slli_epi32(v, 8));
+			v = _mm512_or_si512(v, _mm512_slli_epi32(v, 16));
+			_mm512_storeu_si512((void*)(row + x * 4), v);
+
+			vx = _mm512_add_ps(vx, _mm512_set1_ps(16.0f));
+		}
+		PlasmaFillRowScalar(row, x, x1, y, t);
+	}
+}
+
+#endif // #if SUPPORT_AVX512
+
+
+#if SUPPORT_NEON
+
+static inline uint32x4_t PlasmaPixelsNEON(float32x4_t x, float32x4_t vy, float32x4_t rowBase, float32x4_t y2, float32x4_t t)
+{
+	const float32x4_t sx = SinApproxNEON(vmlaq_n_f32(t, x, 1.0f / 7.0f));
+	const float32x4_t sxy = SinApproxNEON(vsubq_f32(vmulq_n_f32(vaddq_f32(x, vy), 1.0f / 6.0f), t));
+	const float32x4_t sr = SinApproxNEON(vsubq_f32(vmulq_n_f32(SqrtNEON(vmlaq_f32(y2, x, x)), 0.25f), t));
+	const float32x4_t sum = vmlaq_n_f32(rowBase, vaddq_f32(vaddq_f32(sx, sxy), sr), 127.0f);
+
+	// Truncate, divide by 4 and replicate into all four channels
+	uint32x4_t v = vshrq_n_u32(vreinterpretq_u32_s32(vcvtq_s32_f32(sum)), 2);
+	v = vorrq_u32(v, vshlq_n_u32(v, 8));
+	return vorrq_u32(v, vshlq_n_u32(v, 16));
+}
+
+static void PlasmaFillNEON(unsigned char* pixels, int rowPitch, int x0, int y0, int x1, int y1, float t)
+{
+	static const float kLaneOffsets[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+	const float32x4_t vt = vdupq_n_f32(t);
+	for (int y = y0; y < y1; ++y)
+	{
+		unsigned char* row = pixels + y * rowPitch;
+		const float fy = float(y);
+		const float32x4_t rowBase = vdupq_n_f32(4.0f * 127.0f + 127.0f * sinf(fy / 5.0f - t));
+		const float32x4_t y2 = vdupq_n_f32(fy * fy);
+		const float32x4_t vy = vdupq_n_f32(fy);
+
+		float32x4_t vx = vaddq_f32(vdupq_n_f32(float(x0)), vld1q_f32(kLaneOffsets));
+		int x = x0;
+		for (; x + 8 <= x1; x += 8)
+		{
+			const float32x4_t vx4 = vaddq_f32(vx, vdupq_n_f32(4.0f));
+			vst1q_u32((uint32_t*)(row + x * 4), PlasmaPixelsNEON(vx, vy, rowBase, y2, vt));
+			vst1q_u32((uint32_t*)(row + x * 4 + 16), PlasmaPixelsNEON(vx4, vy, rowBase, y2, vt));
+			vx = vaddq_f32(vx, vdupq_n_f32(8.0f));
+		}
+		PlasmaFillRowScalar(row, x, x1, y, t);
+	}
+}
+
+#endif // #if SUPPORT_NEON
+
+
+PlasmaFillFunc GetPlasmaKernel(PlasmaKernelISA isa)
+{
+	const unsigned int features = GetCpuFeatures();
+	switch (isa)
+	{
+	case kPlasmaKernelScalar:
+		return PlasmaFillScalar;
+#	if SUPPORT_SSE2
+	case kPlasmaKernelSSE2:
+		return (features & kCpuFeatureSSE2) ? PlasmaFillSSE2 : NULL;
+#	endif
+#	if SUPPORT_AVX2
+	case kPlasmaKernelAVX2:
+		return (features & kCpuFeatureAVX2) ? PlasmaFillAVX2 : NULL;
+#	endif
+#	if SUPPORT_AVX512
+	case kPlasmaKernelAVX512:
+		return (features & kCpuFeatureAVX512) ? PlasmaFillAVX512 : NULL;
+#	endif
+#	if SUPPORT_NEON
+	case kPlasmaKernelNEON:
+		return (features & kCpuFeatureNEON) ? PlasmaFillNEON : NULL;
+#	endif
+	default:
+		return NULL;
+	}
+}
+
+static PlasmaKernelISA DetectBestPlasmaKernelISA()
+{
+	// AVX-512 is not always faster (clock throttling on some CPUs), but for this
+	// arithmetic heavy kernel it is.
+	static const PlasmaKernelISA kPreferred[] = { kPlasmaKernelAVX512, kPlasmaKernelAVX2, kPlasmaKernelSSE2, kPlasmaKernelNEON };
+	for (size_t i = 0; i < sizeof(kPreferred) / sizeof(kPreferred[0]); ++i)
+	{
+		if (GetPlasmaKernel(kPreferred[i]) != NULL)
+			return kPreferred[i];
+	}
+	return kPlasmaKernelScalar;
+}
+
+PlasmaKernelISA GetBestPlasmaKernelISA()
+{
+	static const PlasmaKernelISA s_Best = DetectBestPlasmaKernelISA();
+	return s_Best;
+}
+
+const char* GetPlasmaKernelISAName(PlasmaKernelISA isa)
+{
+	switch (isa)
+	{
+	case kPlasmaKernelScalar: return "scalar";
+	case kPlasmaKernelSSE2: return "SSE2";
+	case kPlasmaKernelAVX2: return "AVX2";
+	case kPlasmaKernelAVX512: return "AVX-512";
+	case kPlasmaKernelNEON: return "NEON";
+	default: return "unknown";
+	}
+}
+
+
+// --------------------------------------------------------------------------
+// PlasmaPlan
+
+
+// Largest radius index is kept below 65536; for small images distances are quantized to 1/16 pixel,
+// which keeps the radial term within ~0.25 of the exact value.
+static const float kPlasmaMaxRadiusSteps = 16.0f;
+
+struct PlasmaPlanFrame
+{
+	int width;
+	const unsigned short* radiusIndex;
+	const float* column;
+	const float* row;
+	const float* diagonal;
+	const float* radial;
+};
+
+typedef void (*PlasmaPlanFillFunc)(const PlasmaPlanFrame& frame, unsigned char* pixels, int rowPitch, int x0, int y0, int x1, int y1);
+
+static inline void PlasmaPlanFillRowScalar(const PlasmaPlanFrame& frame, unsigned char* row, int x, int x1, int y)
+{
+	const unsigned short* radiusIndex = frame.radiusIndex + (size_t)y * frame.width;
+	const float* diagonal = frame.diagonal + y;
+	const float rowTerm = frame.row[y];
+	for (; x < x1; ++x)
+	{
+		unsigned int vv = (unsigned int)int(rowTerm + frame.column[x] + diagonal[x] + frame.radial[radiusIndex[x]]) >> 2;
+		vv |= vv << 8;
+		vv |= vv << 16;
+		((unsigned int*)row)[x] = vv;
+	}
+}
+
+static void PlasmaPlanFillScalar(const PlasmaPlanFrame& frame, unsigned char* pixels, int rowPitch, int x0, int y0, int x1, int y1)
+{
+	for (int y = y0; y < y1; ++y)
+		PlasmaPlanFillRowScalar(frame, pixels + y * rowPitch, x0, x1, y);
+}
+
+#if SUPPORT_SSE2
+
+static void PlasmaPlanFillSSE2(const PlasmaPlanFrame& frame, unsigned char* pixels, int rowPitch, int x0, int y0, int x1, int y1)
+{
+	const float* radial = frame.radial;
+	for (int y = y0; y < y1; ++y)
+	{
+		unsigned char* row = pixels + y * rowPitch;
+		const unsigned short* radiusIndex = frame.radiusIndex + (size_t)y * frame.width;
+		const float* diagonal = frame.diagonal + y;
+		const __m128 rowTerm = _mm_set1_ps(frame.row[y]);
+		int x = x0;
+		for (; x + 4 <= x1; x += 4)
+		{
+			__m128 sum = _mm_add_ps(_mm_add_ps(rowTerm, _mm_loadu_ps(frame.column + x)), _mm_loadu_ps(diagonal + x));
+			sum = _mm_add_ps(sum, _mm_setr_ps(radial[radiusIndex[x]], radial[radiusIndex[x + 1]], radial[radiusIndex[x + 2]], radial[radiusIndex[x + 3]]));
+			__m128i v = _mm_srli_epi32(_mm_cvttps_epi32(sum), 2);
+			v = _mm_or_si128(v, _mm_slli_epi32(v, 8));
+			v = _mm_or_si128(v, _mm_slli_epi32(v, 16));
+			_mm_storeu_si128((__m128i*)(row + x * 4), v);
+		}
+		PlasmaPlanFillRowScalar(frame, row, x, x1, y);
+	}
+}
+
+#endif // #if SUPPORT_SSE2
+
+#if SUPPORT_AVX2
+
+SIMD_TARGET_AVX2 static void PlasmaPlanFillAVX2(const PlasmaPlanFrame& frame, unsigned char* pixels, int rowPitch, int x0, int y0, int x1, int y1)
+{
+	for (int y = y0; y < y1; ++y)
+	{
+		unsigned char* row = pixels + y * rowPitch;
+		const unsigned short* radiusIndex = frame.radiusIndex + (size_t)y * frame.width;
+		const float* diagonal = frame.diagonal + y;
+		const __m256 rowTerm = _mm256_set1_ps(frame.row[y]);
+		int x = x0;
+		for (; x + 8 <= x1; x += 8)
+		{
+			__m256 sum = _mm256_add_ps(_mm256_add_ps(rowTerm, _mm256_loadu_ps(frame.column + x)), _mm256_loadu_ps(diagonal + x));
+			const __m256i index = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(radiusIndex + x)));
+			sum = _mm256_add_ps(sum, _mm256_i32gather_ps(frame.radial, index, 4));
+			__m256i v = _mm256_srli_epi32(_mm256_cvttps_epi32(sum), 2);
+			v = _mm256_or_si256(v, _mm256_slli_epi32(v, 8));
+			v = _mm256_or_si256(v, _mm256_slli_epi32(v, 16));
+			_mm256_storeu_si256((__m256i*)(row + x * 4), v);
+		}
+		PlasmaPlanFillRowScalar(frame, row, x, x1, y);
+	}
+}
+
+#endif // #if SUPPORT_AVX2
+
+#if SUPPORT_NEON
+
+static void PlasmaPlanFillNEON(const PlasmaPlanFrame& frame, unsigned char* pixels, int rowPitch, int x0, int y0, int x1, int y1)
+{
+	const float* radial = frame.radial;
+	for (int y = y0; y < y1; ++y)
+	{
+		unsigned char* row = pixels + y * rowPitch;
+		const unsigned short* radiusIndex = frame.radiusIndex + (size_t)y * frame.width;
+		const float* diagonal = frame.diagonal + y;
+		const float32x4_t rowTerm = vdupq_n_f32(frame.row[y]);
+		int x = x0;
+		for (; x + 4 <= x1; x += 4)
+		{
+			float32x4_t r = vdupq_n_f32(radial[radiusIndex[x]]);
+			r = vsetq_lane_f32(radial[radiusIndex[x + 1]], r, 1);
+			r = vsetq_lane_f32(radial[radiusIndex[x + 2]], r, 2);
+			r = vsetq_lane_f32(radial[radiusIndex[x + 3]], r, 3);
+			const float32x4_t sum = vaddq_f32(vaddq_f32(vaddq_f32(rowTerm, vld1q_f32(frame.column + x)), vld1q_f32(diagonal + x)), r);
+			uint32x4_t v = vshrq_n_u32(vreinterpretq_u32_s32(vcvtq_s32_f32(sum)), 2);
+			v = vorrq_u32(v, vshlq_n_u32(v, 8));
+			v = vorrq_u32(v, vshlq_n_u32(v, 16));
+			vst1q_u32((uint32_t*)(row + x * 4), v);
+		}
+		PlasmaPlanFillRowScalar(frame, row, x, x1, y);
+	}
+}
+
+#endif // #if SUPPORT_NEON
+
+static PlasmaPlanFillFunc DetectPlasmaPlanFill()
+{
+	const unsigned int features = GetCpuFeatures();
+	(void)features;
+#	if SUPPORT_AVX2
+	if (features & kCpuFeatureAVX2)
+		return PlasmaPlanFillAVX2;
+#	endif
+#	if SUPPORT_SSE2
+	if (features & kCpuFeatureSSE2)
+		return PlasmaPlanFillSSE2;
+#	endif
+#	if SUPPORT_NEON
+	if (features & kCpuFeatureNEON)
+		return PlasmaPlanFillNEON;
+#	endif
+	return PlasmaPlanFillScalar;
+}
+
+
+PlasmaPlan::PlasmaPlan()
+: m_Width(0)
+, m_Height(0)
+, m_RadiusSteps(kPlasmaMaxRadiusSteps)
+{
+}
+
+void PlasmaPlan::Build(int width, int height)
+{
+	m_Width = width;
+	m_Height = height;
+
+	const float maxRadius = sqrtf(float(width - 1) * float(width - 1) + float(height - 1) * float(height - 1));
+	m_RadiusSteps = kPlasmaMaxRadiusSteps;
+	if (maxRadius * m_RadiusSteps > 65535.0f)
+		m_RadiusSteps = 65535.0f / maxRadius;
+
+	m_RadiusIndex.resize((size_t)width * height);
+	for (int y = 0; y < height; ++y)
+	{
+		unsigned short* dst = &m_RadiusIndex[(size_t)y * width];
+		for (int x = 0; x < width; ++x)
+			dst[x] = (unsigned short)(sqrtf(float(x*x + y*y)) * m_RadiusSteps + 0.5f);
+	}
+
+	m_Column.resize(width);
+	m_Row.resize(height);
+	m_Diagonal.resize(width + height - 1);
+	m_Radial.resize(size_t(maxRadius * m_RadiusSteps + 0.5f) + 1);
+}
+
+void PlasmaPlan::Update(float t)
+{
+	for (int x = 0; x < m_Width; ++x)
+		m_Column[x] = 127.0f * sinf(x / 7.0f + t);
+	for (int y = 0; y < m_Height; ++y)
+		m_Row[y] = 4.0f * 127.0f + 127.0f * sinf(y / 5.0f - t);
+	for (size_t i = 0; i < m_Diagonal.size(); ++i)
+		m_Diagonal[i] = 127.0f * sinf(float(i) / 6.0f - t);
+
+	// The radial table can have tens of thousands of entries, and its angles are evenly spaced:
+	// step the angle by rotating (sin, cos), restarting from exact values now and then so errors
+	// do not build up.
+	const double step = 1.0 / (4.0 * m_RadiusSteps);
+	const double sinStep = sin(step);
+	const double cosStep = cos(step);
+	double s = 0.0, c = 1.0;
+	for (size_t i = 0; i < m_Radial.size(); ++i)
+	{
+		if ((i & 255) == 0)
+		{
+			const double angle = double(i) * step - t;
+			s = sin(angle);
+			c = cos(angle);
+		}
+		m_Radial[i] = float(127.0 * s);
+		const double nextS = s * cosStep + c * sinStep;
+		c = c * cosStep - s * sinStep;
+		s = nextS;
+	}
+}
+
+void PlasmaPlan::Fill(unsigned char* pixels, int rowPitch, int x0, int y0, int x1, int y1) const
+{
+	static const PlasmaPlanFillFunc s_Fill = DetectPlasmaPlanFill();
+
+	PlasmaPlanFrame frame;
+	frame.width = m_Width;
+	frame.radiusIndex = &m_RadiusIndex[0];
+	frame.column = &m_Column[0];
+	frame.row = &m_Row[0];
+	frame.diagonal = &m_Diagonal[0];
+	frame.radial = &m_Radial[0];
+	s_Fill(frame, pixels, rowPitch, x0, y0, x1, y1);
+}
+
+size_t PlasmaPlan::GetMemorySize() const
+{
+	return m_RadiusIndex.size() * sizeof(m_RadiusIndex[0]) +
+		(m_Column.size() + m_Row.size() + m_Diagonal.size() + m_Radial.size()) * sizeof(float);
+}
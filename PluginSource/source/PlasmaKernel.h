@@ -0,0 +1,75 @@
+#pragma once
+
+// The "plasma effect" the plugin writes into the texture every frame (see ModifyTexturePixels
+// in RenderingPlugin.cpp), with a plain C version and vectorized versions for several instruction sets.
+// The best one the CPU supports is picked at runtime.
+//
+// Vectorized versions use an approximate sine, so pixel values may differ from the plain C
+// version by one.
+
+#include <stddef.h>
+#include <vector>
+
+enum PlasmaKernelISA
+{
+	kPlasmaKernelScalar = 0,
+	kPlasmaKernelSSE2,
+	kPlasmaKernelAVX2,
+	kPlasmaKernelAVX512,
+	kPlasmaKernelNEON,
+	kPlasmaKernelCount
+};
+
+// Fills pixels [x0,x1) x [y0,y1) of an RGBA8 image; pixels points to pixel (0,0).
+// t is the animation time.
+typedef void (*PlasmaFillFunc)(unsigned char* pixels, int rowPitch, int x0, int y0, int x1, int y1, float t);
+
+// Returns NULL if the kernel is not compiled in, or the CPU does not support it.
+PlasmaFillFunc GetPlasmaKernel(PlasmaKernelISA isa);
+
+// Fastest kernel this CPU can run; detected once.
+PlasmaKernelISA GetBestPlasmaKernelISA();
+
+const char* GetPlasmaKernelISAName(PlasmaKernelISA isa);
+
+
+// Cached tables for filling a whole width x height image every frame.
+//
+// Three of the four sine terms only depend on x, y or x+y, so per frame they are evaluated once per
+// column / row / diagonal. The radial term depends on sqrt(x*x+y*y), which never changes: each pixel
+// keeps its distance from the corner quantized to 1/16 pixel (a bit coarser for images with a diagonal
+// over 4096 pixels) in 2 bytes, and per frame the sine is evaluated once per distinct distance.
+// Per pixel that leaves table lookups and additions.
+// Results may differ from the plain C version by one, like the vectorized kernels.
+class PlasmaPlan
+{
+public:
+	PlasmaPlan();
+
+	bool Matches(int width, int height) const { return m_Width == width && m_Height == height; }
+
+	// Rebuilds the per pixel tables for a new size; O(width * height).
+	void Build(int width, int height);
+
+	// Evaluates the sines for time t; O(width + height + radius) sines.
+	void Update(float t);
+
+	// Fills pixels [x0,x1) x [y0,y1) like PlasmaFillFunc, for the time given to Update.
+	// Can be called from several threads at once (for different pixels).
+	void Fill(unsigned char* pixels, int rowPitch, int x0, int y0, int x1, int y1) const;
+
+	// Memory used by the tables, in bytes
+	size_t GetMemorySize() const;
+
+private:
+	int m_Width;
+	int m_Height;
+	float m_RadiusSteps; // quantization steps per pixel of distance
+	std::vector<unsigned short> m_RadiusIndex; // per pixel: round(sqrt(x*x+y*y) * m_RadiusSteps)
+
+	// Per frame terms, 127*sin(...), with 4*127 folded into the row term
+	std::vector<float> m_Column; // x
+	std::vector<float> m_Row; // y
+	std::vector<float> m_Diagonal; // x+y
+	std::vector<float> m_Radial; // radius index
+};
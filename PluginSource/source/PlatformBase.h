@@ -79,6 +79,44 @@
 
 
 
+// Can the plugin start its own threads? (WebGL only with pthreads enabled)
+#if UNITY_WEBGL && !defined(__EMSCRIPTEN_PTHREADS__)
+	#define SUPPORT_THREADS 0
+#else
+	#define SUPPORT_THREADS 1
+#endif
+
+
+
+// Which SIMD instruction sets are always available on the target CPU?
+// SUPPORT_SSE2 - x86/x64 (baseline on all x64 CPUs)
+// SUPPORT_NEON - ARMv7 with NEON, ARM64
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define SUPPORT_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+	#define SUPPORT_NEON 1
+#endif
+
+// Which wider x86 instruction sets do we compile code paths for? These are only used
+// after checking the CPU at runtime (see CpuFeatures.h).
+// SUPPORT_AVX2 - AVX2 + FMA
+// SUPPORT_AVX512 - AVX-512 Foundation
+#if SUPPORT_SSE2 && (defined(_MSC_VER) || defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))) && !defined(__EMSCRIPTEN__)
+	#define SUPPORT_AVX2 1
+	#define SUPPORT_AVX512 1
+#endif
+
+// Functions using the runtime selected instruction sets need to be marked for the compiler
+#if (SUPPORT_AVX2 || SUPPORT_AVX512) && (defined(__GNUC__) || defined(__clang__))
+	#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+	#define SIMD_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#else
+	#define SIMD_TARGET_AVX2
+	#define SIMD_TARGET_AVX512
+#endif
+
+
+
 // COM-like Release macro
 #ifndef SAFE_RELEASE
 	#define SAFE_RELEASE(a) if (a) { a->Release(); a = NULL; }
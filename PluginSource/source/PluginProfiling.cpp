@@ -0,0 +1,374 @@
+#include "PluginProfiling.h"
+
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+
+std::atomic<int> g_PluginProfilerFlags(0);
+
+static const char* const kPluginStageNames[kPluginStageCount] =
+{
+	"OnRenderEvent",
+	"drawToRenderTexture",
+	"DrawColoredTriangle",
+	"ModifyTexturePixels",
+	"ModifyVertexBuffer",
+	"drawToPluginTexture",
+	"RenderAPI::ProcessDeviceEvent",
+	"RenderAPI::DrawSimpleTriangles",
+	"RenderAPI::BeginModifyTexture",
+	"RenderAPI::EndModifyTexture",
+	"RenderAPI::GenerateTexture",
+	"RenderAPI::BeginModifyVertexBuffer",
+	"RenderAPI::EndModifyVertexBuffer",
+	"RenderAPI::DeformVertexBuffer",
+	"RenderAPI::FlushUploads",
+	"TextureProducer",
+};
+
+const char* GetPluginStageName(int stage)
+{
+	if (stage < 0 || stage >= kPluginStageCount)
+		return "unknown";
+	return kPluginStageNames[stage];
+}
+
+
+// Updated with relaxed atomics from whichever thread ran the stage; a reader may see a
+// sample counted but its time not added yet, which is fine for statistics.
+struct StageCounters
+{
+	std::atomic<unsigned long long> count;
+	std::atomic<unsigned long long> totalNs;
+	std::atomic<unsigned long long> minNs; // 0 if no samples
+	std::atomic<unsigned long long> maxNs;
+	std::atomic<unsigned long long> histogram[PLUGIN_TIMING_BUCKETS];
+};
+
+static StageCounters s_StageCounters[kPluginStageCount]; // static storage, starts zeroed
+
+
+static unsigned long long ProfilerNowNs()
+{
+	return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// See PluginStageTiming::histogram
+static int HistogramBucket(unsigned long long ns)
+{
+	if (ns < 4)
+		return int(ns);
+	int octave = 2;
+	while ((ns >> (octave + 1)) != 0)
+		++octave;
+	const int bucket = (octave - 1) * 4 + int((ns >> (octave - 2)) & 3);
+	return bucket < PLUGIN_TIMING_BUCKETS ? bucket : PLUGIN_TIMING_BUCKETS - 1;
+}
+
+static void HistogramBucketRange(int bucket, unsigned long long* outStart, unsigned long long* outSize)
+{
+	if (bucket < 4)
+	{
+		*outStart = (unsigned long long)bucket;
+		*outSize = 1;
+		return;
+	}
+	const int octave = bucket / 4 + 1;
+	*outSize = 1ull << (octave - 2);
+	*outStart = (unsigned long long)(4 + bucket % 4) << (octave - 2);
+}
+
+static void RecordStageTime(PluginStage stage, unsigned long long ns)
+{
+	StageCounters& counters = s_StageCounters[stage];
+	counters.count.fetch_add(1, std::memory_order_relaxed);
+	counters.totalNs.fetch_add(ns, std::memory_order_relaxed);
+	counters.histogram[HistogramBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+
+	unsigned long long prevMin = counters.minNs.load(std::memory_order_relaxed);
+	while ((prevMin == 0 || ns < prevMin) && !counters.minNs.compare_exchange_weak(prevMin, ns != 0 ? ns : 1, std::memory_order_relaxed))
+	{
+	}
+	unsigned long long prevMax = counters.maxNs.load(std::memory_order_relaxed);
+	while (ns > prevMax && !counters.maxNs.compare_exchange_weak(prevMax, ns, std::memory_order_relaxed))
+	{
+	}
+}
+
+
+void EnablePluginTiming(bool enabled)
+{
+	if (enabled)
+		g_PluginProfilerFlags.fetch_or(kProfilerFlagTiming, std::memory_order_relaxed);
+	else
+		g_PluginProfilerFlags.fetch_and(~kProfilerFlagTiming, std::memory_order_relaxed);
+}
+
+// Interpolated inside the histogram bucket the percentile falls into, clamped to the measured range
+static unsigned long long EstimatePercentile(const PluginStageTiming& timing, double fraction)
+{
+	if (timing.count == 0)
+		return 0;
+	const unsigned long long rank = (unsigned long long)(fraction * double(timing.count - 1));
+	unsigned long long seen = 0;
+	for (int i = 0; i < PLUGIN_TIMING_BUCKETS; ++i)
+	{
+		if (seen + timing.histogram[i] > rank)
+		{
+			unsigned long long start, size;
+			HistogramBucketRange(i, &start, &size);
+			unsigned long long estimate = start + (unsigned long long)(double(size) * (double(rank - seen) + 0.5) / double(timing.histogram[i]));
+			if (estimate < timing.minNs)
+				estimate = timing.minNs;
+			if (estimate > timing.maxNs)
+				estimate = timing.maxNs;
+			return estimate;
+		}
+		seen += timing.histogram[i];
+	}
+	return timing.maxNs;
+}
+
+void CollectPluginTimingStats(PluginTimingStats* outStats)
+{
+	memset(outStats, 0, sizeof(*outStats));
+	outStats->enabled = (g_PluginProfilerFlags.load(std::memory_order_relaxed) & kProfilerFlagTiming) != 0;
+	outStats->stageCount = kPluginStageCount;
+	for (int stage = 0; stage < kPluginStageCount; ++stage)
+	{
+		const StageCounters& counters = s_StageCounters[stage];
+		PluginStageTiming& timing = outStats->stages[stage];
+		timing.count = 0;
+		for (int i = 0; i < PLUGIN_TIMING_BUCKETS; ++i)
+		{
+			timing.histogram[i] = counters.histogram[i].load(std::memory_order_relaxed);
+			timing.count += timing.histogram[i];
+		}
+		timing.totalNs = counters.totalNs.load(std::memory_order_relaxed);
+		timing.minNs = counters.minNs.load(std::memory_order_relaxed);
+		timing.maxNs = counters.maxNs.load(std::memory_order_relaxed);
+		timing.p50Ns = EstimatePercentile(timing, 0.50);
+		timing.p90Ns = EstimatePercentile(timing, 0.90);
+		timing.p99Ns = EstimatePercentile(timing, 0.99);
+	}
+}
+
+void ClearPluginTimingStats()
+{
+	for (int stage = 0; stage < kPluginStageCount; ++stage)
+	{
+		StageCounters& counters = s_StageCounters[stage];
+		counters.count.store(0, std::memory_order_relaxed);
+		counters.totalNs.store(0, std::memory_order_relaxed);
+		counters.minNs.store(0, std::memory_order_relaxed);
+		counters.maxNs.store(0, std::memory_order_relaxed);
+		for (int i = 0; i < PLUGIN_TIMING_BUCKETS; ++i)
+			counters.histogram[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+
+// --------------------------------------------------------------------------
+// Tracing
+
+struct TraceEvent
+{
+	const char* name;
+	unsigned long long startNs;
+	unsigned long long durationNs;
+	int arg;
+};
+
+// Ring of the last kPluginTraceEventsPerThread events of one thread. Only that thread writes events;
+// WritePluginTraceFile reads them concurrently, and throws away any it might have read while they were
+// being overwritten.
+struct TraceThreadBuffer
+{
+	TraceThreadBuffer(int id, const char* threadName)
+	: events(kPluginTraceEventsPerThread)
+	, written(0)
+	, flushed(0)
+	, threadId(id)
+	, name(threadName)
+	, threadExited(false)
+	{
+	}
+
+	std::vector<TraceEvent> events;
+	std::atomic<unsigned long long> written; // events ever written
+	unsigned long long flushed; // events already in a file, or overwritten before that; protected by s_TraceMutex
+	int threadId;
+	std::atomic<const char*> name; // NULL if the thread was not named
+	std::atomic<bool> threadExited; // buffer can be deleted once flushed
+};
+
+// Per thread; when the thread exits, its buffer stays around until its events are written out.
+struct TraceThreadState
+{
+	TraceThreadState() : buffer(NULL), name(NULL), outOfBuffers(false) {}
+	~TraceThreadState()
+	{
+		if (buffer)
+			buffer->threadExited.store(true, std::memory_order_release);
+	}
+
+	TraceThreadBuffer* buffer;
+	const char* name;
+	bool outOfBuffers;
+};
+
+// Caps trace memory use (1 MB per thread) if threads keep coming and going between writes
+static const size_t kMaxTraceThreadBuffers = 64;
+
+static std::mutex s_TraceMutex; // protects the list and TraceThreadBuffer::flushed
+static std::vector<TraceThreadBuffer*> s_TraceBuffers;
+static int s_NextTraceThreadId = 1;
+static thread_local TraceThreadState t_TraceThread;
+
+static TraceThreadBuffer* GetTraceThreadBuffer()
+{
+	TraceThreadState& state = t_TraceThread;
+	if (state.buffer == NULL && !state.outOfBuffers)
+	{
+		std::lock_guard<std::mutex> lock(s_TraceMutex);
+		if (s_TraceBuffers.size() < kMaxTraceThreadBuffers)
+		{
+			state.buffer = new TraceThreadBuffer(s_NextTraceThreadId++, state.name);
+			s_TraceBuffers.push_back(state.buffer);
+		}
+		else
+			state.outOfBuffers = true;
+	}
+	return state.buffer;
+}
+
+static void RecordTraceEvent(const char* name, int arg, unsigned long long startNs, unsigned long long durationNs)
+{
+	TraceThreadBuffer* buffer = GetTraceThreadBuffer();
+	if (!buffer)
+		return;
+	const unsigned long long index = buffer->written.load(std::memory_order_relaxed);
+	TraceEvent& event = buffer->events[size_t(index % kPluginTraceEventsPerThread)];
+	event.name = name;
+	event.startNs = startNs;
+	event.durationNs = durationNs;
+	event.arg = arg;
+	buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void ProfilerSetThreadName(const char* name)
+{
+	TraceThreadState& state = t_TraceThread;
+	state.name = name;
+	if (state.buffer)
+		state.buffer->name.store(name, std::memory_order_relaxed);
+}
+
+void EnablePluginTracing(bool enabled)
+{
+	if (enabled)
+		g_PluginProfilerFlags.fetch_or(kProfilerFlagTracing, std::memory_order_relaxed);
+	else
+		g_PluginProfilerFlags.fetch_and(~kProfilerFlagTracing, std::memory_order_relaxed);
+}
+
+// Chrome trace event timestamps are in microseconds
+static void WriteTraceMicroseconds(FILE* file, unsigned long long ns)
+{
+	fprintf(file, "%llu.%03u", ns / 1000, unsigned(ns % 1000));
+}
+
+bool WritePluginTraceFile(const char* path)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	std::lock_guard<std::mutex> lock(s_TraceMutex);
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"RenderingPlugin\"}}");
+
+	std::vector<TraceEvent> events;
+	for (size_t i = 0; i < s_TraceBuffers.size(); ++i)
+	{
+		TraceThreadBuffer& buffer = *s_TraceBuffers[i];
+		const unsigned long long capacity = kPluginTraceEventsPerThread;
+
+		// Copy out what was written since the last flush, then drop the oldest events if the
+		// thread wrapped around onto them while we were copying
+		const unsigned long long end = buffer.written.load(std::memory_order_acquire);
+		unsigned long long begin = end > capacity ? end - capacity : 0;
+		if (begin < buffer.flushed)
+			begin = buffer.flushed;
+		events.resize(size_t(end - begin));
+		for (unsigned long long index = begin; index < end; ++index)
+			events[size_t(index - begin)] = buffer.events[size_t(index % capacity)];
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const unsigned long long writtenAfterCopy = buffer.written.load(std::memory_order_relaxed);
+		const unsigned long long firstIntact = writtenAfterCopy + 1 > capacity ? writtenAfterCopy + 1 - capacity : 0;
+		const size_t skip = firstIntact > begin ? size_t(firstIntact - begin) : 0;
+		buffer.flushed = end;
+
+		const char* name = buffer.name.load(std::memory_order_relaxed);
+		if (name)
+			fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", buffer.threadId, name);
+		else
+			fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"Thread %d\"}}", buffer.threadId, buffer.threadId);
+
+		// One "complete" event per scope carries both its begin and end time, so events lost to the
+		// ring wrapping around can't leave unmatched begins or ends behind.
+		for (size_t e = skip; e < events.size(); ++e)
+		{
+			const TraceEvent& event = events[e];
+			fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"plugin\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":", event.name, buffer.threadId);
+			WriteTraceMicroseconds(file, event.startNs);
+			fprintf(file, ",\"dur\":");
+			WriteTraceMicroseconds(file, event.durationNs);
+			if (event.arg != kProfilerNoArg)
+				fprintf(file, ",\"args\":{\"arg\":%d}", event.arg);
+			fprintf(file, "}");
+		}
+	}
+	fprintf(file, "\n]}\n");
+	const bool ok = ferror(file) == 0;
+	fclose(file);
+
+	// Buffers of threads that are gone are not needed anymore
+	for (size_t i = 0; i < s_TraceBuffers.size();)
+	{
+		if (s_TraceBuffers[i]->threadExited.load(std::memory_order_acquire))
+		{
+			delete s_TraceBuffers[i];
+			s_TraceBuffers.erase(s_TraceBuffers.begin() + i);
+		}
+		else
+			++i;
+	}
+	return ok;
+}
+
+
+// --------------------------------------------------------------------------
+// Scoped timers
+
+unsigned long long ProfilerBegin()
+{
+	const unsigned long long now = ProfilerNowNs();
+	return now != 0 ? now : 1;
+}
+
+void ProfilerEnd(PluginStage stage, const char* name, int arg, unsigned long long startNs)
+{
+	const unsigned long long endNs = ProfilerNowNs();
+	const unsigned long long ns = endNs > startNs ? endNs - startNs : 0;
+
+	// Flags may have changed since the scope started
+	const int flags = g_PluginProfilerFlags.load(std::memory_order_relaxed);
+	if ((flags & kProfilerFlagTiming) != 0 && stage < kPluginStageCount)
+		RecordStageTime(stage, ns);
+	if ((flags & kProfilerFlagTracing) != 0)
+		RecordTraceEvent(name ? name : kPluginStageNames[stage], arg, startNs, ns);
+}
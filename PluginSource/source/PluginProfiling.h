@@ -0,0 +1,153 @@
+#pragma once
+
+// Timing of what the plugin does: scoped timers around each stage of the render event and around
+// each RenderAPI call feed lock-free per-stage histograms, which scripts can read through the exported
+// GetPluginTimingStats (RenderingPlugin.cpp).
+//
+// The same timers, plus named ones inside the backends (PROFILE_SCOPE), can also record a trace:
+// one event per timed scope into a fixed size ring buffer per thread, written out on demand as
+// Chrome trace event JSON (open in chrome://tracing or https://ui.perfetto.dev).
+//
+// The timers are always compiled in, but off until EnablePluginTiming / EnablePluginTracing; while
+// off, a timer only checks one global flag.
+
+#include <stddef.h>
+#include <atomic>
+
+
+enum PluginStage
+{
+	// Parts of OnRenderEvent; drawToRenderTexture and drawToPluginTexture are only the RenderAPI call
+	kPluginStageRenderEvent = 0,
+	kPluginStageDrawToRenderTexture,
+	kPluginStageDrawColoredTriangle,
+	kPluginStageModifyTexturePixels,
+	kPluginStageModifyVertexBuffer,
+	kPluginStageDrawToPluginTexture,
+
+	// RenderAPI calls
+	kPluginStageApiProcessDeviceEvent,
+	kPluginStageApiDrawSimpleTriangles,
+	kPluginStageApiBeginModifyTexture,
+	kPluginStageApiEndModifyTexture,
+	kPluginStageApiGenerateTexture,
+	kPluginStageApiBeginModifyVertexBuffer,
+	kPluginStageApiEndModifyVertexBuffer,
+	kPluginStageApiDeformVertexBuffer,
+	kPluginStageApiFlushUploads,
+
+	// Work on plugin threads
+	kPluginStageProduceTexture,
+
+	kPluginStageCount
+};
+
+const char* GetPluginStageName(int stage);
+
+
+// Layout of the data returned by GetPluginTimingStats; UseRenderingPlugin.cs has the matching C# structs.
+#define PLUGIN_TIMING_BUCKETS 128
+
+struct PluginStageTiming
+{
+	unsigned long long count;
+	unsigned long long totalNs;
+	unsigned long long minNs;
+	unsigned long long maxNs;
+	unsigned long long p50Ns; // percentiles are estimated from the histogram
+	unsigned long long p90Ns;
+	unsigned long long p99Ns;
+	// Durations in ns; buckets 0-3 count 0-3 ns, after that each power of two is split into four
+	// equal buckets (4-4.99, 5-5.99, ... 8-9.99, 10-11.99, ...), so percentiles are within 25%.
+	// The last bucket also counts everything longer (about 4.3 seconds).
+	unsigned long long histogram[PLUGIN_TIMING_BUCKETS];
+};
+
+struct PluginTimingStats
+{
+	int enabled;
+	int stageCount; // kPluginStageCount
+	PluginStageTiming stages[kPluginStageCount];
+};
+
+void EnablePluginTiming(bool enabled);
+void CollectPluginTimingStats(PluginTimingStats* outStats);
+void ClearPluginTimingStats();
+
+
+// Tracing
+
+// Each thread keeps its last kPluginTraceEventsPerThread events; older ones are overwritten.
+const int kPluginTraceEventsPerThread = 32768;
+
+void EnablePluginTracing(bool enabled);
+
+// Writes the events recorded since the previous write to a JSON file, and drops them from the
+// buffers. Can be called from any thread, also while other threads keep recording.
+bool WritePluginTraceFile(const char* path);
+
+// Names the calling thread in traces; name must stay valid (e.g. a string literal).
+void ProfilerSetThreadName(const char* name);
+
+
+// Scoped timers
+
+enum ProfilerFlags
+{
+	kProfilerFlagTiming = 1 << 0,
+	kProfilerFlagTracing = 1 << 1
+};
+
+extern std::atomic<int> g_PluginProfilerFlags; // ProfilerFlags
+
+const int kProfilerNoArg = -1;
+
+unsigned long long ProfilerBegin(); // returns the start time, never 0
+// stage is kPluginStageCount for scopes that are only traced
+void ProfilerEnd(PluginStage stage, const char* name, int arg, unsigned long long startNs);
+
+class ProfilerScope
+{
+public:
+	// Timed and traced; arg (if not kProfilerNoArg) is shown with the trace event
+	explicit ProfilerScope(PluginStage stage, int arg = kProfilerNoArg)
+	: m_Stage(stage)
+	, m_Name(NULL)
+	, m_Arg(arg)
+	, m_StartNs(0)
+	{
+		if (g_PluginProfilerFlags.load(std::memory_order_relaxed) != 0)
+			m_StartNs = ProfilerBegin();
+	}
+	// Only traced; name must stay valid (e.g. a string literal)
+	explicit ProfilerScope(const char* name, int arg = kProfilerNoArg)
+	: m_Stage(kPluginStageCount)
+	, m_Name(name)
+	, m_Arg(arg)
+	, m_StartNs(0)
+	{
+		if ((g_PluginProfilerFlags.load(std::memory_order_relaxed) & kProfilerFlagTracing) != 0)
+			m_StartNs = ProfilerBegin();
+	}
+	~ProfilerScope()
+	{
+		if (m_StartNs != 0)
+			ProfilerEnd(m_Stage, m_Name, m_Arg, m_StartNs);
+	}
+
+private:
+	ProfilerScope(const ProfilerScope&);
+	ProfilerScope& operator=(const ProfilerScope&);
+
+	PluginStage m_Stage;
+	const char* m_Name;
+	int m_Arg;
+	unsigned long long m_StartNs;
+};
+
+#define PLUGIN_PROFILER_CONCAT2(a, b) a##b
+#define PLUGIN_PROFILER_CONCAT(a, b) PLUGIN_PROFILER_CONCAT2(a, b)
+#define PROFILE_STAGE(stage) ProfilerScope PLUGIN_PROFILER_CONCAT(profilerScope, __LINE__)(stage)
+#define PROFILE_STAGE_ARG(stage, arg) ProfilerScope PLUGIN_PROFILER_CONCAT(profilerScope, __LINE__)(stage, arg)
+#define PROFILE_SCOPE(name) ProfilerScope PLUGIN_PROFILER_CONCAT(profilerScope, __LINE__)(name)
+#define PROFILE_SCOPE_ARG(name, arg) ProfilerScope PLUGIN_PROFILER_CONCAT(profilerScope, __LINE__)(name, arg)
@@ -0,0 +1,328 @@
+#include "PluginThreadPool.h"
+#include "PlatformBase.h"
+#include "PluginProfiling.h"
+
+
+#if SUPPORT_THREADS
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// One ParallelFor call; lives on the stack of the calling thread.
+struct ParallelForBatch
+{
+	ParallelForFunc func;
+	void* userData;
+	int remaining; // tasks not finished yet, protected by mutex
+	std::mutex mutex;
+	std::condition_variable done;
+};
+
+struct PoolTask
+{
+	ParallelForBatch* batch;
+	int index;
+};
+
+struct WorkerQueue
+{
+	std::mutex mutex;
+	std::deque<PoolTask> tasks;
+};
+
+
+class PluginThreadPool
+{
+public:
+	PluginThreadPool();
+	~PluginThreadPool();
+
+	void ParallelFor(int count, ParallelForFunc func, void* userData);
+	void SetThreadCount(int threadCount) { m_RequestedThreadCount = threadCount; }
+	int GetThreadCount() const { return ResolveThreadCount(m_RequestedThreadCount); }
+	void Shutdown();
+
+private:
+	static int ResolveThreadCount(int requested);
+
+	void BeginBatch();
+	void EndBatch();
+	bool RunOneTask(int ownQueue, unsigned int firstQueue);
+	void WorkerMain(int queueIndex);
+	void StartWorkers(int threadCount);
+	void StopWorkers();
+
+private:
+	// Only changed while no ParallelFor is running (m_ActiveBatches is zero)
+	std::vector<WorkerQueue*> m_Queues; // one per worker thread
+	std::vector<std::thread> m_Threads;
+	int m_ThreadCount; // 0 if not started yet
+
+	std::atomic<int> m_RequestedThreadCount;
+	std::mutex m_BatchMutex;
+	int m_ActiveBatches;
+
+	// Sleeping workers wait for queued tasks here
+	std::mutex m_WakeMutex;
+	std::condition_variable m_Wake;
+	std::atomic<int> m_QueuedTasks;
+	bool m_Quit;
+
+	std::atomic<unsigned int> m_NextQueue;
+};
+
+
+PluginThreadPool::PluginThreadPool()
+: m_ThreadCount(0)
+, m_RequestedThreadCount(0)
+, m_ActiveBatches(0)
+, m_QueuedTasks(0)
+, m_Quit(false)
+, m_NextQueue(0)
+{
+}
+
+PluginThreadPool::~PluginThreadPool()
+{
+	StopWorkers();
+}
+
+int PluginThreadPool::ResolveThreadCount(int requested)
+{
+	if (requested <= 0)
+		requested = int(std::thread::hardware_concurrency()); // can be 0 if not known
+	if (requested < 1)
+		requested = 1;
+	if (requested > 64)
+		requested = 64;
+	return requested;
+}
+
+void PluginThreadPool::BeginBatch()
+{
+	std::lock_guard<std::mutex> lock(m_BatchMutex);
+	const int threadCount = ResolveThreadCount(m_RequestedThreadCount);
+	if (m_ActiveBatches == 0 && threadCount != m_ThreadCount)
+	{
+		StopWorkers();
+		StartWorkers(threadCount);
+	}
+	++m_ActiveBatches;
+}
+
+void PluginThreadPool::EndBatch()
+{
+	std::lock_guard<std::mutex> lock(m_BatchMutex);
+	--m_ActiveBatches;
+}
+
+void PluginThreadPool::Shutdown()
+{
+	std::lock_guard<std::mutex> lock(m_BatchMutex);
+	if (m_ActiveBatches == 0)
+		StopWorkers();
+}
+
+void PluginThreadPool::StartWorkers(int threadCount)
+{
+	m_Quit = false;
+	m_ThreadCount = threadCount;
+
+	// The thread calling ParallelFor is one of the threads doing the work
+	const int workerCount = threadCount - 1;
+	for (int i = 0; i < workerCount; ++i)
+		m_Queues.push_back(new WorkerQueue());
+	for (int i = 0; i < workerCount; ++i)
+		m_Threads.push_back(std::thread(&PluginThreadPool::WorkerMain, this, i));
+}
+
+void PluginThreadPool::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_WakeMutex);
+		m_Quit = true;
+	}
+	m_Wake.notify_all();
+	for (size_t i = 0; i < m_Threads.size(); ++i)
+		m_Threads[i].join();
+	m_Threads.clear();
+
+	for (size_t i = 0; i < m_Queues.size(); ++i)
+		delete m_Queues[i];
+	m_Queues.clear();
+	m_ThreadCount = 0;
+}
+
+// Takes a task from our own queue (newest first), or steals one from another queue (oldest first),
+// and runs it. ownQueue is -1 for threads that are not workers.
+bool PluginThreadPool::RunOneTask(int ownQueue, unsigned int firstQueue)
+{
+	const size_t queueCount = m_Queues.size();
+	PoolTask task;
+	bool found = false;
+	if (ownQueue >= 0)
+	{
+		WorkerQueue& queue = *m_Queues[ownQueue];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty())
+		{
+			task = queue.tasks.back();
+			queue.tasks.pop_back();
+			found = true;
+		}
+	}
+	for (size_t i = 0; i < queueCount && !found; ++i)
+	{
+		WorkerQueue& queue = *m_Queues[(firstQueue + i) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty())
+		{
+			task = queue.tasks.front();
+			queue.tasks.pop_front();
+			found = true;
+		}
+	}
+	if (!found)
+		return false;
+	--m_QueuedTasks;
+
+	ParallelForBatch& batch = *task.batch;
+	{
+		PROFILE_SCOPE_ARG("ParallelFor task", task.index);
+		batch.func(batch.userData, task.index);
+	}
+
+	// Decrement under the lock: the batch may be gone as soon as it is unlocked
+	std::lock_guard<std::mutex> lock(batch.mutex);
+	if (--batch.remaining == 0)
+		batch.done.notify_all();
+	return true;
+}
+
+void PluginThreadPool::WorkerMain(int queueIndex)
+{
+	ProfilerSetThreadName("Plugin worker");
+	unsigned int nextVictim = unsigned(queueIndex) + 1;
+	for (;;)
+	{
+		if (RunOneTask(queueIndex, nextVictim++))
+			continue;
+
+		std::unique_lock<std::mutex> lock(m_WakeMutex);
+		m_Wake.wait(lock, [this]() { return m_Quit || m_QueuedTasks > 0; });
+		if (m_Quit)
+			return;
+	}
+}
+
+void PluginThreadPool::ParallelFor(int count, ParallelForFunc func, void* userData)
+{
+	if (count <= 0)
+		return;
+
+	PROFILE_SCOPE_ARG("ParallelFor", count);
+	BeginBatch();
+	const int queueCount = int(m_Queues.size());
+	if (queueCount == 0 || count == 1)
+	{
+		for (int i = 0; i < count; ++i)
+			func(userData, i);
+		EndBatch();
+		return;
+	}
+
+	ParallelForBatch batch;
+	batch.func = func;
+	batch.userData = userData;
+	batch.remaining = count;
+
+	// Give each worker a contiguous range, so that neighbouring tasks (e.g. adjacent texture
+	// rows) tend to end up on the same thread
+	for (int q = 0; q < queueCount; ++q)
+	{
+		const int begin = int((long long)count * q / queueCount);
+		const int end = int((long long)count * (q + 1) / queueCount);
+		WorkerQueue& queue = *m_Queues[q];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		for (int i = begin; i < end; ++i)
+		{
+			PoolTask task = { &batch, i };
+			queue.tasks.push_back(task);
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_WakeMutex);
+		m_QueuedTasks += count;
+	}
+	m_Wake.notify_all();
+
+	// Help out until nothing is left to steal, then wait for the tasks still running
+	unsigned int firstQueue = m_NextQueue++;
+	while (RunOneTask(-1, firstQueue++))
+	{
+	}
+	{
+		std::unique_lock<std::mutex> lock(batch.mutex);
+		batch.done.wait(lock, [&batch]() { return batch.remaining == 0; });
+	}
+
+	EndBatch();
+}
+
+
+static PluginThreadPool& GetThreadPool()
+{
+	static PluginThreadPool s_Pool;
+	return s_Pool;
+}
+
+void ParallelFor(int count, ParallelForFunc func, void* userData)
+{
+	GetThreadPool().ParallelFor(count, func, userData);
+}
+
+void SetWorkerThreadCount(int threadCount)
+{
+	GetThreadPool().SetThreadCount(threadCount);
+}
+
+int GetWorkerThreadCount()
+{
+	return GetThreadPool().GetThreadCount();
+}
+
+void ShutdownWorkerThreads()
+{
+	GetThreadPool().Shutdown();
+}
+
+
+#else
+
+
+void ParallelFor(int count, ParallelForFunc func, void* userData)
+{
+	for (int i = 0; i < count; ++i)
+		func(userData, i);
+}
+
+void SetWorkerThreadCount(int threadCount)
+{
+}
+
+int GetWorkerThreadCount()
+{
+	return 1;
+}
+
+void ShutdownWorkerThreads()
+{
+}
+
+
+#endif // #if SUPPORT_THREADS
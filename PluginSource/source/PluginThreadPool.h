@@ -0,0 +1,24 @@
+#pragma once
+
+// Worker threads owned by the plugin, used to split CPU heavy work (e.g. filling the texture)
+// so that Unity's render thread does not have to do all of it alone.
+//
+// Each worker has its own task queue; idle workers steal tasks from the others. The thread
+// calling ParallelFor works on the tasks too, and returns once all of them are done.
+//
+// On platforms without threads (SUPPORT_THREADS is 0) everything runs on the calling thread.
+
+typedef void (*ParallelForFunc)(void* userData, int index);
+
+// Calls func(userData, i) for each i in [0, count), possibly from several threads at once.
+// Can be called from several threads, and from inside tasks.
+void ParallelFor(int count, ParallelForFunc func, void* userData);
+
+// Number of threads ParallelFor uses, including the calling thread. 0 means one per CPU core;
+// 1 means do everything on the calling thread. The change happens on the next ParallelFor
+// call that does not overlap with other ones.
+void SetWorkerThreadCount(int threadCount);
+int GetWorkerThreadCount();
+
+// Stops the worker threads; they are started again by the next ParallelFor.
+void ShutdownWorkerThreads();
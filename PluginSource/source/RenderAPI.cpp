@@ -45,6 +45,14 @@ RenderAPI* CreateRenderAPI(UnityGfxRenderer apiType)
 	}
 #	endif // if SUPPORT_VULKAN
 
+#	if SUPPORT_SOFTWARE
+	if (apiType == kUnityGfxRendererNull)
+	{
+		extern RenderAPI* CreateRenderAPI_Software();
+		return CreateRenderAPI_Software();
+	}
+#	endif // if SUPPORT_SOFTWARE
+
 	// Unknown or unsupported graphics API
 	return NULL;
 }
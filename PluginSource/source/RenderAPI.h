@@ -5,6 +5,23 @@
 #include <stddef.h>
 
 struct IUnityInterfaces;
+class MeshSource;
+
+// Device memory the plugin allocated itself, for APIs that sub-allocate it; all sizes in bytes.
+// requestedBytes against usedBytes + dedicatedBytes shows what rounding wastes, freeRangeCount and
+// largestFreeRange how fragmented the free space in the blocks is.
+struct PluginMemoryStats
+{
+	unsigned long long blockCount; // big allocations that resources are sub-allocated from
+	unsigned long long blockBytes;
+	unsigned long long allocationCount; // resources sub-allocated from blocks
+	unsigned long long usedBytes; // of blocks, by those resources
+	unsigned long long requestedBytes; // by all resources, before any rounding
+	unsigned long long freeRangeCount;
+	unsigned long long largestFreeRange;
+	unsigned long long dedicatedCount; // resources too big for blocks, with memory of their own
+	unsigned long long dedicatedBytes;
+};
 
 // Super-simple "graphics abstraction". This is nothing like how a proper platform abstraction layer would look like;
 // all this does is a base interface for whatever our plugin sample needs. Which is only "draw some triangles"
@@ -40,6 +57,11 @@ public:
 	// End modifying texture data.
 	virtual void EndModifyTexture(void* textureHandle, int textureWidth, int textureHeight, int rowPitch, void* dataPtr) = 0;
 
+	// Has the GPU write the plasma effect (see PlasmaKernel.h) for time t into the texture itself,
+	// instead of the CPU filling it through Begin/EndModifyTexture. Returns false if the API or
+	// the texture does not support that; the CPU path is used then.
+	virtual bool GenerateTexture(void* textureHandle, int textureWidth, int textureHeight, float t) { return false; }
+
 
 	// Begin modifying vertex buffer data.
 	// Returns pointer into the data buffer to write into (or NULL on failure), and buffer size.
@@ -47,6 +69,33 @@ public:
 	// End modifying vertex buffer data.
 	virtual void EndModifyVertexBuffer(void* bufferHandle) = 0;
 
+	// Has the GPU write the vertex wave (see VertexKernel.h) for time t into the vertex buffer itself,
+	// instead of the CPU writing it through Begin/EndModifyVertexBuffer. The source mesh only needs to
+	// be copied to GPU memory when sourceVersion changes. Returns false if the API or the buffer does
+	// not support that; the CPU path is used then.
+	virtual bool DeformVertexBuffer(void* bufferHandle, int vertexCount, const MeshSource& source, unsigned int sourceVersion, float t) { return false; }
+
+	// Called around the work of each plugin render event, on the render thread. APIs that change state
+	// Unity keeps track of (OpenGL) put it back in EndRenderEvent.
+	virtual void BeginRenderEvent() {}
+	virtual void EndRenderEvent() {}
+
+	// Records the texture and buffer updates ended since the last call, on APIs that queue them up
+	// instead of recording each one (Vulkan). Called from a plugin event that runs outside of a render pass.
+	virtual void FlushUploads() {}
+
+	// Directory in which the API can keep caches that outlive the process (e.g. compiled pipelines),
+	// or empty for none. Called on the render thread; before the initialize device event when the
+	// directory is known by then.
+	virtual void SetCacheDirectory(const char* directory) {}
+
+	// Writes those caches to the cache directory now, on the render thread. Returns false if they could
+	// not be written.
+	virtual bool SaveCaches() { return true; }
+
+	// Fills in stats of the device memory the API sub-allocates; returns false if it does not.
+	virtual bool GetMemoryStats(PluginMemoryStats* stats) { return false; }
+
 	// --------------------------------------------------------------------------
 	// DX12 plugin specific functions
 	// --------------------------------------------------------------------------
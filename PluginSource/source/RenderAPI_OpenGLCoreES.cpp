@@ -7,12 +7,21 @@
 
 #if SUPPORT_OPENGL_UNIFIED
 
+#include "PluginProfiling.h"
 
 #include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
 #if UNITY_IOS || UNITY_TVOS
-#	include <OpenGLES/ES2/gl.h>
+#	include <OpenGLES/ES3/gl.h>
 #elif UNITY_ANDROID || UNITY_WEBGL
-#	include <GLES2/gl2.h>
+#	include <GLES3/gl3.h>
 #elif UNITY_OSX
 #	include <OpenGL/gl3.h>
 #elif UNITY_WIN
@@ -24,17 +33,409 @@
 #	define GL_GLEXT_PROTOTYPES
 #	include <GL/gl.h>
 #elif UNITY_EMBEDDED_LINUX
-#	include <GLES2/gl2.h>
+#	include <GLES3/gl3.h>
 #if SUPPORT_OPENGL_CORE
 #	define GL_GLEXT_PROTOTYPES
 #	include <GL/gl.h>
 #endif
 #elif UNITY_QNX
-#	include <GLES2/gl2.h>
+#	include <GLES3/gl3.h>
 #else
 #	error Unknown platform
 #endif
 
+// glBufferStorage (GL 4.4 or ARB_buffer_storage) is only declared by the Linux headers; macOS stops
+// at GL 4.1, and the gl3w here predates 4.4
+#if SUPPORT_OPENGL_CORE && UNITY_LINUX
+#	define SUPPORT_GL_BUFFER_STORAGE 1
+#endif
+// WebGL can't map buffers at all, nor hand out program binaries
+#if !UNITY_WEBGL
+#	define SUPPORT_GL_MAP_BUFFER_RANGE 1
+#	define SUPPORT_GL_PROGRAM_BINARY 1
+#endif
+// KHR_parallel_shader_compile (same value as in ARB_parallel_shader_compile); only this enum of it is
+// used, and not all headers have it
+#ifndef GL_COMPLETION_STATUS_KHR
+#	define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+
+// Shadow of the GL state the plugin changes. Unity may change any of it between plugin events, and
+// reading it back (glGet*, glIsEnabled) can make a threaded driver wait for its GL thread, so nothing is
+// read: within a render event (from the outermost Begin to its End) the first set of a state is always
+// made, and setting it again to the same value is skipped. Only states whose Unity value is known without
+// reading it start an event as known, and End puts them back if they were changed; the others are left
+// as the plugin set them.
+class GLStateCache
+{
+public:
+	GLStateCache();
+
+	void Begin();
+	void End();
+
+	void SetEnabled(GLenum cap, bool enabled); // GL_CULL_FACE, GL_BLEND or GL_DEPTH_TEST
+	void SetDepthFunc(GLenum func);
+	void SetDepthMask(bool write);
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vertexArray);
+	void BindArrayBuffer(GLuint buffer);
+	void BindPixelUnpackBuffer(GLuint buffer);
+	void BindTexture2D(GLuint texture);
+
+	// Deleting a bound buffer binds 0 in its place
+	void OnDeleteBuffer(GLuint buffer);
+
+private:
+	enum StateIndex
+	{
+		kStateCullFace,
+		kStateBlend,
+		kStateDepthTest,
+		kStateDepthFunc,
+		kStateDepthMask,
+		kStateProgram,
+		kStateVertexArray,
+		kStateArrayBuffer,
+		kStatePixelUnpackBuffer,
+		kStateTexture2D,
+		kStateCount
+	};
+
+	struct State
+	{
+		bool known; // set since Begin, or has a known Unity value
+		GLint value;
+	};
+
+	void Set(StateIndex index, GLint value);
+	static bool GetUnityValue(StateIndex index, GLint* value);
+	static void Apply(StateIndex index, GLint value);
+
+	State m_States[kStateCount];
+	int m_Depth; // of nested Begin calls
+};
+
+
+GLStateCache::GLStateCache()
+	: m_Depth(0)
+{
+	memset(m_States, 0, sizeof(m_States));
+}
+
+
+void GLStateCache::Begin()
+{
+	if (m_Depth++ > 0)
+		return;
+	for (int i = 0; i < kStateCount; ++i)
+	{
+		State& state = m_States[i];
+		state.known = GetUnityValue(StateIndex(i), &state.value);
+	}
+}
+
+
+void GLStateCache::End()
+{
+	assert(m_Depth > 0);
+	if (--m_Depth > 0)
+		return;
+	for (int i = 0; i < kStateCount; ++i)
+	{
+		State& state = m_States[i];
+		GLint unityValue;
+		if (state.known && GetUnityValue(StateIndex(i), &unityValue) && state.value != unityValue)
+			Apply(StateIndex(i), unityValue);
+		state.known = false;
+	}
+}
+
+
+void GLStateCache::SetEnabled(GLenum cap, bool enabled)
+{
+	const StateIndex index = cap == GL_CULL_FACE ? kStateCullFace : cap == GL_BLEND ? kStateBlend : kStateDepthTest;
+	assert(cap == GL_CULL_FACE || cap == GL_BLEND || cap == GL_DEPTH_TEST);
+	Set(index, enabled ? 1 : 0);
+}
+
+
+void GLStateCache::SetDepthFunc(GLenum func) { Set(kStateDepthFunc, GLint(func)); }
+void GLStateCache::SetDepthMask(bool write) { Set(kStateDepthMask, write ? 1 : 0); }
+void GLStateCache::UseProgram(GLuint program) { Set(kStateProgram, GLint(program)); }
+void GLStateCache::BindVertexArray(GLuint vertexArray) { Set(kStateVertexArray, GLint(vertexArray)); }
+void GLStateCache::BindArrayBuffer(GLuint buffer) { Set(kStateArrayBuffer, GLint(buffer)); }
+void GLStateCache::BindPixelUnpackBuffer(GLuint buffer) { Set(kStatePixelUnpackBuffer, GLint(buffer)); }
+void GLStateCache::BindTexture2D(GLuint texture) { Set(kStateTexture2D, GLint(texture)); }
+
+
+void GLStateCache::OnDeleteBuffer(GLuint buffer)
+{
+	const StateIndex bindings[] = { kStateArrayBuffer, kStatePixelUnpackBuffer };
+	for (int i = 0; i < 2; ++i)
+	{
+		State& state = m_States[bindings[i]];
+		if (state.known && state.value == GLint(buffer))
+			state.value = 0;
+	}
+}
+
+
+void GLStateCache::Set(StateIndex index, GLint value)
+{
+	State& state = m_States[index];
+	if (state.known && state.value == value)
+		return;
+	Apply(index, value);
+	state.known = true;
+	state.value = value;
+}
+
+
+// Unity uploads textures from client memory, so it keeps no pixel unpack buffer bound. The vertex array
+// goes back to 0 as well, as when the plugin did not keep one: left bound, the vertex attributes and
+// element buffer Unity sets next would go into the plugin's. The values of the other states change with
+// whatever Unity rendered last.
+bool GLStateCache::GetUnityValue(StateIndex index, GLint* value)
+{
+	if (index != kStatePixelUnpackBuffer && index != kStateVertexArray)
+		return false;
+	*value = 0;
+	return true;
+}
+
+
+void GLStateCache::Apply(StateIndex index, GLint value)
+{
+	switch (index)
+	{
+	case kStateCullFace: if (value) glEnable(GL_CULL_FACE); else glDisable(GL_CULL_FACE); break;
+	case kStateBlend: if (value) glEnable(GL_BLEND); else glDisable(GL_BLEND); break;
+	case kStateDepthTest: if (value) glEnable(GL_DEPTH_TEST); else glDisable(GL_DEPTH_TEST); break;
+	case kStateDepthFunc: glDepthFunc(GLenum(value)); break;
+	case kStateDepthMask: glDepthMask(value ? GL_TRUE : GL_FALSE); break;
+	case kStateProgram: glUseProgram(GLuint(value)); break;
+	case kStateVertexArray: glBindVertexArray(GLuint(value)); break;
+	case kStateArrayBuffer: glBindBuffer(GL_ARRAY_BUFFER, GLuint(value)); break;
+	case kStatePixelUnpackBuffer: glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GLuint(value)); break;
+	case kStateTexture2D: glBindTexture(GL_TEXTURE_2D, GLuint(value)); break;
+	default: break;
+	}
+}
+
+
+// Streaming vertex ring for DrawSimpleTriangles. Each write goes after the previous one, and a fence
+// marks when the GPU is done with it; space is only reused once its fence signaled, and the ring grows
+// instead of waiting when it runs into data still in use. So draws of any size neither overflow the
+// buffer nor make the driver synchronize with the GPU.
+//
+// With buffer storage the buffer stays mapped (persistent and coherent) and writes are plain copies.
+// Otherwise (ES 3.0, older GL) each write maps its range unsynchronized, which is safe since the
+// fences already keep it away from anything the GPU still reads.
+class GLStreamBuffer
+{
+public:
+	explicit GLStreamBuffer(GLStateCache* state);
+
+	bool Create(bool persistent, size_t capacity);
+	void Destroy();
+
+	// Copies size bytes into the ring at a multiple of alignment, and returns that offset in GetBuffer().
+	// The buffer may change, when the ring grows. Call Fence after the draws that read the data.
+	bool Write(const void* data, size_t size, size_t alignment, size_t* outOffset);
+	void Fence();
+
+	GLuint GetBuffer() const { return m_Buffer; }
+
+	// Changes each time a new buffer is created. The driver may give a new buffer the name of the
+	// one just deleted, so compare this rather than GetBuffer() to know whether the buffer changed.
+	unsigned int GetGeneration() const { return m_Generation; }
+
+private:
+	struct Region
+	{
+		GLsync fence; // NULL until Fence is called
+		size_t begin, end;
+	};
+
+	void RetireRegions();
+	bool IsInUse(size_t begin, size_t end) const;
+
+	GLStateCache* m_State; // binds the buffer
+	GLuint m_Buffer;
+	unsigned int m_Generation;
+	unsigned char* m_Mapped; // persistent mapping, or NULL
+	size_t m_Capacity;
+	size_t m_Offset; // where the next write goes
+	std::deque<Region> m_Regions; // written and not known to be read by the GPU yet, oldest first
+};
+
+
+GLStreamBuffer::GLStreamBuffer(GLStateCache* state)
+	: m_State(state)
+	, m_Buffer(0)
+	, m_Generation(0)
+	, m_Mapped(NULL)
+	, m_Capacity(0)
+	, m_Offset(0)
+{
+}
+
+
+bool GLStreamBuffer::Create(bool persistent, size_t capacity)
+{
+	glGenBuffers(1, &m_Buffer);
+	m_State->BindArrayBuffer(m_Buffer);
+#	if SUPPORT_GL_BUFFER_STORAGE
+	if (persistent)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, capacity, NULL, flags);
+		m_Mapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, capacity, flags);
+		if (!m_Mapped)
+		{
+			// Immutable storage can't be respecified; start over with a buffer that is mapped per write
+			glDeleteBuffers(1, &m_Buffer);
+			m_State->OnDeleteBuffer(m_Buffer);
+			glGenBuffers(1, &m_Buffer);
+			m_State->BindArrayBuffer(m_Buffer);
+			persistent = false;
+		}
+	}
+#	else
+	persistent = false;
+#	endif // if SUPPORT_GL_BUFFER_STORAGE
+	if (!persistent)
+		glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+	if (glGetError() == GL_OUT_OF_MEMORY)
+	{
+		Destroy();
+		return false;
+	}
+	m_Capacity = capacity;
+	m_Offset = 0;
+	++m_Generation;
+	return true;
+}
+
+
+void GLStreamBuffer::Destroy()
+{
+	// Deleting fences and buffers the GPU still uses is fine; GL frees them when it is done
+	for (size_t i = 0; i < m_Regions.size(); ++i)
+	{
+		if (m_Regions[i].fence)
+			glDeleteSync(m_Regions[i].fence);
+	}
+	m_Regions.clear();
+	if (m_Mapped)
+	{
+		m_State->BindArrayBuffer(m_Buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		m_Mapped = NULL;
+	}
+	if (m_Buffer)
+	{
+		glDeleteBuffers(1, &m_Buffer);
+		m_State->OnDeleteBuffer(m_Buffer);
+	}
+	m_Buffer = 0;
+	m_Capacity = 0;
+	m_Offset = 0;
+}
+
+
+// Drops the regions the GPU is done with; fences signal in the order they were inserted
+void GLStreamBuffer::RetireRegions()
+{
+	while (!m_Regions.empty() && m_Regions.front().fence)
+	{
+		const GLenum status = glClientWaitSync(m_Regions.front().fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+			break;
+		glDeleteSync(m_Regions.front().fence);
+		m_Regions.pop_front();
+	}
+}
+
+
+bool GLStreamBuffer::IsInUse(size_t begin, size_t end) const
+{
+	for (size_t i = 0; i < m_Regions.size(); ++i)
+	{
+		if (begin < m_Regions[i].end && m_Regions[i].begin < end)
+			return true;
+	}
+	return false;
+}
+
+
+bool GLStreamBuffer::Write(const void* data, size_t size, size_t alignment, size_t* outOffset)
+{
+	if (!m_Buffer || size == 0)
+		return false;
+
+	// Data of an earlier write that was not fenced: commands issued so far are the ones reading it
+	if (!m_Regions.empty() && !m_Regions.back().fence)
+		Fence();
+	RetireRegions();
+
+	size_t offset = (m_Offset + alignment - 1) / alignment * alignment;
+	if (offset + size > m_Capacity)
+		offset = 0; // wrap around
+	if (offset + size > m_Capacity || IsInUse(offset, offset + size))
+	{
+		// Rather than wait for the GPU, continue in a bigger buffer; the old one is freed once the GPU is done
+		PROFILE_SCOPE("GLStreamBuffer::Grow");
+		size_t capacity = m_Capacity * 2;
+		while (capacity < size)
+			capacity *= 2;
+		const bool persistent = m_Mapped != NULL;
+		Destroy();
+		if (!Create(persistent, capacity))
+			return false;
+		offset = 0;
+	}
+
+	if (m_Mapped)
+	{
+		memcpy(m_Mapped + offset, data, size);
+	}
+	else
+	{
+		m_State->BindArrayBuffer(m_Buffer);
+#		if SUPPORT_GL_MAP_BUFFER_RANGE
+		void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (mapped)
+		{
+			memcpy(mapped, data, size);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		}
+		else
+#		endif // if SUPPORT_GL_MAP_BUFFER_RANGE
+		{
+			glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+		}
+	}
+
+	Region region;
+	region.fence = NULL;
+	region.begin = offset;
+	region.end = offset + size;
+	m_Regions.push_back(region);
+	m_Offset = offset + size;
+	*outOffset = offset;
+	return true;
+}
+
+
+void GLStreamBuffer::Fence()
+{
+	if (!m_Regions.empty() && !m_Regions.back().fence)
+		m_Regions.back().fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
 
 class RenderAPI_OpenGLCoreES : public RenderAPI
 {
@@ -54,18 +455,83 @@ public:
 	virtual void* BeginModifyVertexBuffer(void* bufferHandle, size_t* outBufferSize);
 	virtual void EndModifyVertexBuffer(void* bufferHandle);
 
+	virtual void BeginRenderEvent() { m_State.Begin(); }
+	virtual void EndRenderEvent() { m_State.End(); }
+
+	virtual void SetCacheDirectory(const char* directory);
+	virtual bool SaveCaches();
+
 private:
 	void CreateResources();
+	void ReleaseResources();
+	bool HasBufferStorage();
+	void CompileProgram();
+	bool LoadProgramBinary();
+	bool FinishProgram(bool wait);
+	bool SaveProgramBinary();
+	void DeleteProgram();
+	void RecordVertexUpload(unsigned long long durationNs);
 
 private:
 	UnityGfxRenderer m_APIType;
 	GLuint m_VertexShader;
 	GLuint m_FragmentShader;
 	GLuint m_Program;
-	GLuint m_VertexArray;
-	GLuint m_VertexBuffer;
+	const char* m_VertexShaderSource;
+	const char* m_FragmentShaderSource;
+	// m_Program is created the first time it is used (FinishProgram): by then a script has set the cache
+	// directory, which may have a binary of it from an earlier run
+	bool m_ProgramFromBinary;
+	bool m_ProgramReady;
+	bool m_ParallelShaderCompile; // KHR_parallel_shader_compile: the driver links programs on threads of its own
+	uint64_t m_ProgramKey; // of its binary in the cache directory; 0 if the driver can't hand out binaries
+	GLenum m_ProgramBinaryFormat;
+	std::vector<unsigned char> m_ProgramBinary; // from glGetProgramBinary, until it is written to the cache directory
+	std::string m_CacheDirectory;
+	GLuint m_VertexArray; // vertex layout of DrawSimpleTriangles, set up once
+	unsigned int m_VertexArrayGeneration; // m_StreamBuffer generation m_VertexArray reads from, 0 for none
+	GLStateCache m_State;
+	GLStreamBuffer m_StreamBuffer; // vertices of DrawSimpleTriangles
+	float m_WorldMatrix[16]; // last value of the worldMatrix uniform
 	int m_UniformWorldMatrix;
 	int m_UniformProjMatrix;
+
+	// Pixel unpack buffers BeginModifyTexture hands out mapped, used in turn; a fence after the upload
+	// from one marks when it can be written again
+	struct TextureUploadBuffer
+	{
+		GLuint buffer;
+		size_t size;
+		GLsync fence;
+	};
+	enum { kTextureUploadBuffers = 3 };
+	TextureUploadBuffer m_TextureUploadBuffers[kTextureUploadBuffers];
+	int m_NextTextureUploadBuffer;
+	void* m_MappedTextureData; // of m_TextureUploadBuffers[m_MappedTextureUploadBuffer], between Begin/EndModifyTexture
+	int m_MappedTextureUploadBuffer;
+
+	// How BeginModifyVertexBuffer hands out the vertex buffer: mapped, or as a copy in system memory that
+	// EndModifyVertexBuffer uploads with glBufferSubData. Which one is faster depends on the driver, so the
+	// first modifications of a buffer try both in turn, and the one that took less time is used from then on.
+	enum VertexUploadMode
+	{
+		kVertexUploadMap,
+		kVertexUploadStaging,
+		kVertexUploadModeCount
+	};
+	struct VertexUpload
+	{
+		GLuint buffer;
+		size_t size;
+		std::vector<unsigned char> staging; // contents of buffer; read back the first time it is needed
+		int modifyCount; // of buffer, since it was last measured
+		unsigned long long measuredNs[kVertexUploadModeCount]; // total, of measuredCount modifications
+		int measuredCount[kVertexUploadModeCount];
+		VertexUploadMode mode; // used from then on
+		VertexUploadMode current; // of the modification between Begin/EndModifyVertexBuffer
+		unsigned long long beginNs;
+	};
+	VertexUpload m_VertexUpload;
 };
 
 
@@ -128,6 +594,26 @@ static const char* kGlesFShaderTextGLCore = FRAGMENT_SHADER_SRC("#version 150\n"
 #undef FRAGMENT_SHADER_SRC
 
 
+// Size the vertex ring starts with; it grows when draws need more
+static const size_t kStreamBufferInitialSize = 64 * 1024;
+
+
+#if SUPPORT_GL_MAP_BUFFER_RANGE
+// Vertex buffer modifications BeginModifyVertexBuffer times with each way of handing out the buffer
+// before it picks one, after a first one that is not counted; and how many later ones it uses that
+// for before measuring again
+static const int kVertexUploadMeasureCount = 8;
+static const int kVertexUploadRemeasureInterval = 3600;
+static const int kVertexUploadMeasureEnd = 2 * (kVertexUploadMeasureCount + 1);
+
+
+static unsigned long long GetTimeNs()
+{
+	return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif // if SUPPORT_GL_MAP_BUFFER_RANGE
+
+
 static GLuint CreateShader(GLenum type, const char* sourceText)
 {
 	GLuint ret = glCreateShader(type);
@@ -137,8 +623,131 @@ static GLuint CreateShader(GLenum type, const char* sourceText)
 }
 
 
+static bool HasGLExtension(const char* name)
+{
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; i < extensionCount; ++i)
+	{
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension && strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+
+#if SUPPORT_GL_PROGRAM_BINARY
+// File a linked program is kept in: this header, then the data from glGetProgramBinary. Drivers only
+// take back binaries they wrote themselves, so each program has a file of its own, named after a hash
+// of the GL renderer and version strings and the shader sources (the key); the header has the key too.
+struct ProgramBinaryFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint64_t dataHash;
+	uint32_t binaryFormat;
+	uint32_t dataSize;
+};
+
+static const uint32_t kProgramBinaryFileMagic = 0x42505052; // "RPPB"
+static const uint32_t kProgramBinaryFileVersion = 1;
+
+// FNV-1a; chain calls by passing the previous result as hash
+static uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i)
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	return hash;
+}
+
+// The terminating zeros are hashed too, so that moving text from one string to the next changes the key
+static uint64_t GetProgramBinaryKey(const char* vertexSource, const char* fragmentSource)
+{
+	const char* strings[] = { (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION), vertexSource, fragmentSource };
+	uint64_t key = HashBytes(&kProgramBinaryFileVersion, sizeof(kProgramBinaryFileVersion));
+	for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); ++i)
+	{
+		const char* string = strings[i] ? strings[i] : "";
+		key = HashBytes(string, strlen(string) + 1, key);
+	}
+	return key != 0 ? key : 1;
+}
+
+static std::string GetProgramBinaryPath(const std::string& directory, uint64_t key)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "/RenderingPluginGLProgram_%016llx.bin", (unsigned long long)key);
+	return directory + name;
+}
+
+// Reads a file written by WriteProgramBinaryFile; returns false (leaving data empty and outFormat as it
+// was) if there is none for this key, or it is damaged
+static bool ReadProgramBinaryFile(const std::string& path, uint64_t key, GLenum* outFormat, std::vector<unsigned char>* data)
+{
+	data->clear();
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+
+	ProgramBinaryFileHeader header;
+	memset(&header, 0, sizeof(header));
+	bool ok = fread(&header, sizeof(header), 1, file) == 1;
+	ok = ok && header.magic == kProgramBinaryFileMagic && header.version == kProgramBinaryFileVersion
+		&& header.key == key && header.dataSize > 0;
+	if (ok)
+	{
+		data->resize(header.dataSize);
+		ok = fread(&(*data)[0], header.dataSize, 1, file) == 1 && fgetc(file) == EOF
+			&& HashBytes(&(*data)[0], data->size()) == header.dataHash;
+	}
+	fclose(file);
+
+	if (ok)
+		*outFormat = header.binaryFormat;
+	else
+		data->clear();
+	return ok;
+}
+
+// Writes to a temporary file first, so that a crash halfway through never leaves a truncated binary.
+static bool WriteProgramBinaryFile(const std::string& path, uint64_t key, GLenum format, const std::vector<unsigned char>& data)
+{
+	ProgramBinaryFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = kProgramBinaryFileMagic;
+	header.version = kProgramBinaryFileVersion;
+	header.key = key;
+	header.dataHash = HashBytes(&data[0], data.size());
+	header.binaryFormat = format;
+	header.dataSize = static_cast<uint32_t>(data.size());
+
+	const std::string tempPath = path + ".tmp";
+	FILE* file = fopen(tempPath.c_str(), "wb");
+	if (!file)
+		return false;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(&data[0], data.size(), 1, file) == 1;
+	ok = (fclose(file) == 0) && ok;
+
+	if (ok)
+	{
+		remove(path.c_str()); // rename does not replace existing files everywhere
+		ok = rename(tempPath.c_str(), path.c_str()) == 0;
+	}
+	if (!ok)
+		remove(tempPath.c_str());
+	return ok;
+}
+#endif // if SUPPORT_GL_PROGRAM_BINARY
+
+
 void RenderAPI_OpenGLCoreES::CreateResources()
 {
+	PROFILE_SCOPE("RenderAPI_OpenGLCoreES::CreateResources");
+
 #	if UNITY_WIN && SUPPORT_OPENGL_CORE
 	if (m_APIType == kUnityGfxRendererOpenGLCore)
 		gl3wInit();
@@ -146,27 +755,92 @@ void RenderAPI_OpenGLCoreES::CreateResources()
 	// Make sure that there are no GL error flags set before creating resources
 	while (glGetError() != GL_NO_ERROR) {}
 
-	// Create shaders
+	// Shader sources
 	if (m_APIType == kUnityGfxRendererOpenGLES30)
 	{
-		m_VertexShader = CreateShader(GL_VERTEX_SHADER, kGlesVProgTextGLES2);
-		m_FragmentShader = CreateShader(GL_FRAGMENT_SHADER, kGlesFShaderTextGLES2);
+		m_VertexShaderSource = kGlesVProgTextGLES2;
+		m_FragmentShaderSource = kGlesFShaderTextGLES2;
 	}
 	else if (m_APIType == kUnityGfxRendererOpenGLES30)
 	{
-		m_VertexShader = CreateShader(GL_VERTEX_SHADER, kGlesVProgTextGLES3);
-		m_FragmentShader = CreateShader(GL_FRAGMENT_SHADER, kGlesFShaderTextGLES3);
+		m_VertexShaderSource = kGlesVProgTextGLES3;
+		m_FragmentShaderSource = kGlesFShaderTextGLES3;
 	}
 #	if SUPPORT_OPENGL_CORE
 	else if (m_APIType == kUnityGfxRendererOpenGLCore)
 	{
-		m_VertexShader = CreateShader(GL_VERTEX_SHADER, kGlesVProgTextGLCore);
-		m_FragmentShader = CreateShader(GL_FRAGMENT_SHADER, kGlesFShaderTextGLCore);
+		m_VertexShaderSource = kGlesVProgTextGLCore;
+		m_FragmentShaderSource = kGlesFShaderTextGLCore;
 	}
 #	endif // if SUPPORT_OPENGL_CORE
 
+	// The program itself is only created when it is first used, see FinishProgram
+	m_ParallelShaderCompile = HasGLExtension("GL_KHR_parallel_shader_compile") || HasGLExtension("GL_ARB_parallel_shader_compile");
+	m_ProgramKey = 0;
+#	if SUPPORT_GL_PROGRAM_BINARY
+	GLint binaryFormatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormatCount);
+	if (binaryFormatCount > 0)
+		m_ProgramKey = GetProgramBinaryKey(m_VertexShaderSource, m_FragmentShaderSource);
+#	endif // if SUPPORT_GL_PROGRAM_BINARY
+
+	m_State.Begin();
+
+	// Create the vertex ring, and the vertex layout that reads from it. Vertex arrays are in ES 3.0 too;
+	// the element buffer binding stays 0 in it
+	m_StreamBuffer.Create(HasBufferStorage(), kStreamBufferInitialSize);
+	glGenVertexArrays(1, &m_VertexArray);
+	m_State.BindVertexArray(m_VertexArray);
+	glEnableVertexAttribArray(kVertexInputPosition);
+	glEnableVertexAttribArray(kVertexInputColor);
+
+	m_State.End();
+
+	assert(glGetError() == GL_NO_ERROR);
+}
+
+
+void RenderAPI_OpenGLCoreES::ReleaseResources()
+{
+	m_State.Begin();
+	m_StreamBuffer.Destroy();
+	m_State.End();
+	for (int i = 0; i < kTextureUploadBuffers; ++i)
+	{
+		TextureUploadBuffer& upload = m_TextureUploadBuffers[i];
+		if (upload.fence)
+			glDeleteSync(upload.fence);
+		if (upload.buffer)
+			glDeleteBuffers(1, &upload.buffer);
+	}
+	memset(m_TextureUploadBuffers, 0, sizeof(m_TextureUploadBuffers));
+	// Measured again with the next device
+	m_VertexUpload.buffer = 0;
+	m_VertexUpload.staging.clear();
+	glDeleteVertexArrays(1, &m_VertexArray);
+	DeleteProgram();
+	m_VertexArray = 0;
+	m_VertexArrayGeneration = 0;
+}
+
+
+void RenderAPI_OpenGLCoreES::DeleteProgram()
+{
+	glDeleteProgram(m_Program);
+	glDeleteShader(m_VertexShader);
+	glDeleteShader(m_FragmentShader);
+	m_Program = m_VertexShader = m_FragmentShader = 0;
+	m_ProgramReady = false;
+}
+
+
+// Starts compiling and linking m_Program from the shader sources
+void RenderAPI_OpenGLCoreES::CompileProgram()
+{
+	PROFILE_SCOPE("RenderAPI_OpenGLCoreES::CompileProgram");
+	m_VertexShader = CreateShader(GL_VERTEX_SHADER, m_VertexShaderSource);
+	m_FragmentShader = CreateShader(GL_FRAGMENT_SHADER, m_FragmentShaderSource);
 
-	// Link shaders into a program and find uniform locations
 	m_Program = glCreateProgram();
 	glBindAttribLocation(m_Program, kVertexInputPosition, "pos");
 	glBindAttribLocation(m_Program, kVertexInputColor, "color");
@@ -176,27 +850,170 @@ void RenderAPI_OpenGLCoreES::CreateResources()
 	if (m_APIType == kUnityGfxRendererOpenGLCore)
 		glBindFragDataLocation(m_Program, 0, "fragColor");
 #	endif // if SUPPORT_OPENGL_CORE
+#	if SUPPORT_GL_PROGRAM_BINARY
+	if (m_ProgramKey != 0)
+		glProgramParameteri(m_Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#	endif // if SUPPORT_GL_PROGRAM_BINARY
 	glLinkProgram(m_Program);
+	m_ProgramFromBinary = false;
+}
+
+
+// Creates m_Program from the binary of it in the cache directory, if there is one. The attribute and
+// fragment output locations are part of the binary.
+bool RenderAPI_OpenGLCoreES::LoadProgramBinary()
+{
+#	if SUPPORT_GL_PROGRAM_BINARY
+	if (m_CacheDirectory.empty() || m_ProgramKey == 0)
+		return false;
+
+	PROFILE_SCOPE("RenderAPI_OpenGLCoreES::LoadProgramBinary");
+	GLenum format = 0;
+	std::vector<unsigned char> data;
+	if (!ReadProgramBinaryFile(GetProgramBinaryPath(m_CacheDirectory, m_ProgramKey), m_ProgramKey, &format, &data))
+		return false;
+	m_Program = glCreateProgram();
+	glProgramBinary(m_Program, format, &data[0], GLsizei(data.size()));
+	m_ProgramFromBinary = true;
+	m_ProgramBinary.clear();
+	return true;
+#	else
+	return false;
+#	endif // if SUPPORT_GL_PROGRAM_BINARY
+}
 
-	GLint status = 0;
+
+// Creates m_Program (from its binary, else from the sources), checks that it linked, compiles it from
+// the sources after all if the binary was turned down, and sets up its uniforms. Returns false if wait
+// is false and the driver is still compiling it on its own threads (KHR_parallel_shader_compile); call
+// again later then. Without that extension, the driver compiles it right here.
+bool RenderAPI_OpenGLCoreES::FinishProgram(bool wait)
+{
+	if (m_ProgramReady)
+		return true;
+	if (!m_Program && !LoadProgramBinary())
+		CompileProgram();
+	if (!wait && m_ParallelShaderCompile)
+	{
+		GLint completed = GL_FALSE;
+		glGetProgramiv(m_Program, GL_COMPLETION_STATUS_KHR, &completed);
+		if (completed != GL_TRUE)
+			return false;
+	}
+
+	PROFILE_SCOPE("RenderAPI_OpenGLCoreES::FinishProgram");
+	GLint status = GL_FALSE;
 	glGetProgramiv(m_Program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE && m_ProgramFromBinary)
+	{
+		// E.g. the driver was updated without the version string changing. glProgramBinary may have set
+		// an error flag too.
+		while (glGetError() != GL_NO_ERROR) {}
+		DeleteProgram();
+		CompileProgram();
+		return FinishProgram(wait);
+	}
 	assert(status == GL_TRUE);
 
 	m_UniformWorldMatrix = glGetUniformLocation(m_Program, "worldMatrix");
 	m_UniformProjMatrix = glGetUniformLocation(m_Program, "projMatrix");
 
-	// Create vertex buffer
-	glGenBuffers(1, &m_VertexBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, m_VertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, 1024, NULL, GL_STREAM_DRAW);
+	// Tweak the projection matrix a bit to make it match what identity projection would do in D3D case.
+	// It never changes, and uniforms keep their values in the program, so it is only set here.
+	const float projectionMatrix[16] = {
+		1,0,0,0,
+		0,1,0,0,
+		0,0,2,0,
+		0,0,-1,1,
+	};
+	m_State.Begin();
+	m_State.UseProgram(m_Program);
+	glUniformMatrix4fv(m_UniformProjMatrix, 1, GL_FALSE, projectionMatrix);
+	glUniformMatrix4fv(m_UniformWorldMatrix, 1, GL_FALSE, m_WorldMatrix);
+	m_State.End();
 
-	assert(glGetError() == GL_NO_ERROR);
+#	if SUPPORT_GL_PROGRAM_BINARY
+	// Kept until the cache directory is known and the caches are saved
+	if (m_ProgramKey != 0 && !m_ProgramFromBinary)
+	{
+		GLint size = 0;
+		glGetProgramiv(m_Program, GL_PROGRAM_BINARY_LENGTH, &size);
+		m_ProgramBinary.resize(size > 0 ? size : 0);
+		GLsizei length = 0;
+		if (size > 0)
+			glGetProgramBinary(m_Program, size, &length, &m_ProgramBinaryFormat, &m_ProgramBinary[0]);
+		m_ProgramBinary.resize(length > 0 ? length : 0);
+	}
+#	endif // if SUPPORT_GL_PROGRAM_BINARY
+
+	m_ProgramReady = true;
+	return true;
+}
+
+
+// Writes the binary FinishProgram read back to the cache directory, once
+bool RenderAPI_OpenGLCoreES::SaveProgramBinary()
+{
+#	if SUPPORT_GL_PROGRAM_BINARY
+	if (m_CacheDirectory.empty() || m_ProgramBinary.empty())
+		return true;
+
+	PROFILE_SCOPE("RenderAPI_OpenGLCoreES::SaveProgramBinary");
+	if (!WriteProgramBinaryFile(GetProgramBinaryPath(m_CacheDirectory, m_ProgramKey), m_ProgramKey, m_ProgramBinaryFormat, m_ProgramBinary))
+		return false;
+	m_ProgramBinary.clear();
+#	endif // if SUPPORT_GL_PROGRAM_BINARY
+	return true;
+}
+
+
+// Whether the vertex ring can be persistently mapped: GL 4.4, or ARB_buffer_storage before that
+bool RenderAPI_OpenGLCoreES::HasBufferStorage()
+{
+#	if SUPPORT_GL_BUFFER_STORAGE
+	if (m_APIType != kUnityGfxRendererOpenGLCore)
+		return false;
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major > 4 || (major == 4 && minor >= 4))
+		return true;
+	if (HasGLExtension("GL_ARB_buffer_storage"))
+		return true;
+#	endif // if SUPPORT_GL_BUFFER_STORAGE
+	return false;
 }
 
 
 RenderAPI_OpenGLCoreES::RenderAPI_OpenGLCoreES(UnityGfxRenderer apiType)
 	: m_APIType(apiType)
+	, m_VertexShader(0)
+	, m_FragmentShader(0)
+	, m_Program(0)
+	, m_VertexShaderSource(NULL)
+	, m_FragmentShaderSource(NULL)
+	, m_ProgramFromBinary(false)
+	, m_ProgramReady(false)
+	, m_ParallelShaderCompile(false)
+	, m_ProgramKey(0)
+	, m_ProgramBinaryFormat(0)
+	, m_VertexArray(0)
+	, m_VertexArrayGeneration(0)
+	, m_StreamBuffer(&m_State)
+	, m_NextTextureUploadBuffer(0)
+	, m_MappedTextureData(NULL)
+	, m_MappedTextureUploadBuffer(-1)
 {
+	memset(m_WorldMatrix, 0, sizeof(m_WorldMatrix));
+	memset(m_TextureUploadBuffers, 0, sizeof(m_TextureUploadBuffers));
+	m_VertexUpload.buffer = 0;
+	m_VertexUpload.size = 0;
+	m_VertexUpload.modifyCount = 0;
+	memset(m_VertexUpload.measuredNs, 0, sizeof(m_VertexUpload.measuredNs));
+	memset(m_VertexUpload.measuredCount, 0, sizeof(m_VertexUpload.measuredCount));
+	m_VertexUpload.mode = kVertexUploadMap;
+	m_VertexUpload.current = kVertexUploadMap;
+	m_VertexUpload.beginNs = 0;
 }
 
 
@@ -208,73 +1025,127 @@ void RenderAPI_OpenGLCoreES::ProcessDeviceEvent(UnityGfxDeviceEventType type, IU
 	}
 	else if (type == kUnityGfxDeviceEventShutdown)
 	{
-		//@TODO: release resources
+		SaveProgramBinary();
+		ReleaseResources();
 	}
 }
 
 
-void RenderAPI_OpenGLCoreES::DrawSimpleTriangles(const float worldMatrix[16], int triangleCount, const void* verticesFloat3Byte4)
+void RenderAPI_OpenGLCoreES::SetCacheDirectory(const char* directory)
 {
-	// Set basic render state
-	glDisable(GL_CULL_FACE);
-	glDisable(GL_BLEND);
-	glDepthFunc(GL_LEQUAL);
-	glEnable(GL_DEPTH_TEST);
-	glDepthMask(GL_FALSE);
+	m_CacheDirectory = directory;
+}
 
-	// Tweak the projection matrix a bit to make it match what identity projection would do in D3D case.
-	float projectionMatrix[16] = {
-		1,0,0,0,
-		0,1,0,0,
-		0,0,2,0,
-		0,0,-1,1,
-	};
 
-	// Setup shader program to use, and the matrices
-	glUseProgram(m_Program);
-	glUniformMatrix4fv(m_UniformWorldMatrix, 1, GL_FALSE, worldMatrix);
-	glUniformMatrix4fv(m_UniformProjMatrix, 1, GL_FALSE, projectionMatrix);
+// Called on the render thread (render event 4), like FinishProgram, which fills in m_ProgramBinary, and
+// the shutdown device event; so neither m_ProgramBinary nor m_CacheDirectory needs a lock
+bool RenderAPI_OpenGLCoreES::SaveCaches()
+{
+	return SaveProgramBinary();
+}
 
-	// Core profile needs VAOs, setup one
-#	if SUPPORT_OPENGL_CORE
-	if (m_APIType == kUnityGfxRendererOpenGLCore)
-	{
-		glGenVertexArrays(1, &m_VertexArray);
-		glBindVertexArray(m_VertexArray);
-	}
-#	endif // if SUPPORT_OPENGL_CORE
 
-	// Bind a vertex buffer, and update data in it
+void RenderAPI_OpenGLCoreES::DrawSimpleTriangles(const float worldMatrix[16], int triangleCount, const void* verticesFloat3Byte4)
+{
+	if (triangleCount <= 0)
+		return;
+	m_State.Begin();
+
+	// Put the vertices into the ring; the offset is a whole number of vertices
 	const int kVertexSize = 12 + 4;
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, m_VertexBuffer);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, kVertexSize * triangleCount * 3, verticesFloat3Byte4);
+	size_t vertexOffset = 0;
+	if (!m_StreamBuffer.Write(verticesFloat3Byte4, size_t(kVertexSize) * triangleCount * 3, kVertexSize, &vertexOffset))
+	{
+		m_State.End();
+		return;
+	}
 
-	// Setup vertex layout
-	glEnableVertexAttribArray(kVertexInputPosition);
-	glVertexAttribPointer(kVertexInputPosition, 3, GL_FLOAT, GL_FALSE, kVertexSize, (char*)NULL + 0);
-	glEnableVertexAttribArray(kVertexInputColor);
-	glVertexAttribPointer(kVertexInputColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, kVertexSize, (char*)NULL + 12);
+	// Set basic render state
+	m_State.SetEnabled(GL_CULL_FACE, false);
+	m_State.SetEnabled(GL_BLEND, false);
+	m_State.SetDepthFunc(GL_LEQUAL);
+	m_State.SetEnabled(GL_DEPTH_TEST, true);
+	m_State.SetDepthMask(false);
 
-	// Draw
-	glDrawArrays(GL_TRIANGLES, 0, triangleCount * 3);
+	// Setup shader program to use, and the world matrix; the projection matrix is set when the program
+	// is created. The triangles are left out while the driver is still compiling it on its threads.
+	if (!FinishProgram(false))
+	{
+		m_State.End();
+		return;
+	}
+	m_State.UseProgram(m_Program);
+	if (memcmp(m_WorldMatrix, worldMatrix, sizeof(m_WorldMatrix)) != 0)
+	{
+		memcpy(m_WorldMatrix, worldMatrix, sizeof(m_WorldMatrix));
+		glUniformMatrix4fv(m_UniformWorldMatrix, 1, GL_FALSE, worldMatrix);
+	}
 
-	// Cleanup VAO
-#	if SUPPORT_OPENGL_CORE
-	if (m_APIType == kUnityGfxRendererOpenGLCore)
+	// The vertex layout only needs to be pointed at the ring again when it grew into a new buffer
+	m_State.BindVertexArray(m_VertexArray);
+	if (m_VertexArrayGeneration != m_StreamBuffer.GetGeneration())
 	{
-		glDeleteVertexArrays(1, &m_VertexArray);
+		m_VertexArrayGeneration = m_StreamBuffer.GetGeneration();
+		m_State.BindArrayBuffer(m_StreamBuffer.GetBuffer());
+		glVertexAttribPointer(kVertexInputPosition, 3, GL_FLOAT, GL_FALSE, kVertexSize, (char*)NULL + 0);
+		glVertexAttribPointer(kVertexInputColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, kVertexSize, (char*)NULL + 12);
 	}
-#	endif
+
+	// Draw, and fence the vertices
+	glDrawArrays(GL_TRIANGLES, GLint(vertexOffset / kVertexSize), triangleCount * 3);
+	m_StreamBuffer.Fence();
+
+	m_State.End();
 }
 
 
+// The texture data is written straight into a mapped pixel unpack buffer, and uploaded from it: no heap
+// buffer, no copy on the CPU, and the driver can transfer it to the texture whenever it suits it.
 void* RenderAPI_OpenGLCoreES::BeginModifyTexture(void* textureHandle, int textureWidth, int textureHeight, int* outRowPitch)
 {
 	const int rowPitch = textureWidth * 4;
+	*outRowPitch = rowPitch;
+
+#	if SUPPORT_GL_MAP_BUFFER_RANGE
+	if (m_MappedTextureUploadBuffer < 0)
+	{
+		const size_t size = size_t(rowPitch) * textureHeight;
+		TextureUploadBuffer& upload = m_TextureUploadBuffers[m_NextTextureUploadBuffer];
+		// Normally long done: the GPU would have to be kTextureUploadBuffers uploads behind. Only polled,
+		// never waited for: while it is still in use, this upload goes through system memory instead.
+		if (upload.fence)
+		{
+			const GLenum status = glClientWaitSync(upload.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+				return new unsigned char[size];
+			glDeleteSync(upload.fence);
+			upload.fence = NULL;
+		}
+
+		m_State.Begin();
+		if (!upload.buffer)
+			glGenBuffers(1, &upload.buffer);
+		m_State.BindPixelUnpackBuffer(upload.buffer);
+		if (upload.size != size)
+		{
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+			upload.size = size;
+		}
+		// Unsynchronized is safe, the fence above said the GPU is done with it
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		m_State.End();
+		if (mapped)
+		{
+			m_MappedTextureData = mapped;
+			m_MappedTextureUploadBuffer = m_NextTextureUploadBuffer;
+			m_NextTextureUploadBuffer = (m_NextTextureUploadBuffer + 1) % kTextureUploadBuffers;
+			return mapped;
+		}
+	}
+#	endif // if SUPPORT_GL_MAP_BUFFER_RANGE
+
 	// Just allocate a system memory buffer here for simplicity
 	unsigned char* data = new unsigned char[rowPitch * textureHeight];
-	*outRowPitch = rowPitch;
 	return data;
 }
 
@@ -282,33 +1153,138 @@ void* RenderAPI_OpenGLCoreES::BeginModifyTexture(void* textureHandle, int textur
 void RenderAPI_OpenGLCoreES::EndModifyTexture(void* textureHandle, int textureWidth, int textureHeight, int rowPitch, void* dataPtr)
 {
 	GLuint gltex = (GLuint)(size_t)(textureHandle);
-	// Update texture data, and free the memory buffer
-	glBindTexture(GL_TEXTURE_2D, gltex);
+	m_State.Begin();
+	if (dataPtr && dataPtr == m_MappedTextureData)
+	{
+		// Upload from the buffer; a NULL pointer is offset 0 into it. If unmapping fails, the contents
+		// were lost (e.g. to a display mode change), and the texture keeps the previous frame.
+		TextureUploadBuffer& upload = m_TextureUploadBuffers[m_MappedTextureUploadBuffer];
+		m_State.BindPixelUnpackBuffer(upload.buffer);
+		if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE)
+		{
+			m_State.BindTexture2D(gltex);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, textureWidth, textureHeight, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		}
+		upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_MappedTextureData = NULL;
+		m_MappedTextureUploadBuffer = -1;
+		m_State.End();
+		return;
+	}
+
+	// Update texture data, and free the memory buffer; from client memory, so no unpack buffer bound
+	m_State.BindPixelUnpackBuffer(0);
+	m_State.BindTexture2D(gltex);
 	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, textureWidth, textureHeight, GL_RGBA, GL_UNSIGNED_BYTE, dataPtr);
+	m_State.End();
 	delete[](unsigned char*)dataPtr;
 }
 
+// The measured time runs from BeginModifyVertexBuffer to the end of EndModifyVertexBuffer, so it includes
+// writing the vertices too: mapped memory can be a lot slower to write than system memory.
 void* RenderAPI_OpenGLCoreES::BeginModifyVertexBuffer(void* bufferHandle, size_t* outBufferSize)
 {
-#	if SUPPORT_OPENGL_ES
-	return 0;
-#	else
-	glBindBuffer(GL_ARRAY_BUFFER, (GLuint)(size_t)bufferHandle);
+#	if SUPPORT_GL_MAP_BUFFER_RANGE
+	VertexUpload& upload = m_VertexUpload;
+	const unsigned long long beginNs = GetTimeNs();
+	const GLuint buffer = (GLuint)(size_t)bufferHandle;
+	m_State.Begin();
+	m_State.BindArrayBuffer(buffer);
 	GLint size = 0;
 	glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+	if (buffer != upload.buffer || size_t(size) != upload.size)
+	{
+		upload.buffer = buffer;
+		upload.size = size;
+		upload.staging.clear();
+		upload.modifyCount = 0;
+		memset(upload.measuredNs, 0, sizeof(upload.measuredNs));
+		memset(upload.measuredCount, 0, sizeof(upload.measuredCount));
+	}
 	*outBufferSize = size;
-	void* mapped = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-	return mapped;
-#	endif
+	if (size <= 0)
+	{
+		m_State.End();
+		return 0;
+	}
+
+	const bool measuring = upload.modifyCount < kVertexUploadMeasureEnd;
+	upload.current = measuring ? VertexUploadMode(upload.modifyCount % 2) : upload.mode;
+	upload.beginNs = beginNs;
+	void* data = NULL;
+	if (upload.current == kVertexUploadStaging)
+	{
+		// The vertex colors are left as they are (see VertexKernel.h), so they have to be in the
+		// copy too; the rest is rewritten each time
+		if (upload.staging.empty())
+		{
+			const void* contents = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_READ_BIT);
+			if (contents)
+			{
+				upload.staging.assign((const unsigned char*)contents, (const unsigned char*)contents + size);
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+			}
+		}
+		if (!upload.staging.empty())
+			data = &upload.staging[0];
+		else
+			upload.current = kVertexUploadMap;
+	}
+	if (upload.current == kVertexUploadMap)
+	{
+		// Not GL_MAP_INVALIDATE_BUFFER_BIT: the vertex colors have to stay
+		data = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT);
+	}
+	m_State.End();
+	return data;
+#	else
+	return 0;
+#	endif // if SUPPORT_GL_MAP_BUFFER_RANGE
 }
 
 
 void RenderAPI_OpenGLCoreES::EndModifyVertexBuffer(void* bufferHandle)
 {
-#	if !SUPPORT_OPENGL_ES
-	glBindBuffer(GL_ARRAY_BUFFER, (GLuint)(size_t)bufferHandle);
-	glUnmapBuffer(GL_ARRAY_BUFFER);
-#	endif
+#	if SUPPORT_GL_MAP_BUFFER_RANGE
+	VertexUpload& upload = m_VertexUpload;
+	m_State.Begin();
+	m_State.BindArrayBuffer((GLuint)(size_t)bufferHandle);
+	if (upload.current == kVertexUploadStaging)
+		glBufferSubData(GL_ARRAY_BUFFER, 0, upload.size, &upload.staging[0]);
+	else
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	m_State.End();
+	RecordVertexUpload(GetTimeNs() - upload.beginNs);
+#	endif // if SUPPORT_GL_MAP_BUFFER_RANGE
+}
+
+
+#if SUPPORT_GL_MAP_BUFFER_RANGE
+void RenderAPI_OpenGLCoreES::RecordVertexUpload(unsigned long long durationNs)
+{
+	VertexUpload& upload = m_VertexUpload;
+	// The first modification with each mode warms it up (e.g. reads back the staging copy)
+	if (upload.modifyCount >= 2 && upload.modifyCount < kVertexUploadMeasureEnd)
+	{
+		upload.measuredNs[upload.current] += durationNs;
+		++upload.measuredCount[upload.current];
+	}
+	++upload.modifyCount;
+	if (upload.modifyCount == kVertexUploadMeasureEnd)
+	{
+		// Per modification: staging falls back to mapping if the buffer can't be read back
+		const unsigned long long mapNs = upload.measuredNs[kVertexUploadMap] / std::max(upload.measuredCount[kVertexUploadMap], 1);
+		const unsigned long long stagingNs = upload.measuredNs[kVertexUploadStaging] / std::max(upload.measuredCount[kVertexUploadStaging], 1);
+		upload.mode = upload.measuredCount[kVertexUploadStaging] > 0 && stagingNs < mapNs ? kVertexUploadStaging : kVertexUploadMap;
+	}
+	else if (upload.modifyCount == kVertexUploadMeasureEnd + kVertexUploadRemeasureInterval)
+	{
+		// The driver may do better with the other one by now (e.g. the GPU got busier); no warm up needed
+		upload.modifyCount = 2;
+		memset(upload.measuredNs, 0, sizeof(upload.measuredNs));
+		memset(upload.measuredCount, 0, sizeof(upload.measuredCount));
+	}
 }
+#endif // if SUPPORT_GL_MAP_BUFFER_RANGE
 
 #endif // #if SUPPORT_OPENGL_UNIFIED
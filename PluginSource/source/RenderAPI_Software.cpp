@@ -0,0 +1,483 @@
+#include "RenderAPI.h"
+#include "PlatformBase.h"
+
+// Software (CPU only) implementation of RenderAPI, used with the "null" graphics device when the
+// host enables it with SetPluginSoftwareRendering (HeadlessHost). Textures and vertex buffers are host memory
+// described by SoftwareTexture / SoftwareBuffer (see RenderAPI_Software.h), and DrawSimpleTriangles
+// is done by a small tiled rasterizer writing into a CPU framebuffer.
+
+
+#if SUPPORT_SOFTWARE
+
+#include "RenderAPI_Software.h"
+#include "PluginProfiling.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#if SUPPORT_SSE2
+#	include <emmintrin.h>
+#elif SUPPORT_NEON
+#	include <arm_neon.h>
+#endif
+
+
+// Size of the render target used when the host did not provide one through SetRenderTexture
+const int kDefaultTargetSize = 256;
+
+// Triangles are rasterized in square tiles of this many pixels; tiles fully outside the
+// triangle are skipped and tiles fully inside skip the per-pixel coverage test.
+const int kTileSize = 8;
+
+
+// Triangle setup result: three edge functions and the attribute planes, all as
+// value = dx * px + dy * py + c, evaluated at pixel centers.
+struct TriangleSetup
+{
+	float edgeDX[3], edgeDY[3], edgeC[3];
+	bool edgeTopLeft[3]; // pixels exactly on a top or left edge belong to the triangle
+	float attrDX[5], attrDY[5], attrC[5]; // depth, then color r,g,b,a in 0..255
+};
+
+struct ScreenVertex
+{
+	float x, y, z;
+	float color[4];
+};
+
+
+class RenderAPI_Software : public RenderAPI
+{
+public:
+	RenderAPI_Software();
+	virtual ~RenderAPI_Software() { }
+
+	virtual void ProcessDeviceEvent(UnityGfxDeviceEventType type, IUnityInterfaces* interfaces);
+
+	virtual bool GetUsesReverseZ() { return false; }
+
+	virtual void DrawSimpleTriangles(const float worldMatrix[16], int triangleCount, const void* verticesFloat3Byte4);
+
+	virtual void* BeginModifyTexture(void* textureHandle, int textureWidth, int textureHeight, int* outRowPitch);
+	virtual void EndModifyTexture(void* textureHandle, int textureWidth, int textureHeight, int rowPitch, void* dataPtr);
+
+	virtual void* BeginModifyVertexBuffer(void* bufferHandle, size_t* outBufferSize);
+	virtual void EndModifyVertexBuffer(void* bufferHandle);
+
+	virtual void* getRenderTexture() { return GetRenderTarget(); }
+	virtual void setRenderTextureResource(UnityRenderBuffer rb) { m_ExternalTarget = (SoftwareTexture*)rb; }
+
+private:
+	SoftwareTexture* GetRenderTarget();
+	void RasterizeTriangle(SoftwareTexture* target, const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2);
+	void ShadeTileRow(SoftwareTexture* target, const TriangleSetup& setup, int x0, int x1, int y, bool fullyCovered);
+
+private:
+	SoftwareTexture* m_ExternalTarget;
+	SoftwareTexture m_DefaultTarget;
+	std::vector<unsigned char> m_DefaultTargetPixels;
+	std::vector<float> m_Depth;
+	int m_DepthWidth;
+	int m_DepthHeight;
+	int m_DepthPitch; // in floats, multiple of kTileSize so tile rows never read past the end
+};
+
+
+RenderAPI* CreateRenderAPI_Software()
+{
+	return new RenderAPI_Software();
+}
+
+
+RenderAPI_Software::RenderAPI_Software()
+	: m_ExternalTarget(NULL)
+	, m_DepthWidth(0)
+	, m_DepthHeight(0)
+	, m_DepthPitch(0)
+{
+	m_DefaultTarget.width = 0;
+	m_DefaultTarget.height = 0;
+	m_DefaultTarget.rowPitch = 0;
+	m_DefaultTarget.pixels = NULL;
+}
+
+
+void RenderAPI_Software::ProcessDeviceEvent(UnityGfxDeviceEventType type, IUnityInterfaces* interfaces)
+{
+	if (type == kUnityGfxDeviceEventShutdown)
+	{
+		m_ExternalTarget = NULL;
+		m_DefaultTargetPixels.clear();
+		m_DefaultTarget.pixels = NULL;
+		m_Depth.clear();
+		m_DepthWidth = m_DepthHeight = m_DepthPitch = 0;
+	}
+}
+
+
+SoftwareTexture* RenderAPI_Software::GetRenderTarget()
+{
+	SoftwareTexture* target = m_ExternalTarget;
+	if (!target)
+	{
+		if (m_DefaultTargetPixels.empty())
+		{
+			m_DefaultTargetPixels.resize(kDefaultTargetSize * kDefaultTargetSize * 4, 0);
+			m_DefaultTarget.width = kDefaultTargetSize;
+			m_DefaultTarget.height = kDefaultTargetSize;
+			m_DefaultTarget.rowPitch = kDefaultTargetSize * 4;
+			m_DefaultTarget.pixels = &m_DefaultTargetPixels[0];
+		}
+		target = &m_DefaultTarget;
+	}
+
+	// Depth buffer follows the render target size; depth writes are off (like in the other
+	// backends), so it only needs clearing when it gets (re)created.
+	if (target->width != m_DepthWidth || target->height != m_DepthHeight)
+	{
+		m_DepthWidth = target->width;
+		m_DepthHeight = target->height;
+		m_DepthPitch = (target->width + kTileSize - 1) & ~(kTileSize - 1);
+		m_Depth.assign(size_t(m_DepthPitch) * m_DepthHeight, 1.0f);
+	}
+	return target;
+}
+
+
+void RenderAPI_Software::DrawSimpleTriangles(const float worldMatrix[16], int triangleCount, const void* verticesFloat3Byte4)
+{
+	SoftwareTexture* target = GetRenderTarget();
+	if (!target->pixels || target->width <= 0 || target->height <= 0)
+		return;
+
+	struct InputVertex
+	{
+		float x, y, z;
+		unsigned char color[4];
+	};
+	const InputVertex* input = (const InputVertex*)verticesFloat3Byte4;
+	const float* m = worldMatrix;
+
+	for (int tri = 0; tri < triangleCount; ++tri)
+	{
+		ScreenVertex sv[3];
+		bool behindCamera = false;
+		for (int i = 0; i < 3; ++i)
+		{
+			// Column-major world matrix, identity projection with D3D style 0..1 depth (same as
+			// what the other backends end up with).
+			const InputVertex& v = input[tri * 3 + i];
+			const float cx = m[0] * v.x + m[4] * v.y + m[8] * v.z + m[12];
+			const float cy = m[1] * v.x + m[5] * v.y + m[9] * v.z + m[13];
+			const float cz = m[2] * v.x + m[6] * v.y + m[10] * v.z + m[14];
+			const float cw = m[3] * v.x + m[7] * v.y + m[11] * v.z + m[15];
+			// No near plane clipping; triangles crossing w=0 are just dropped.
+			if (!(cw > 1e-6f))
+			{
+				behindCamera = true;
+				break;
+			}
+			const float invW = 1.0f / cw;
+			sv[i].x = (cx * invW * 0.5f + 0.5f) * float(target->width);
+			sv[i].y = (0.5f - cy * invW * 0.5f) * float(target->height);
+			sv[i].z = cz * invW;
+			for (int c = 0; c < 4; ++c)
+				sv[i].color[c] = float(v.color[c]);
+		}
+		if (!behindCamera)
+			RasterizeTriangle(target, sv[0], sv[1], sv[2]);
+	}
+}
+
+
+void RenderAPI_Software::RasterizeTriangle(SoftwareTexture* target, const ScreenVertex& v0, const ScreenVertex& in1, const ScreenVertex& in2)
+{
+	PROFILE_SCOPE("RenderAPI_Software::RasterizeTriangle");
+
+	// No culling; flip clockwise triangles so that all edge functions are positive inside.
+	float area = (in1.x - v0.x) * (in2.y - v0.y) - (in1.y - v0.y) * (in2.x - v0.x);
+	if (!(fabsf(area) > 0.0f) || !(fabsf(area) < 1e30f))
+		return;
+	const bool flip = area < 0.0f;
+	const ScreenVertex& v1 = flip ? in2 : in1;
+	const ScreenVertex& v2 = flip ? in1 : in2;
+	area = fabsf(area);
+
+	// Edge i is opposite of vertex i; E(p) = dx * p.x + dy * p.y + c
+	const ScreenVertex* verts[3] = { &v0, &v1, &v2 };
+	TriangleSetup setup;
+	for (int i = 0; i < 3; ++i)
+	{
+		const ScreenVertex& a = *verts[(i + 1) % 3];
+		const ScreenVertex& b = *verts[(i + 2) % 3];
+		setup.edgeDX[i] = a.y - b.y;
+		setup.edgeDY[i] = b.x - a.x;
+		setup.edgeC[i] = -(setup.edgeDX[i] * a.x + setup.edgeDY[i] * a.y);
+		setup.edgeTopLeft[i] = setup.edgeDX[i] > 0.0f || (setup.edgeDX[i] == 0.0f && setup.edgeDY[i] > 0.0f);
+	}
+
+	// Attribute planes from barycentrics: attr = a0 + (a1-a0) * E1/area + (a2-a0) * E2/area
+	const float invArea = 1.0f / area;
+	for (int i = 0; i < 5; ++i)
+	{
+		const float a0 = i == 0 ? v0.z : v0.color[i - 1];
+		const float d1 = (i == 0 ? v1.z : v1.color[i - 1]) - a0;
+		const float d2 = (i == 0 ? v2.z : v2.color[i - 1]) - a0;
+		setup.attrDX[i] = (d1 * setup.edgeDX[1] + d2 * setup.edgeDX[2]) * invArea;
+		setup.attrDY[i] = (d1 * setup.edgeDY[1] + d2 * setup.edgeDY[2]) * invArea;
+		setup.attrC[i] = a0 + (d1 * setup.edgeC[1] + d2 * setup.edgeC[2]) * invArea;
+	}
+
+	// Screen space bounding box, clipped to the target
+	const float minXf = std::min(v0.x, std::min(v1.x, v2.x));
+	const float maxXf = std::max(v0.x, std::max(v1.x, v2.x));
+	const float minYf = std::min(v0.y, std::min(v1.y, v2.y));
+	const float maxYf = std::max(v0.y, std::max(v1.y, v2.y));
+	if (maxXf < 0.0f || maxYf < 0.0f || minXf >= float(target->width) || minYf >= float(target->height))
+		return;
+	const int minX = std::max(0, int(minXf));
+	const int minY = std::max(0, int(minYf));
+	const int maxX = std::min(target->width - 1, int(maxXf));
+	const int maxY = std::min(target->height - 1, int(maxYf));
+
+	const float kTileSpan = float(kTileSize - 1);
+	for (int ty = minY & ~(kTileSize - 1); ty <= maxY; ty += kTileSize)
+	{
+		for (int tx = minX & ~(kTileSize - 1); tx <= maxX; tx += kTileSize)
+		{
+			// Edge functions are linear, so their extremes over the tile's pixel centers are at the corners
+			bool outside = false;
+			bool fullyCovered = true;
+			for (int i = 0; i < 3 && !outside; ++i)
+			{
+				const float e = setup.edgeDX[i] * (float(tx) + 0.5f) + setup.edgeDY[i] * (float(ty) + 0.5f) + setup.edgeC[i];
+				const float stepX = setup.edgeDX[i] * kTileSpan;
+				const float stepY = setup.edgeDY[i] * kTileSpan;
+				const float eMax = e + std::max(0.0f, stepX) + std::max(0.0f, stepY);
+				const float eMin = e + std::min(0.0f, stepX) + std::min(0.0f, stepY);
+				outside = eMax < 0.0f;
+				fullyCovered = fullyCovered && eMin > 0.0f;
+			}
+			if (outside)
+				continue;
+
+			const int y0 = std::max(ty, minY);
+			const int y1 = std::min(ty + kTileSize - 1, maxY);
+			for (int y = y0; y <= y1; ++y)
+				ShadeTileRow(target, setup, tx, std::min(tx + kTileSize, target->width), y, fullyCovered);
+		}
+	}
+}
+
+
+#if SUPPORT_SSE2
+
+static inline __m128 EvalPlane4(float dx, float dy, float c, __m128 px, float py)
+{
+	return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dx), px), _mm_set1_ps(dy * py + c));
+}
+
+void RenderAPI_Software::ShadeTileRow(SoftwareTexture* target, const TriangleSetup& setup, int x0, int x1, int y, bool fullyCovered)
+{
+	const float py = float(y) + 0.5f;
+	unsigned int* colorRow = (unsigned int*)(target->pixels + size_t(y) * target->rowPitch);
+	float* depthRow = &m_Depth[size_t(y) * m_DepthPitch];
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 maxColor = _mm_set1_ps(255.0f);
+
+	for (int x = x0; x < x1; x += 4)
+	{
+		const __m128 px = _mm_add_ps(_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f), _mm_set1_ps(float(x) + 0.5f));
+
+		// Coverage: E > 0, or E == 0 on a top-left edge
+		__m128 mask = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		if (!fullyCovered)
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				const __m128 e = EvalPlane4(setup.edgeDX[i], setup.edgeDY[i], setup.edgeC[i], px, py);
+				const __m128 onEdgeAllowed = setup.edgeTopLeft[i] ? _mm_castsi128_ps(_mm_set1_epi32(-1)) : _mm_cmpneq_ps(e, zero);
+				mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(e, zero), onEdgeAllowed));
+			}
+		}
+
+		// Depth clip & LEQUAL depth test, no depth writes
+		const __m128 z = EvalPlane4(setup.attrDX[0], setup.attrDY[0], setup.attrC[0], px, py);
+		const __m128 depth = _mm_loadu_ps(depthRow + x);
+		mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmple_ps(z, depth), _mm_and_ps(_mm_cmpge_ps(z, zero), _mm_cmple_ps(z, one))));
+		const int laneMask = _mm_movemask_ps(mask);
+		if (laneMask == 0)
+			continue;
+
+		// Interpolate color and pack into RGBA8
+		__m128i packed = _mm_setzero_si128();
+		for (int c = 0; c < 4; ++c)
+		{
+			__m128 v = EvalPlane4(setup.attrDX[c + 1], setup.attrDY[c + 1], setup.attrC[c + 1], px, py);
+			v = _mm_min_ps(_mm_max_ps(_mm_add_ps(v, half), zero), maxColor);
+			packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvttps_epi32(v), c * 8));
+		}
+
+		if (x + 4 <= x1)
+		{
+			const __m128i lanes = _mm_castps_si128(mask);
+			const __m128i old = _mm_loadu_si128((const __m128i*)(colorRow + x));
+			const __m128i result = _mm_or_si128(_mm_and_si128(lanes, packed), _mm_andnot_si128(lanes, old));
+			_mm_storeu_si128((__m128i*)(colorRow + x), result);
+		}
+		else
+		{
+			// Last few pixels of a row whose width is not a multiple of 4
+			unsigned int values[4];
+			_mm_storeu_si128((__m128i*)values, packed);
+			for (int i = 0; x + i < x1; ++i)
+			{
+				if (laneMask & (1 << i))
+					colorRow[x + i] = values[i];
+			}
+		}
+	}
+}
+
+#elif SUPPORT_NEON
+
+static inline float32x4_t EvalPlane4(float dx, float dy, float c, float32x4_t px, float py)
+{
+	return vmlaq_n_f32(vdupq_n_f32(dy * py + c), px, dx);
+}
+
+void RenderAPI_Software::ShadeTileRow(SoftwareTexture* target, const TriangleSetup& setup, int x0, int x1, int y, bool fullyCovered)
+{
+	const float py = float(y) + 0.5f;
+	unsigned int* colorRow = (unsigned int*)(target->pixels + size_t(y) * target->rowPitch);
+	float* depthRow = &m_Depth[size_t(y) * m_DepthPitch];
+	const float32x4_t zero = vdupq_n_f32(0.0f);
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	const float32x4_t half = vdupq_n_f32(0.5f);
+	const float32x4_t maxColor = vdupq_n_f32(255.0f);
+	const float laneOffsets[4] = { 0.5f, 1.5f, 2.5f, 3.5f };
+	const float32x4_t offsets = vld1q_f32(laneOffsets);
+
+	for (int x = x0; x < x1; x += 4)
+	{
+		const float32x4_t px = vaddq_f32(offsets, vdupq_n_f32(float(x)));
+
+		// Coverage: E > 0, or E == 0 on a top-left edge
+		uint32x4_t mask = vdupq_n_u32(0xFFFFFFFFu);
+		if (!fullyCovered)
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				const float32x4_t e = EvalPlane4(setup.edgeDX[i], setup.edgeDY[i], setup.edgeC[i], px, py);
+				mask = vandq_u32(mask, setup.edgeTopLeft[i] ? vcgeq_f32(e, zero) : vcgtq_f32(e, zero));
+			}
+		}
+
+		// Depth clip & LEQUAL depth test, no depth writes
+		const float32x4_t z = EvalPlane4(setup.attrDX[0], setup.attrDY[0], setup.attrC[0], px, py);
+		const float32x4_t depth = vld1q_f32(depthRow + x);
+		mask = vandq_u32(mask, vandq_u32(vcleq_f32(z, depth), vandq_u32(vcgeq_f32(z, zero), vcleq_f32(z, one))));
+
+		// Interpolate color and pack into RGBA8
+		uint32x4_t packed = vdupq_n_u32(0);
+		for (int c = 0; c < 4; ++c)
+		{
+			float32x4_t v = EvalPlane4(setup.attrDX[c + 1], setup.attrDY[c + 1], setup.attrC[c + 1], px, py);
+			v = vminq_f32(vmaxq_f32(vaddq_f32(v, half), zero), maxColor);
+			uint32x4_t channel = vcvtq_u32_f32(v);
+			switch (c)
+			{
+			case 0: break;
+			case 1: channel = vshlq_n_u32(channel, 8); break;
+			case 2: channel = vshlq_n_u32(channel, 16); break;
+			default: channel = vshlq_n_u32(channel, 24); break;
+			}
+			packed = vorrq_u32(packed, channel);
+		}
+
+		if (x + 4 <= x1)
+		{
+			const uint32x4_t old = vld1q_u32(colorRow + x);
+			vst1q_u32(colorRow + x, vbslq_u32(mask, packed, old));
+		}
+		else
+		{
+			// Last few pixels of a row whose width is not a multiple of 4
+			unsigned int values[4], lanes[4];
+			vst1q_u32(values, packed);
+			vst1q_u32(lanes, mask);
+			for (int i = 0; x + i < x1; ++i)
+			{
+				if (lanes[i])
+					colorRow[x + i] = values[i];
+			}
+		}
+	}
+}
+
+#else // no SIMD
+
+void RenderAPI_Software::ShadeTileRow(SoftwareTexture* target, const TriangleSetup& setup, int x0, int x1, int y, bool fullyCovered)
+{
+	const float py = float(y) + 0.5f;
+	unsigned int* colorRow = (unsigned int*)(target->pixels + size_t(y) * target->rowPitch);
+	const float* depthRow = &m_Depth[size_t(y) * m_DepthPitch];
+
+	for (int x = x0; x < x1; ++x)
+	{
+		const float px = float(x) + 0.5f;
+		bool inside = true;
+		for (int i = 0; i < 3 && inside && !fullyCovered; ++i)
+		{
+			const float e = setup.edgeDX[i] * px + setup.edgeDY[i] * py + setup.edgeC[i];
+			inside = e > 0.0f || (e == 0.0f && setup.edgeTopLeft[i]);
+		}
+		const float z = setup.attrDX[0] * px + setup.attrDY[0] * py + setup.attrC[0];
+		if (!inside || !(z <= depthRow[x]) || z < 0.0f || z > 1.0f)
+			continue;
+
+		unsigned int packed = 0;
+		for (int c = 0; c < 4; ++c)
+		{
+			const float v = setup.attrDX[c + 1] * px + setup.attrDY[c + 1] * py + setup.attrC[c + 1] + 0.5f;
+			packed |= (unsigned int)(std::min(std::max(v, 0.0f), 255.0f)) << (c * 8);
+		}
+		colorRow[x] = packed;
+	}
+}
+
+#endif // SUPPORT_SSE2 / SUPPORT_NEON
+
+
+void* RenderAPI_Software::BeginModifyTexture(void* textureHandle, int textureWidth, int textureHeight, int* outRowPitch)
+{
+	// Textures are host memory already, hand it out directly
+	SoftwareTexture* texture = (SoftwareTexture*)textureHandle;
+	if (!texture->pixels || texture->width != textureWidth || texture->height != textureHeight)
+		return NULL;
+	*outRowPitch = texture->rowPitch;
+	return texture->pixels;
+}
+
+
+void RenderAPI_Software::EndModifyTexture(void* textureHandle, int textureWidth, int textureHeight, int rowPitch, void* dataPtr)
+{
+}
+
+
+void* RenderAPI_Software::BeginModifyVertexBuffer(void* bufferHandle, size_t* outBufferSize)
+{
+	SoftwareBuffer* buffer = (SoftwareBuffer*)bufferHandle;
+	*outBufferSize = buffer->sizeInBytes;
+	return buffer->data;
+}
+
+
+void RenderAPI_Software::EndModifyVertexBuffer(void* bufferHandle)
+{
+}
+
+#endif // #if SUPPORT_SOFTWARE
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+
+// Native resource "handles" understood by the software (CPU only) RenderAPI implementation.
+//
+// With the "null" graphics device there are no GPU resources, so a host that enables software rendering
+// (SetPluginSoftwareRendering, before UnityPluginLoad) passes pointers to these structs wherever Unity
+// would pass native texture / buffer / render buffer pointers (SetTextureFromUnity, SetMeshBuffersFromUnity,
+// SetRenderTexture). The memory is owned by the host; the plugin reads and writes it directly.
+
+// RGBA8 image; used for textures and render targets.
+struct SoftwareTexture
+{
+	int width;
+	int height;
+	int rowPitch; // in bytes
+	unsigned char* pixels;
+};
+
+// Raw vertex buffer memory.
+struct SoftwareBuffer
+{
+	void* data;
+	size_t sizeInBytes;
+};
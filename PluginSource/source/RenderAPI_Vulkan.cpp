@@ -1,10 +1,15 @@
 #include "RenderAPI.h"
 #include "PlatformBase.h"
+#include "PluginProfiling.h"
+#include "VertexKernel.h"
 
 #if SUPPORT_VULKAN
 
+#include <stdio.h>
 #include <string.h>
-#include <map>
+#include <mutex>
+#include <set>
+#include <string>
 #include <vector>
 #include <math.h>
 
@@ -17,6 +22,7 @@
     apply(vkCmdBeginRenderPass); \
     apply(vkCreateBuffer); \
     apply(vkGetPhysicalDeviceMemoryProperties); \
+    apply(vkGetPhysicalDeviceProperties); \
     apply(vkGetBufferMemoryRequirements); \
     apply(vkMapMemory); \
     apply(vkBindBufferMemory); \
@@ -27,6 +33,8 @@
     apply(vkQueueWaitIdle); \
     apply(vkDeviceWaitIdle); \
     apply(vkCmdCopyBufferToImage); \
+    apply(vkCmdCopyBuffer); \
+    apply(vkCmdPipelineBarrier); \
     apply(vkFlushMappedMemoryRanges); \
     apply(vkCreatePipelineLayout); \
     apply(vkCreateShaderModule); \
@@ -37,7 +45,36 @@
     apply(vkCmdPushConstants); \
     apply(vkCmdBindVertexBuffers); \
     apply(vkDestroyPipeline); \
-    apply(vkDestroyPipelineLayout);
+    apply(vkDestroyPipelineLayout); \
+    apply(vkCreatePipelineCache); \
+    apply(vkDestroyPipelineCache); \
+    apply(vkGetPipelineCacheData); \
+    apply(vkMergePipelineCaches); \
+    apply(vkCreateDevice); \
+    apply(vkGetPhysicalDeviceQueueFamilyProperties); \
+    apply(vkGetPhysicalDeviceFeatures2); \
+    apply(vkGetDeviceQueue); \
+    apply(vkQueueSubmit); \
+    apply(vkCreateCommandPool); \
+    apply(vkDestroyCommandPool); \
+    apply(vkAllocateCommandBuffers); \
+    apply(vkBeginCommandBuffer); \
+    apply(vkEndCommandBuffer); \
+    apply(vkCreateSemaphore); \
+    apply(vkDestroySemaphore); \
+    apply(vkGetSemaphoreCounterValue); \
+    apply(vkCreateImageView); \
+    apply(vkDestroyImageView); \
+    apply(vkCreateDescriptorSetLayout); \
+    apply(vkDestroyDescriptorSetLayout); \
+    apply(vkCreateDescriptorPool); \
+    apply(vkDestroyDescriptorPool); \
+    apply(vkAllocateDescriptorSets); \
+    apply(vkFreeDescriptorSets); \
+    apply(vkUpdateDescriptorSets); \
+    apply(vkCreateComputePipelines); \
+    apply(vkCmdBindDescriptorSets); \
+    apply(vkCmdDispatch);
     
 #define VULKAN_DEFINE_API_FUNCPTR(func) static PFN_##func func
 VULKAN_DEFINE_API_FUNCPTR(vkGetInstanceProcAddr);
@@ -83,8 +120,20 @@ static VKAPI_ATTR void VKAPI_CALL Hook_vkCmdBeginRenderPass(VkCommandBuffer comm
     }
 }
 
+// Vulkan version the instance was created for; 1.2 is needed for the transfer queue (timeline semaphores)
+static uint32_t s_InstanceApiVersion = VK_API_VERSION_1_0;
+
+// Set with SetPluginVulkanTransferQueue before the device is created; off by default, so Unity's device is
+// created exactly as Unity asks
+static bool s_TransferQueueEnabled = false;
+
+// Device Hook_vkCreateDevice added a transfer-only queue to, and the queue's family
+static VkDevice s_TransferQueueDevice = VK_NULL_HANDLE;
+static uint32_t s_TransferQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+
 static VKAPI_ATTR VkResult VKAPI_CALL Hook_vkCreateInstance(const VkInstanceCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkInstance* pInstance)
 {
+    s_InstanceApiVersion = pCreateInfo->pApplicationInfo && pCreateInfo->pApplicationInfo->apiVersion ? pCreateInfo->pApplicationInfo->apiVersion : VK_API_VERSION_1_0;
     vkCreateInstance = (PFN_vkCreateInstance)vkGetInstanceProcAddr(VK_NULL_HANDLE, "vkCreateInstance");
     VkResult result = vkCreateInstance(pCreateInfo, pAllocator, pInstance);
     if (result == VK_SUCCESS)
@@ -93,6 +142,108 @@ static VKAPI_ATTR VkResult VKAPI_CALL Hook_vkCreateInstance(const VkInstanceCrea
     return result;
 }
 
+// Queue family that can only do transfers (typically the DMA engines of discrete GPUs)
+static uint32_t FindTransferOnlyQueueFamily(VkPhysicalDevice physicalDevice)
+{
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, NULL);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    if (familyCount > 0)
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, &families[0]);
+
+    for (uint32_t i = 0; i < familyCount; ++i)
+    {
+        const VkQueueFlags flags = families[i].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && families[i].queueCount > 0)
+            return i;
+    }
+    return VK_QUEUE_FAMILY_IGNORED;
+}
+
+// Only installed when s_TransferQueueEnabled. Creates the device with one more queue, of a transfer-only
+// family, for RenderAPI_Vulkan's async uploads. Needs Vulkan 1.2 for timeline semaphores, which are
+// enabled here unless Unity's own feature structs say whether they are. Creates the device as asked
+// otherwise, or if that fails.
+static VKAPI_ATTR VkResult VKAPI_CALL Hook_vkCreateDevice(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDevice* pDevice)
+{
+    s_TransferQueueDevice = VK_NULL_HANDLE;
+    s_TransferQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    const uint32_t transferFamily = FindTransferOnlyQueueFamily(physicalDevice);
+    bool useTransferQueue = transferFamily != VK_QUEUE_FAMILY_IGNORED && vkGetPhysicalDeviceFeatures2
+        && s_InstanceApiVersion >= VK_API_VERSION_1_2 && properties.apiVersion >= VK_API_VERSION_1_2;
+
+    // Unity using the family itself: leave it alone
+    for (uint32_t i = 0; i < pCreateInfo->queueCreateInfoCount; ++i)
+    {
+        if (pCreateInfo->pQueueCreateInfos[i].queueFamilyIndex == transferFamily)
+            useTransferQueue = false;
+    }
+
+    bool addTimelineFeatures = true;
+    for (const VkBaseInStructure* next = (const VkBaseInStructure*)pCreateInfo->pNext; next; next = next->pNext)
+    {
+        if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES)
+        {
+            useTransferQueue = useTransferQueue && ((const VkPhysicalDeviceVulkan12Features*)next)->timelineSemaphore;
+            addTimelineFeatures = false;
+        }
+        else if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES)
+        {
+            useTransferQueue = useTransferQueue && ((const VkPhysicalDeviceTimelineSemaphoreFeatures*)next)->timelineSemaphore;
+            addTimelineFeatures = false;
+        }
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures;
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineFeatures.pNext = NULL;
+    timelineFeatures.timelineSemaphore = VK_FALSE;
+    if (useTransferQueue && addTimelineFeatures)
+    {
+        VkPhysicalDeviceFeatures2 features;
+        memset(&features, 0, sizeof(features));
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &timelineFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+        useTransferQueue = timelineFeatures.timelineSemaphore == VK_TRUE;
+    }
+
+    if (useTransferQueue)
+    {
+        const float priority = 0.5f;
+        std::vector<VkDeviceQueueCreateInfo> queueCreateInfos(pCreateInfo->pQueueCreateInfos, pCreateInfo->pQueueCreateInfos + pCreateInfo->queueCreateInfoCount);
+        VkDeviceQueueCreateInfo transferQueueCreateInfo;
+        transferQueueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        transferQueueCreateInfo.pNext = NULL;
+        transferQueueCreateInfo.flags = 0;
+        transferQueueCreateInfo.queueFamilyIndex = transferFamily;
+        transferQueueCreateInfo.queueCount = 1;
+        transferQueueCreateInfo.pQueuePriorities = &priority;
+        queueCreateInfos.push_back(transferQueueCreateInfo);
+
+        VkDeviceCreateInfo createInfo = *pCreateInfo;
+        createInfo.queueCreateInfoCount = (uint32_t)queueCreateInfos.size();
+        createInfo.pQueueCreateInfos = &queueCreateInfos[0];
+        if (addTimelineFeatures)
+        {
+            timelineFeatures.pNext = const_cast<void*>(pCreateInfo->pNext);
+            createInfo.pNext = &timelineFeatures;
+        }
+
+        if (vkCreateDevice(physicalDevice, &createInfo, pAllocator, pDevice) == VK_SUCCESS)
+        {
+            s_TransferQueueDevice = *pDevice;
+            s_TransferQueueFamily = transferFamily;
+            return VK_SUCCESS;
+        }
+    }
+
+    return vkCreateDevice(physicalDevice, pCreateInfo, pAllocator, pDevice);
+}
+
 static int FindMemoryTypeIndex(VkPhysicalDeviceMemoryProperties const & physicalDeviceMemoryProperties, VkMemoryRequirements const & memoryRequirements, VkMemoryPropertyFlags memoryPropertyFlags)
 {
     uint32_t memoryTypeBits = memoryRequirements.memoryTypeBits;
@@ -119,6 +270,8 @@ static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL Hook_vkGetInstanceProcAddr(VkIns
 
 #define INTERCEPT(fn) if (strcmp(funcName, #fn) == 0) return (PFN_vkVoidFunction)&Hook_##fn
     INTERCEPT(vkCreateInstance);
+    if (s_TransferQueueEnabled)
+        INTERCEPT(vkCreateDevice);
 #undef INTERCEPT
 
     return vkGetInstanceProcAddr(device, funcName);
@@ -130,6 +283,11 @@ static PFN_vkGetInstanceProcAddr UNITY_INTERFACE_API InterceptVulkanInitializati
     return Hook_vkGetInstanceProcAddr;
 }
 
+extern "C" void RenderAPI_Vulkan_SetTransferQueueEnabled(bool enabled)
+{
+    s_TransferQueueEnabled = enabled;
+}
+
 extern "C" void RenderAPI_Vulkan_OnPluginLoad(IUnityInterfaces* interfaces)
 {
     if (IUnityGraphicsVulkanV2* vulkanInterface = interfaces->Get<IUnityGraphicsVulkanV2>())
@@ -138,16 +296,424 @@ extern "C" void RenderAPI_Vulkan_OnPluginLoad(IUnityInterfaces* interfaces)
         vulkanInterface->InterceptInitialization(InterceptVulkanInitialization, NULL);
 }
 
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Range of device memory handed out by VulkanMemoryAllocator (same fields as UnityVulkanMemory)
+struct VulkanMemory
+{
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size; // as asked for; the range may be bigger
+    void* mapped; // CPU address of offset, NULL if not host visible
+    VkMemoryPropertyFlags flags;
+    unsigned int memoryTypeIndex;
+    int block; // index of the allocator block the range is in, -1 if the memory was allocated just for it
+    int order; // the range is a block node of size "minimum node size << order"
+};
+
+static const VkDeviceSize kVulkanMinNodeSize = 256;
+static const VkDeviceSize kVulkanMinBlockSize = 16 * 1024 * 1024;
+static const VkDeviceSize kVulkanMaxBlockSize = 64 * 1024 * 1024;
+
+// Sub-allocates memory for the plugin's resources out of a few big VkDeviceMemory blocks, instead of
+// a vkAllocateMemory per resource: drivers limit how many allocations there can be, and each one is
+// slow. Blocks are 16 to 64 MB (smaller ones for small heaps), and host visible ones stay mapped.
+//
+// Each block is a buddy allocator: ranges are power of two sized nodes, aligned to their size, so
+// any alignment up to the node size comes for free. Node sizes start at 256 bytes, which also
+// covers nonCoherentAtomSize, so flushing a whole range never touches a neighbour. Linear resources
+// (buffers) and non-linear ones (optimally tiled images) never share a block, which keeps them
+// bufferImageGranularity apart. Requests of half a block or more get memory of their own.
+class VulkanMemoryAllocator
+{
+public:
+    VulkanMemoryAllocator();
+    ~VulkanMemoryAllocator() { Shutdown(); }
+
+    void Init(VkDevice device, VkPhysicalDevice physicalDevice);
+    // Frees all blocks; everything allocated must have been freed already.
+    void Shutdown();
+
+    bool Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags requiredFlags, bool linear, VulkanMemory* outMemory);
+    void Free(const VulkanMemory& memory);
+
+    void GetStats(PluginMemoryStats* stats) const;
+
+private:
+    enum { kMaxOrders = 32 };
+
+    struct Block
+    {
+        VkDeviceMemory memory;
+        void* mapped;
+        unsigned int memoryTypeIndex;
+        bool linear;
+        int orderCount; // the whole block is a node of order orderCount - 1
+        std::set<VkDeviceSize> freeNodes[kMaxOrders]; // offsets of free nodes, per order (node size m_MinNodeSize << order)
+        int allocationCount;
+        VkDeviceSize usedBytes;
+    };
+
+    VkDeviceSize GetBlockSize(unsigned int memoryTypeIndex) const;
+    bool AllocateDeviceMemory(unsigned int memoryTypeIndex, VkDeviceSize size, VkDeviceMemory* outMemory, void** outMapped);
+    int CreateBlock(unsigned int memoryTypeIndex, bool linear);
+    bool AllocateFromBlock(int blockIndex, int order, VkDeviceSize* outOffset);
+
+    VkDevice m_Device;
+    VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+    VkDeviceSize m_MinNodeSize; // kVulkanMinNodeSize, or nonCoherentAtomSize if that is bigger
+    std::vector<Block*> m_Blocks; // NULL where a block was freed
+    unsigned long long m_DedicatedCount;
+    unsigned long long m_DedicatedBytes;
+    unsigned long long m_RequestedBytes;
+    mutable std::mutex m_Mutex; // stats are read from the main thread (GetPluginMemoryStats)
+};
+
+VulkanMemoryAllocator::VulkanMemoryAllocator()
+    : m_Device(VK_NULL_HANDLE)
+    , m_MinNodeSize(kVulkanMinNodeSize)
+    , m_DedicatedCount(0)
+    , m_DedicatedBytes(0)
+    , m_RequestedBytes(0)
+{
+    memset(&m_MemoryProperties, 0, sizeof(m_MemoryProperties));
+}
+
+void VulkanMemoryAllocator::Init(VkDevice device, VkPhysicalDevice physicalDevice)
+{
+    m_Device = device;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_MemoryProperties);
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    m_MinNodeSize = kVulkanMinNodeSize;
+    while (m_MinNodeSize < properties.limits.nonCoherentAtomSize)
+        m_MinNodeSize *= 2;
+}
+
+void VulkanMemoryAllocator::Shutdown()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (size_t i = 0; i < m_Blocks.size(); ++i)
+    {
+        if (m_Blocks[i])
+        {
+            vkFreeMemory(m_Device, m_Blocks[i]->memory, NULL);
+            delete m_Blocks[i];
+        }
+    }
+    m_Blocks.clear();
+    m_DedicatedCount = 0;
+    m_DedicatedBytes = 0;
+    m_RequestedBytes = 0;
+}
+
+VkDeviceSize VulkanMemoryAllocator::GetBlockSize(unsigned int memoryTypeIndex) const
+{
+    // At most an eighth of the heap, so that small heaps (e.g. 256 MB of host visible VRAM) are not hogged
+    const VkDeviceSize heapSize = m_MemoryProperties.memoryHeaps[m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+    VkDeviceSize blockSize = kVulkanMaxBlockSize;
+    while (blockSize > kVulkanMinBlockSize && blockSize > heapSize / 8)
+        blockSize /= 2;
+    return blockSize;
+}
+
+bool VulkanMemoryAllocator::AllocateDeviceMemory(unsigned int memoryTypeIndex, VkDeviceSize size, VkDeviceMemory* outMemory, void** outMapped)
+{
+    PROFILE_SCOPE("VulkanMemoryAllocator::AllocateDeviceMemory");
+    VkMemoryAllocateInfo memoryAllocateInfo;
+    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocateInfo.pNext = NULL;
+    memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+    memoryAllocateInfo.allocationSize = size;
+    if (vkAllocateMemory(m_Device, &memoryAllocateInfo, NULL, outMemory) != VK_SUCCESS)
+        return false;
+
+    *outMapped = NULL;
+    if ((m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        && vkMapMemory(m_Device, *outMemory, 0, VK_WHOLE_SIZE, 0, outMapped) != VK_SUCCESS)
+    {
+        vkFreeMemory(m_Device, *outMemory, NULL);
+        return false;
+    }
+    return true;
+}
+
+int VulkanMemoryAllocator::CreateBlock(unsigned int memoryTypeIndex, bool linear)
+{
+    const VkDeviceSize blockSize = GetBlockSize(memoryTypeIndex);
+    Block* block = new Block();
+    if (!AllocateDeviceMemory(memoryTypeIndex, blockSize, &block->memory, &block->mapped))
+    {
+        delete block;
+        return -1;
+    }
+    block->memoryTypeIndex = memoryTypeIndex;
+    block->linear = linear;
+    block->orderCount = 1;
+    while ((m_MinNodeSize << (block->orderCount - 1)) < blockSize)
+        ++block->orderCount;
+    block->freeNodes[block->orderCount - 1].insert(0);
+    block->allocationCount = 0;
+    block->usedBytes = 0;
+
+    for (size_t i = 0; i < m_Blocks.size(); ++i)
+    {
+        if (!m_Blocks[i])
+        {
+            m_Blocks[i] = block;
+            return int(i);
+        }
+    }
+    m_Blocks.push_back(block);
+    return int(m_Blocks.size() - 1);
+}
+
+bool VulkanMemoryAllocator::AllocateFromBlock(int blockIndex, int order, VkDeviceSize* outOffset)
+{
+    Block& block = *m_Blocks[blockIndex];
+    int freeOrder = order;
+    while (freeOrder < block.orderCount && block.freeNodes[freeOrder].empty())
+        ++freeOrder;
+    if (freeOrder >= block.orderCount)
+        return false;
+
+    const VkDeviceSize offset = *block.freeNodes[freeOrder].begin();
+    block.freeNodes[freeOrder].erase(block.freeNodes[freeOrder].begin());
+    // Split the node down to the size needed; the upper halves stay free
+    while (freeOrder > order)
+    {
+        --freeOrder;
+        block.freeNodes[freeOrder].insert(offset + (m_MinNodeSize << freeOrder));
+    }
+    block.allocationCount++;
+    block.usedBytes += m_MinNodeSize << order;
+    *outOffset = offset;
+    return true;
+}
+
+bool VulkanMemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags requiredFlags, bool linear, VulkanMemory* outMemory)
+{
+    const int memoryTypeIndex = FindMemoryTypeIndex(m_MemoryProperties, requirements, requiredFlags);
+    if (memoryTypeIndex < 0 || requirements.size == 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    memset(outMemory, 0, sizeof(*outMemory));
+    outMemory->size = requirements.size;
+    outMemory->memoryTypeIndex = memoryTypeIndex;
+    outMemory->flags = m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+
+    const VkDeviceSize nodeSizeNeeded = requirements.size > requirements.alignment ? requirements.size : requirements.alignment;
+    int order = 0;
+    while ((m_MinNodeSize << order) < nodeSizeNeeded)
+        ++order;
+
+    if ((m_MinNodeSize << order) * 2 > GetBlockSize(memoryTypeIndex))
+    {
+        const VkDeviceSize size = AlignUp(requirements.size, m_MinNodeSize);
+        if (!AllocateDeviceMemory(memoryTypeIndex, size, &outMemory->memory, &outMemory->mapped))
+            return false;
+        outMemory->block = -1;
+        m_DedicatedCount++;
+        m_DedicatedBytes += size;
+        m_RequestedBytes += requirements.size;
+        return true;
+    }
+
+    int blockIndex = -1;
+    VkDeviceSize offset = 0;
+    for (size_t i = 0; i < m_Blocks.size() && blockIndex < 0; ++i)
+    {
+        const Block* block = m_Blocks[i];
+        if (block && block->memoryTypeIndex == unsigned(memoryTypeIndex) && block->linear == linear && AllocateFromBlock(int(i), order, &offset))
+            blockIndex = int(i);
+    }
+    if (blockIndex < 0)
+    {
+        blockIndex = CreateBlock(memoryTypeIndex, linear);
+        if (blockIndex < 0 || !AllocateFromBlock(blockIndex, order, &offset))
+            return false;
+    }
+
+    const Block& block = *m_Blocks[blockIndex];
+    outMemory->memory = block.memory;
+    outMemory->offset = offset;
+    outMemory->order = order;
+    outMemory->mapped = block.mapped ? (char*)block.mapped + offset : NULL;
+    outMemory->block = blockIndex;
+    m_RequestedBytes += requirements.size;
+    return true;
+}
+
+void VulkanMemoryAllocator::Free(const VulkanMemory& memory)
+{
+    if (memory.memory == VK_NULL_HANDLE)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (memory.block < 0)
+    {
+        if (memory.mapped)
+            vkUnmapMemory(m_Device, memory.memory);
+        vkFreeMemory(m_Device, memory.memory, NULL);
+        m_DedicatedCount--;
+        m_DedicatedBytes -= AlignUp(memory.size, m_MinNodeSize);
+        m_RequestedBytes -= memory.size;
+        return;
+    }
+
+    Block& block = *m_Blocks[memory.block];
+    int order = memory.order;
+    block.allocationCount--;
+    block.usedBytes -= m_MinNodeSize << order;
+    m_RequestedBytes -= memory.size;
+
+    // Merge with the buddy node for as long as it is free too
+    VkDeviceSize offset = memory.offset;
+    while (order < block.orderCount - 1)
+    {
+        const VkDeviceSize buddy = offset ^ (m_MinNodeSize << order);
+        if (block.freeNodes[order].erase(buddy) == 0)
+            break;
+        offset = offset < buddy ? offset : buddy;
+        ++order;
+    }
+    block.freeNodes[order].insert(offset);
+
+    // Give empty blocks back, except for the last one of their kind, which new allocations would need again
+    if (block.allocationCount == 0)
+    {
+        for (size_t i = 0; i < m_Blocks.size(); ++i)
+        {
+            const Block* other = m_Blocks[i];
+            if (other && other != &block && other->memoryTypeIndex == block.memoryTypeIndex && other->linear == block.linear)
+            {
+                vkFreeMemory(m_Device, block.memory, NULL);
+                delete m_Blocks[memory.block];
+                m_Blocks[memory.block] = NULL;
+                break;
+            }
+        }
+    }
+}
+
+void VulkanMemoryAllocator::GetStats(PluginMemoryStats* stats) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    memset(stats, 0, sizeof(*stats));
+    for (size_t i = 0; i < m_Blocks.size(); ++i)
+    {
+        const Block* block = m_Blocks[i];
+        if (!block)
+            continue;
+        stats->blockCount++;
+        stats->blockBytes += m_MinNodeSize << (block->orderCount - 1);
+        stats->allocationCount += block->allocationCount;
+        stats->usedBytes += block->usedBytes;
+        for (int order = 0; order < block->orderCount; ++order)
+        {
+            const size_t count = block->freeNodes[order].size();
+            stats->freeRangeCount += count;
+            if (count > 0 && (m_MinNodeSize << order) > stats->largestFreeRange)
+                stats->largestFreeRange = m_MinNodeSize << order;
+        }
+    }
+    stats->dedicatedCount = m_DedicatedCount;
+    stats->dedicatedBytes = m_DedicatedBytes;
+    stats->requestedBytes = m_RequestedBytes;
+}
+
 struct VulkanBuffer
 {
     VkBuffer buffer;
-    VkDeviceMemory deviceMemory;
-    void* mapped;
+    VulkanMemory memory;
     VkDeviceSize sizeInBytes;
-    VkDeviceSize deviceMemorySize;
-    VkMemoryPropertyFlags deviceMemoryFlags;
 };
 
+// Hands out ranges of a buffer that is reused round and round: ranges allocated while recording
+// frame N become free again once Unity reports that frame N is done on the GPU (safeFrameNumber).
+// Allocation is a bump of the head; frames are retired from the tail. Only does the bookkeeping,
+// the buffer itself is owned by the caller.
+class FrameRingAllocator
+{
+public:
+    FrameRingAllocator() { Reset(0); }
+
+    // Forgets all allocations; size must be a multiple of every alignment later passed to Allocate.
+    void Reset(VkDeviceSize size);
+    VkDeviceSize GetSize() const { return m_Size; }
+
+    // Returns false if there is no room before the GPU is done with more frames.
+    bool Allocate(VkDeviceSize size, VkDeviceSize alignment, unsigned long long frameNumber, unsigned long long safeFrameNumber, VkDeviceSize* outOffset);
+
+private:
+    enum { kMaxFrames = 16 };
+
+    struct FrameEnd
+    {
+        unsigned long long frameNumber;
+        unsigned long long end; // head position after the last allocation of the frame
+    };
+
+    // Positions only ever grow; the offset in the buffer is position % m_Size
+    VkDeviceSize m_Size;
+    unsigned long long m_Head;
+    unsigned long long m_Tail;
+    FrameEnd m_Frames[kMaxFrames]; // frames not retired yet, oldest first
+    int m_FirstFrame;
+    int m_FrameCount;
+};
+
+void FrameRingAllocator::Reset(VkDeviceSize size)
+{
+    m_Size = size;
+    m_Head = 0;
+    m_Tail = 0;
+    m_FirstFrame = 0;
+    m_FrameCount = 0;
+}
+
+bool FrameRingAllocator::Allocate(VkDeviceSize size, VkDeviceSize alignment, unsigned long long frameNumber, unsigned long long safeFrameNumber, VkDeviceSize* outOffset)
+{
+    while (m_FrameCount > 0 && m_Frames[m_FirstFrame].frameNumber <= safeFrameNumber)
+    {
+        m_Tail = m_Frames[m_FirstFrame].end;
+        m_FirstFrame = (m_FirstFrame + 1) % kMaxFrames;
+        --m_FrameCount;
+    }
+
+    if (size == 0 || size > m_Size)
+        return false;
+
+    // Ranges never wrap around the end of the buffer; skip to the start if it does not fit
+    const VkDeviceSize headOffset = m_Head % m_Size;
+    VkDeviceSize offset = AlignUp(headOffset, alignment);
+    if (offset + size > m_Size)
+        offset = m_Size;
+    const unsigned long long start = m_Head - headOffset + offset;
+    const unsigned long long end = start + size;
+    if (end - m_Tail > m_Size)
+        return false;
+
+    FrameEnd* last = m_FrameCount > 0 ? &m_Frames[(m_FirstFrame + m_FrameCount - 1) % kMaxFrames] : NULL;
+    if (!last || last->frameNumber != frameNumber)
+    {
+        if (m_FrameCount == kMaxFrames)
+            return false;
+        last = &m_Frames[(m_FirstFrame + m_FrameCount) % kMaxFrames];
+        last->frameNumber = frameNumber;
+        ++m_FrameCount;
+    }
+    last->end = end;
+    m_Head = end;
+
+    *outOffset = start % m_Size;
+    return true;
+}
+
 static VkPipelineLayout CreateTrianglePipelineLayout(VkDevice device)
 {
     VkPushConstantRange pushConstantRange;
@@ -291,9 +857,337 @@ const uint32_t fragmentShaderSpirv[] = {
     0x00000007,0x0000000c,0x0000000b,0x0003003e,
     0x00000009,0x0000000c,0x000100fd,0x00010038
 };
+
+// Source of the plasma compute shader (filename: plasma.comp); same effect as PlasmaPixel in PlasmaKernel.cpp
+/*
+#version 310 es
+layout(local_size_x = 8, local_size_y = 8) in;
+layout(binding = 0, rgba8) writeonly uniform highp image2D plasma;
+layout(push_constant) uniform PushConstants { ivec2 size; float t; };
+void main() {
+    int x = int(gl_GlobalInvocationID.x);
+    int y = int(gl_GlobalInvocationID.y);
+    if (x < size.x && y < size.y) {
+        float v =
+            (127.0 + (127.0 * sin(float(x) / 7.0 + t))) +
+            (127.0 + (127.0 * sin(float(y) / 5.0 - t))) +
+            (127.0 + (127.0 * sin(float(x + y) / 6.0 - t))) +
+            (127.0 + (127.0 * sin(sqrt(float(x*x + y*y)) / 4.0 - t)));
+        float c = float(int(v) / 4) / 255.0;
+        imageStore(plasma, ivec2(x, y), vec4(c));
+    }
+}
+*/
+// SPIR-V 1.0, assembled by hand from the source above (no debug names). The SPIRV-Tools validator (what
+// spirv-val runs) accepts it with Vulkan rules; on SwiftShader it is off by at most 1 from PlasmaPixel and
+// writes nothing outside size. To replace it with compiler output, and check that:
+// %VULKAN_SDK%\bin\glslc -mfmt=num plasma.comp -c
+// %VULKAN_SDK%\bin\glslc plasma.comp -o plasma.spv && %VULKAN_SDK%\bin\spirv-val --target-env vulkan1.0 plasma.spv
+
+const uint32_t plasmaComputeShaderSpirv[] = {
+	0x07230203,0x00010000,0x00000000,0x00000057,
+	0x00000000,0x00020011,0x00000001,0x0006000b,
+	0x00000001,0x4c534c47,0x6474732e,0x3035342e,
+	0x00000000,0x0003000e,0x00000000,0x00000001,
+	0x0006000f,0x00000005,0x00000002,0x6e69616d,
+	0x00000000,0x00000003,0x00060010,0x00000002,
+	0x00000011,0x00000008,0x00000008,0x00000001,
+	0x00040047,0x00000003,0x0000000b,0x0000001c,
+	0x00050048,0x00000010,0x00000000,0x00000023,
+	0x00000000,0x00050048,0x00000010,0x00000001,
+	0x00000023,0x00000008,0x00030047,0x00000010,
+	0x00000002,0x00040047,0x00000005,0x00000022,
+	0x00000000,0x00040047,0x00000005,0x00000021,
+	0x00000000,0x00030047,0x00000005,0x00000019,
+	0x00020013,0x00000006,0x00030021,0x00000007,
+	0x00000006,0x00020014,0x00000008,0x00040015,
+	0x00000009,0x00000020,0x00000001,0x00040015,
+	0x0000000a,0x00000020,0x00000000,0x00030016,
+	0x0000000b,0x00000020,0x00040017,0x0000000c,
+	0x00000009,0x00000002,0x00040017,0x0000000d,
+	0x0000000a,0x00000003,0x00040017,0x0000000e,
+	0x0000000b,0x00000004,0x00090019,0x0000000f,
+	0x0000000b,0x00000001,0x00000000,0x00000000,
+	0x00000000,0x00000002,0x00000004,0x0004001e,
+	0x00000010,0x0000000c,0x0000000b,0x00040020,
+	0x00000011,0x00000001,0x0000000d,0x00040020,
+	0x00000012,0x00000009,0x00000010,0x00040020,
+	0x00000013,0x00000009,0x0000000c,0x00040020,
+	0x00000014,0x00000009,0x0000000b,0x00040020,
+	0x00000015,0x00000000,0x0000000f,0x0004002b,
+	0x00000009,0x00000016,0x00000000,0x0004002b,
+	0x00000009,0x00000017,0x00000001,0x0004002b,
+	0x00000009,0x00000018,0x00000004,0x0004002b,
+	0x0000000b,0x00000019,0x42fe0000,0x0004002b,
+	0x0000000b,0x0000001a,0x40e00000,0x0004002b,
+	0x0000000b,0x0000001b,0x40a00000,0x0004002b,
+	0x0000000b,0x0000001c,0x40c00000,0x0004002b,
+	0x0000000b,0x0000001d,0x40800000,0x0004002b,
+	0x0000000b,0x0000001e,0x437f0000,0x0004003b,
+	0x00000011,0x00000003,0x00000001,0x0004003b,
+	0x00000012,0x00000004,0x00000009,0x0004003b,
+	0x00000015,0x00000005,0x00000000,0x00050036,
+	0x00000006,0x00000002,0x00000000,0x00000007,
+	0x000200f8,0x0000001f,0x0004003d,0x0000000d,
+	0x00000020,0x00000003,0x00050051,0x0000000a,
+	0x00000021,0x00000020,0x00000000,0x0004007c,
+	0x00000009,0x00000022,0x00000021,0x00050051,
+	0x0000000a,0x00000023,0x00000020,0x00000001,
+	0x0004007c,0x00000009,0x00000024,0x00000023,
+	0x00050041,0x00000013,0x00000025,0x00000004,
+	0x00000016,0x0004003d,0x0000000c,0x00000026,
+	0x00000025,0x00050051,0x00000009,0x00000027,
+	0x00000026,0x00000000,0x000500b1,0x00000008,
+	0x00000028,0x00000022,0x00000027,0x00050051,
+	0x00000009,0x00000029,0x00000026,0x00000001,
+	0x000500b1,0x00000008,0x0000002a,0x00000024,
+	0x00000029,0x000500a7,0x00000008,0x0000002b,
+	0x00000028,0x0000002a,0x000300f7,0x0000002d,
+	0x00000000,0x000400fa,0x0000002b,0x0000002c,
+	0x0000002d,0x000200f8,0x0000002c,0x00050041,
+	0x00000014,0x0000002e,0x00000004,0x00000017,
+	0x0004003d,0x0000000b,0x0000002f,0x0000002e,
+	0x0004006f,0x0000000b,0x00000030,0x00000022,
+	0x0004006f,0x0000000b,0x00000031,0x00000024,
+	0x00050088,0x0000000b,0x00000032,0x00000030,
+	0x0000001a,0x00050081,0x0000000b,0x00000033,
+	0x00000032,0x0000002f,0x0006000c,0x0000000b,
+	0x00000034,0x00000001,0x0000000d,0x00000033,
+	0x00050085,0x0000000b,0x00000035,0x00000019,
+	0x00000034,0x00050081,0x0000000b,0x00000036,
+	0x00000019,0x00000035,0x00050088,0x0000000b,
+	0x00000037,0x00000031,0x0000001b,0x00050083,
+	0x0000000b,0x00000038,0x00000037,0x0000002f,
+	0x0006000c,0x0000000b,0x00000039,0x00000001,
+	0x0000000d,0x00000038,0x00050085,0x0000000b,
+	0x0000003a,0x00000019,0x00000039,0x00050081,
+	0x0000000b,0x0000003b,0x00000019,0x0000003a,
+	0x00050080,0x00000009,0x0000003c,0x00000022,
+	0x00000024,0x0004006f,0x0000000b,0x0000003d,
+	0x0000003c,0x00050088,0x0000000b,0x0000003e,
+	0x0000003d,0x0000001c,0x00050083,0x0000000b,
+	0x0000003f,0x0000003e,0x0000002f,0x0006000c,
+	0x0000000b,0x00000040,0x00000001,0x0000000d,
+	0x0000003f,0x00050085,0x0000000b,0x00000041,
+	0x00000019,0x00000040,0x00050081,0x0000000b,
+	0x00000042,0x00000019,0x00000041,0x00050084,
+	0x00000009,0x00000043,0x00000022,0x00000022,
+	0x00050084,0x00000009,0x00000044,0x00000024,
+	0x00000024,0x00050080,0x00000009,0x00000045,
+	0x00000043,0x00000044,0x0004006f,0x0000000b,
+	0x00000046,0x00000045,0x0006000c,0x0000000b,
+	0x00000047,0x00000001,0x0000001f,0x00000046,
+	0x00050088,0x0000000b,0x00000048,0x00000047,
+	0x0000001d,0x00050083,0x0000000b,0x00000049,
+	0x00000048,0x0000002f,0x0006000c,0x0000000b,
+	0x0000004a,0x00000001,0x0000000d,0x00000049,
+	0x00050085,0x0000000b,0x0000004b,0x00000019,
+	0x0000004a,0x00050081,0x0000000b,0x0000004c,
+	0x00000019,0x0000004b,0x00050081,0x0000000b,
+	0x0000004d,0x00000036,0x0000003b,0x00050081,
+	0x0000000b,0x0000004e,0x0000004d,0x00000042,
+	0x00050081,0x0000000b,0x0000004f,0x0000004e,
+	0x0000004c,0x0004006e,0x00000009,0x00000050,
+	0x0000004f,0x00050087,0x00000009,0x00000051,
+	0x00000050,0x00000018,0x0004006f,0x0000000b,
+	0x00000052,0x00000051,0x00050088,0x0000000b,
+	0x00000053,0x00000052,0x0000001e,0x00070050,
+	0x0000000e,0x00000054,0x00000053,0x00000053,
+	0x00000053,0x00000053,0x0004003d,0x0000000f,
+	0x00000055,0x00000005,0x00050050,0x0000000c,
+	0x00000056,0x00000022,0x00000024,0x00040063,
+	0x00000055,0x00000056,0x00000054,0x000200f9,
+	0x0000002d,0x000200f8,0x0000002d,0x000100fd,
+	0x00010038
+};
+
+// Source of the vertex wave compute shader (filename: wave.comp); same wave as WaveScalarRange in VertexKernel.cpp.
+// The source mesh has 8 floats per vertex (position, normal, UV), the vertex buffer is an array of MeshVertex.
+/*
+#version 310 es
+layout(local_size_x = 64) in;
+layout(std430, binding = 0) readonly buffer Source { float src[]; };
+layout(std430, binding = 1) writeonly buffer Vertices { float dst[]; };
+layout(push_constant) uniform PushConstants { uint vertexCount; float t; };
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i < vertexCount) {
+        uint s = i * 8u;
+        uint d = i * 12u;
+        float x = src[s];
+        float y = src[s + 1u];
+        float z = src[s + 2u];
+        dst[d] = x;
+        dst[d + 1u] = y + sin(x * 1.1 + t) * 0.4 + sin(z * 0.9 - t) * 0.3;
+        dst[d + 2u] = z;
+        dst[d + 3u] = src[s + 3u];
+        dst[d + 4u] = src[s + 4u];
+        dst[d + 5u] = src[s + 5u];
+        // dst[d + 6u] to dst[d + 9u], the color, is left as it is
+        dst[d + 10u] = src[s + 6u];
+        dst[d + 11u] = src[s + 7u];
+    }
+}
+*/
+// SPIR-V 1.0, assembled by hand from the source above (no debug names). The SPIRV-Tools validator (what
+// spirv-val runs) accepts it with Vulkan rules; on SwiftShader positions are within 2e-4 of WaveScalarRange
+// (the precision Vulkan asks of sin), normals and UVs are exact, and colors and vertices past vertexCount
+// are left alone. To replace it with compiler output, and check that:
+// %VULKAN_SDK%\bin\glslc -mfmt=num wave.comp -c
+// %VULKAN_SDK%\bin\glslc wave.comp -o wave.spv && %VULKAN_SDK%\bin\spirv-val --target-env vulkan1.0 wave.spv
+
+const uint32_t vertexWaveComputeShaderSpirv[] = {
+	0x07230203,0x00010000,0x00000000,0x00000068,
+	0x00000000,0x00020011,0x00000001,0x0006000b,
+	0x00000001,0x4c534c47,0x6474732e,0x3035342e,
+	0x00000000,0x0003000e,0x00000000,0x00000001,
+	0x0006000f,0x00000005,0x00000002,0x6e69616d,
+	0x00000000,0x00000003,0x00060010,0x00000002,
+	0x00000011,0x00000040,0x00000001,0x00000001,
+	0x00040047,0x00000003,0x0000000b,0x0000001c,
+	0x00040047,0x0000000e,0x00000006,0x00000004,
+	0x00040047,0x0000000f,0x00000006,0x00000004,
+	0x00040048,0x00000010,0x00000000,0x00000018,
+	0x00050048,0x00000010,0x00000000,0x00000023,
+	0x00000000,0x00030047,0x00000010,0x00000003,
+	0x00040048,0x00000011,0x00000000,0x00000019,
+	0x00050048,0x00000011,0x00000000,0x00000023,
+	0x00000000,0x00030047,0x00000011,0x00000003,
+	0x00040047,0x00000005,0x00000022,0x00000000,
+	0x00040047,0x00000005,0x00000021,0x00000000,
+	0x00040047,0x00000006,0x00000022,0x00000000,
+	0x00040047,0x00000006,0x00000021,0x00000001,
+	0x00050048,0x00000012,0x00000000,0x00000023,
+	0x00000000,0x00050048,0x00000012,0x00000001,
+	0x00000023,0x00000004,0x00030047,0x00000012,
+	0x00000002,0x00020013,0x00000007,0x00030021,
+	0x00000008,0x00000007,0x00020014,0x00000009,
+	0x00040015,0x0000000a,0x00000020,0x00000000,
+	0x00040015,0x0000000b,0x00000020,0x00000001,
+	0x00030016,0x0000000c,0x00000020,0x00040017,
+	0x0000000d,0x0000000a,0x00000003,0x0003001d,
+	0x0000000e,0x0000000c,0x0003001d,0x0000000f,
+	0x0000000c,0x0003001e,0x00000010,0x0000000e,
+	0x0003001e,0x00000011,0x0000000f,0x0004001e,
+	0x00000012,0x0000000a,0x0000000c,0x00040020,
+	0x00000013,0x00000001,0x0000000d,0x00040020,
+	0x00000014,0x00000009,0x00000012,0x00040020,
+	0x00000015,0x00000009,0x0000000a,0x00040020,
+	0x00000016,0x00000009,0x0000000c,0x00040020,
+	0x00000017,0x00000002,0x00000010,0x00040020,
+	0x00000018,0x00000002,0x00000011,0x00040020,
+	0x00000019,0x00000002,0x0000000c,0x0004002b,
+	0x0000000b,0x0000001a,0x00000000,0x0004002b,
+	0x0000000b,0x0000001b,0x00000001,0x0004002b,
+	0x0000000a,0x0000001c,0x00000000,0x0004002b,
+	0x0000000a,0x0000001d,0x00000001,0x0004002b,
+	0x0000000a,0x0000001e,0x00000002,0x0004002b,
+	0x0000000a,0x0000001f,0x00000003,0x0004002b,
+	0x0000000a,0x00000020,0x00000004,0x0004002b,
+	0x0000000a,0x00000021,0x00000005,0x0004002b,
+	0x0000000a,0x00000022,0x00000006,0x0004002b,
+	0x0000000a,0x00000023,0x00000007,0x0004002b,
+	0x0000000a,0x00000024,0x00000008,0x0004002b,
+	0x0000000a,0x00000025,0x0000000a,0x0004002b,
+	0x0000000a,0x00000026,0x0000000b,0x0004002b,
+	0x0000000a,0x00000027,0x0000000c,0x0004002b,
+	0x0000000c,0x00000028,0x3f8ccccd,0x0004002b,
+	0x0000000c,0x00000029,0x3f666666,0x0004002b,
+	0x0000000c,0x0000002a,0x3ecccccd,0x0004002b,
+	0x0000000c,0x0000002b,0x3e99999a,0x0004003b,
+	0x00000013,0x00000003,0x00000001,0x0004003b,
+	0x00000014,0x00000004,0x00000009,0x0004003b,
+	0x00000017,0x00000005,0x00000002,0x0004003b,
+	0x00000018,0x00000006,0x00000002,0x00050036,
+	0x00000007,0x00000002,0x00000000,0x00000008,
+	0x000200f8,0x0000002c,0x0004003d,0x0000000d,
+	0x0000002d,0x00000003,0x00050051,0x0000000a,
+	0x0000002e,0x0000002d,0x00000000,0x00050041,
+	0x00000015,0x0000002f,0x00000004,0x0000001a,
+	0x0004003d,0x0000000a,0x00000030,0x0000002f,
+	0x000500b0,0x00000009,0x00000031,0x0000002e,
+	0x00000030,0x000300f7,0x00000033,0x00000000,
+	0x000400fa,0x00000031,0x00000032,0x00000033,
+	0x000200f8,0x00000032,0x00050041,0x00000016,
+	0x00000034,0x00000004,0x0000001b,0x0004003d,
+	0x0000000c,0x00000035,0x00000034,0x00050084,
+	0x0000000a,0x00000036,0x0000002e,0x00000024,
+	0x00050084,0x0000000a,0x00000037,0x0000002e,
+	0x00000027,0x00060041,0x00000019,0x00000038,
+	0x00000005,0x0000001a,0x00000036,0x0004003d,
+	0x0000000c,0x00000039,0x00000038,0x00050080,
+	0x0000000a,0x0000003a,0x00000036,0x0000001d,
+	0x00060041,0x00000019,0x0000003b,0x00000005,
+	0x0000001a,0x0000003a,0x0004003d,0x0000000c,
+	0x0000003c,0x0000003b,0x00050080,0x0000000a,
+	0x0000003d,0x00000036,0x0000001e,0x00060041,
+	0x00000019,0x0000003e,0x00000005,0x0000001a,
+	0x0000003d,0x0004003d,0x0000000c,0x0000003f,
+	0x0000003e,0x00050085,0x0000000c,0x00000040,
+	0x00000039,0x00000028,0x00050081,0x0000000c,
+	0x00000041,0x00000040,0x00000035,0x0006000c,
+	0x0000000c,0x00000042,0x00000001,0x0000000d,
+	0x00000041,0x00050085,0x0000000c,0x00000043,
+	0x0000003f,0x00000029,0x00050083,0x0000000c,
+	0x00000044,0x00000043,0x00000035,0x0006000c,
+	0x0000000c,0x00000045,0x00000001,0x0000000d,
+	0x00000044,0x00050085,0x0000000c,0x00000046,
+	0x00000042,0x0000002a,0x00050081,0x0000000c,
+	0x00000047,0x0000003c,0x00000046,0x00050085,
+	0x0000000c,0x00000048,0x00000045,0x0000002b,
+	0x00050081,0x0000000c,0x00000049,0x00000047,
+	0x00000048,0x00060041,0x00000019,0x0000004a,
+	0x00000006,0x0000001a,0x00000037,0x0003003e,
+	0x0000004a,0x00000039,0x00050080,0x0000000a,
+	0x0000004b,0x00000037,0x0000001d,0x00060041,
+	0x00000019,0x0000004c,0x00000006,0x0000001a,
+	0x0000004b,0x0003003e,0x0000004c,0x00000049,
+	0x00050080,0x0000000a,0x0000004d,0x00000037,
+	0x0000001e,0x00060041,0x00000019,0x0000004e,
+	0x00000006,0x0000001a,0x0000004d,0x0003003e,
+	0x0000004e,0x0000003f,0x00050080,0x0000000a,
+	0x0000004f,0x00000036,0x0000001f,0x00060041,
+	0x00000019,0x00000050,0x00000005,0x0000001a,
+	0x0000004f,0x0004003d,0x0000000c,0x00000051,
+	0x00000050,0x00050080,0x0000000a,0x00000052,
+	0x00000037,0x0000001f,0x00060041,0x00000019,
+	0x00000053,0x00000006,0x0000001a,0x00000052,
+	0x0003003e,0x00000053,0x00000051,0x00050080,
+	0x0000000a,0x00000054,0x00000036,0x00000020,
+	0x00060041,0x00000019,0x00000055,0x00000005,
+	0x0000001a,0x00000054,0x0004003d,0x0000000c,
+	0x00000056,0x00000055,0x00050080,0x0000000a,
+	0x00000057,0x00000037,0x00000020,0x00060041,
+	0x00000019,0x00000058,0x00000006,0x0000001a,
+	0x00000057,0x0003003e,0x00000058,0x00000056,
+	0x00050080,0x0000000a,0x00000059,0x00000036,
+	0x00000021,0x00060041,0x00000019,0x0000005a,
+	0x00000005,0x0000001a,0x00000059,0x0004003d,
+	0x0000000c,0x0000005b,0x0000005a,0x00050080,
+	0x0000000a,0x0000005c,0x00000037,0x00000021,
+	0x00060041,0x00000019,0x0000005d,0x00000006,
+	0x0000001a,0x0000005c,0x0003003e,0x0000005d,
+	0x0000005b,0x00050080,0x0000000a,0x0000005e,
+	0x00000036,0x00000022,0x00060041,0x00000019,
+	0x0000005f,0x00000005,0x0000001a,0x0000005e,
+	0x0004003d,0x0000000c,0x00000060,0x0000005f,
+	0x00050080,0x0000000a,0x00000061,0x00000037,
+	0x00000025,0x00060041,0x00000019,0x00000062,
+	0x00000006,0x0000001a,0x00000061,0x0003003e,
+	0x00000062,0x00000060,0x00050080,0x0000000a,
+	0x00000063,0x00000036,0x00000023,0x00060041,
+	0x00000019,0x00000064,0x00000005,0x0000001a,
+	0x00000063,0x0004003d,0x0000000c,0x00000065,
+	0x00000064,0x00050080,0x0000000a,0x00000066,
+	0x00000037,0x00000026,0x00060041,0x00000019,
+	0x00000067,0x00000006,0x0000001a,0x00000066,
+	0x0003003e,0x00000067,0x00000065,0x000200f9,
+	0x00000033,0x000200f8,0x00000033,0x000100fd,
+	0x00010038
+};
 } // namespace Shader
 
-static VkPipeline CreateTrianglePipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkRenderPass renderPass, VkPipelineCache pipelineCache)
+static VkPipeline CreateTrianglePipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkRenderPass renderPass, uint32_t subpass, VkPipelineCache pipelineCache)
 {
     if (pipelineLayout == VK_NULL_HANDLE)
         return VK_NULL_HANDLE;  
@@ -337,6 +1231,7 @@ static VkPipeline CreateTrianglePipeline(VkDevice device, VkPipelineLayout pipel
         pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
         pipelineCreateInfo.layout = pipelineLayout;
         pipelineCreateInfo.renderPass = renderPass;
+        pipelineCreateInfo.subpass = subpass;
 
         VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = {};
         inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -435,6 +1330,184 @@ static VkPipeline CreateTrianglePipeline(VkDevice device, VkPipelineLayout pipel
     return success ? pipeline : VK_NULL_HANDLE;
 }
 
+static VkPipeline CreateComputePipeline(VkDevice device, VkPipelineLayout pipelineLayout, const uint32_t* spirv, size_t spirvSize, VkPipelineCache pipelineCache)
+{
+    if (pipelineLayout == VK_NULL_HANDLE)
+        return VK_NULL_HANDLE;
+
+    VkShaderModuleCreateInfo moduleCreateInfo = {};
+    moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleCreateInfo.codeSize = spirvSize;
+    moduleCreateInfo.pCode = spirv;
+    VkShaderModule module;
+    if (vkCreateShaderModule(device, &moduleCreateInfo, NULL, &module) != VK_SUCCESS)
+        return VK_NULL_HANDLE;
+
+    VkComputePipelineCreateInfo pipelineCreateInfo = {};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineCreateInfo.stage.module = module;
+    pipelineCreateInfo.stage.pName = "main";
+    pipelineCreateInfo.layout = pipelineLayout;
+
+    VkPipeline pipeline;
+    const bool success = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, NULL, &pipeline) == VK_SUCCESS;
+    vkDestroyShaderModule(device, module, NULL);
+    return success ? pipeline : VK_NULL_HANDLE;
+}
+
+// Layout of a compute shader with one descriptor set and pushConstantSize bytes of push constants
+static VkPipelineLayout CreateComputePipelineLayout(VkDevice device, VkDescriptorSetLayout setLayout, uint32_t pushConstantSize)
+{
+    if (setLayout == VK_NULL_HANDLE)
+        return VK_NULL_HANDLE;
+
+    VkPushConstantRange pushConstantRange;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = pushConstantSize;
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &setLayout;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+
+    VkPipelineLayout pipelineLayout;
+    return vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, NULL, &pipelineLayout) == VK_SUCCESS ? pipelineLayout : VK_NULL_HANDLE;
+}
+
+// Descriptor set of bindingCount descriptors of one type, at bindings 0, 1, ...
+static VkDescriptorSetLayout CreateComputeSetLayout(VkDevice device, VkDescriptorType type, uint32_t bindingCount)
+{
+    VkDescriptorSetLayoutBinding bindings[4] = {};
+    if (bindingCount > sizeof(bindings) / sizeof(*bindings))
+        return VK_NULL_HANDLE;
+    for (uint32_t i = 0; i < bindingCount; ++i)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = type;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    createInfo.bindingCount = bindingCount;
+    createInfo.pBindings = bindings;
+
+    VkDescriptorSetLayout setLayout;
+    return vkCreateDescriptorSetLayout(device, &createInfo, NULL, &setLayout) == VK_SUCCESS ? setLayout : VK_NULL_HANDLE;
+}
+
+// File the pipeline cache is kept in: this header, then the data from vkGetPipelineCacheData.
+// The data is only given back to the driver if the same device and driver version wrote it.
+struct PipelineCacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint32_t dataSize;
+    uint32_t dataHash;
+};
+
+static const uint32_t kPipelineCacheFileMagic = 0x43505052; // "RPPC"
+static const uint32_t kPipelineCacheFileVersion = 1;
+static const char* const kPipelineCacheFileName = "RenderingPluginVulkanPipelines.bin";
+
+static uint32_t HashBytes(const void* data, size_t size)
+{
+    // FNV-1a
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+static void InitPipelineCacheFileHeader(const VkPhysicalDeviceProperties& properties, PipelineCacheFileHeader* header)
+{
+    memset(header, 0, sizeof(*header));
+    header->magic = kPipelineCacheFileMagic;
+    header->version = kPipelineCacheFileVersion;
+    header->vendorID = properties.vendorID;
+    header->deviceID = properties.deviceID;
+    header->driverVersion = properties.driverVersion;
+    memcpy(header->pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+// Reads the cache file written by SavePipelineCache; returns false (and leaves data empty) if there is
+// none, or it does not come from this device and driver. Some drivers do not cope well with data
+// from elsewhere, so the header Vulkan puts at the start of the data is checked as well.
+static bool ReadPipelineCacheFile(const std::string& path, const VkPhysicalDeviceProperties& properties, std::vector<unsigned char>* data)
+{
+    data->clear();
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    PipelineCacheFileHeader expected, header;
+    InitPipelineCacheFileHeader(properties, &expected);
+    bool ok = fread(&header, sizeof(header), 1, file) == 1;
+    ok = ok && header.magic == expected.magic && header.version == expected.version
+        && header.vendorID == expected.vendorID && header.deviceID == expected.deviceID
+        && header.driverVersion == expected.driverVersion
+        && memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+    // Vulkan's own header: size, version, vendor ID, device ID, UUID
+    const size_t kVulkanHeaderSize = 16 + VK_UUID_SIZE;
+    ok = ok && header.dataSize >= kVulkanHeaderSize;
+    if (ok)
+    {
+        data->resize(header.dataSize);
+        ok = fread(&(*data)[0], header.dataSize, 1, file) == 1 && fgetc(file) == EOF;
+    }
+    fclose(file);
+
+    if (ok)
+    {
+        uint32_t vulkanHeader[4];
+        memcpy(vulkanHeader, &(*data)[0], sizeof(vulkanHeader));
+        ok = HashBytes(&(*data)[0], data->size()) == header.dataHash
+            && vulkanHeader[0] >= kVulkanHeaderSize && vulkanHeader[0] <= data->size()
+            && vulkanHeader[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+            && vulkanHeader[2] == properties.vendorID && vulkanHeader[3] == properties.deviceID
+            && memcmp(&(*data)[16], properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+    if (!ok)
+        data->clear();
+    return ok;
+}
+
+// Writes to a temporary file first, so that a crash halfway through never leaves a truncated cache.
+static bool WritePipelineCacheFile(const std::string& path, const VkPhysicalDeviceProperties& properties, const std::vector<unsigned char>& data)
+{
+    PipelineCacheFileHeader header;
+    InitPipelineCacheFileHeader(properties, &header);
+    header.dataSize = static_cast<uint32_t>(data.size());
+    header.dataHash = HashBytes(data.empty() ? NULL : &data[0], data.size());
+
+    const std::string tempPath = path + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && (data.empty() || fwrite(&data[0], data.size(), 1, file) == 1);
+    ok = (fclose(file) == 0) && ok;
+
+    if (ok)
+    {
+        remove(path.c_str()); // rename does not replace existing files everywhere
+        ok = rename(tempPath.c_str(), path.c_str()) == 0;
+    }
+    if (!ok)
+        remove(tempPath.c_str());
+    return ok;
+}
+
 class RenderAPI_Vulkan : public RenderAPI
 {
 public:
@@ -446,28 +1519,202 @@ public:
     virtual void DrawSimpleTriangles(const float worldMatrix[16], int triangleCount, const void* verticesFloat3Byte4);
     virtual void* BeginModifyTexture(void* textureHandle, int textureWidth, int textureHeight, int* outRowPitch);
     virtual void EndModifyTexture(void* textureHandle, int textureWidth, int textureHeight, int rowPitch, void* dataPtr);
+    virtual bool GenerateTexture(void* textureHandle, int textureWidth, int textureHeight, float t);
     virtual void* BeginModifyVertexBuffer(void* bufferHandle, size_t* outBufferSize);
     virtual void EndModifyVertexBuffer(void* bufferHandle);
+    virtual bool DeformVertexBuffer(void* bufferHandle, int vertexCount, const MeshSource& source, unsigned int sourceVersion, float t);
+    virtual void FlushUploads();
+    virtual void SetCacheDirectory(const char* directory);
+    virtual bool SaveCaches();
+    virtual bool GetMemoryStats(PluginMemoryStats* stats);
 
 private:
     typedef std::vector<VulkanBuffer> VulkanBuffers;
-    typedef std::map<unsigned long long, VulkanBuffers> DeleteQueue;
 
-private:
-    bool CreateVulkanBuffer(size_t bytes, VulkanBuffer* buffer, VkBufferUsageFlags usage);
-    void ImmediateDestroyVulkanBuffer(const VulkanBuffer& buffer);
-    void SafeDestroy(unsigned long long frameNumber, const VulkanBuffer& buffer);
-    void GarbageCollect(bool force = false);
+    // Resources the GPU may still use, to destroy once it is done with frameNumber. The delete queue
+    // has one of these per frame in flight, indexed by frame number modulo kDeleteQueueFrames; the
+    // vectors are cleared, not freed, so after the first few frames retiring does not allocate.
+    struct RetiredResources
+    {
+        unsigned long long frameNumber;
+        VulkanBuffers buffers;
+        std::vector<VkPipeline> pipelines;
+        std::vector<VkImageView> imageViews;
+        std::vector<VkDescriptorSet> descriptorSets; // from m_ComputeDescriptorPool
+    };
+    // Unity keeps up to three frames in flight. If there ever are more, a slot still holding an
+    // unfinished frame is handed on to the newer frame, which only delays the deletes.
+    enum { kDeleteQueueFrames = 4 };
+
+    // Triangle pipeline for one render pass. The render pass handle also stands for its attachment
+    // formats and sample counts: Unity hands out the same (or a compatible) render pass for them.
+    struct TrianglePipeline
+    {
+        VkRenderPass renderPass;
+        int subPassIndex;
+        VkPipeline pipeline; // VK_NULL_HANDLE if creating it failed; not tried again
+        unsigned long long lastUsedFrame;
+    };
+    enum { kMaxTrianglePipelines = 8 };
+
+    // Upload buffer; pooled, and handed out again once the GPU is done with the frame it was last
+    // used in. Buffers are a power-of-two size class big, see GetStagingSizeClass.
+    struct StagingBuffer
+    {
+        VulkanBuffer buffer;
+        int sizeClass;
+        unsigned long long lastUsedFrame; // kStagingOnTransferQueue while a transfer queue copy uses it
+    };
+    enum { kStagingSizeClasses = 16 };
+
+    struct StagingPool
+    {
+        VkBufferUsageFlags usage;
+        VkMemoryPropertyFlags memoryFlags;
+        bool shareWithTransferQueue; // concurrent sharing, so that either queue can read it without ownership transfers
+        std::vector<StagingBuffer> inUse; // handed out in frames the GPU may not be done with yet
+        std::vector<StagingBuffer> free[kStagingSizeClasses];
+    };
+
+    // Whole texture or vertex buffer contents in a staging buffer, to be copied by FlushUploads
+    struct PendingUpload
+    {
+        void* handle; // Unity texture or buffer
+        bool isTexture;
+        VkBuffer stagingBuffer;
+        int width, height; // textures only
+        VkDeviceSize sizeInBytes;
+        bool fromTransferQueue; // stagingBuffer is a transfer queue destination, still owned by that queue family
+    };
+
+    // Upload being copied to device local memory on the transfer queue; done when m_TransferTimeline
+    // reaches timelineValue. Then it becomes a pending upload from the device local buffer.
+    struct AsyncUpload
+    {
+        PendingUpload upload;
+        VkBuffer hostBuffer;
+        VkBuffer deviceBuffer;
+        uint64_t timelineValue;
+        bool superseded; // the resource got newer contents since; only the buffers are recycled
+    };
+    enum { kTransferCommandBuffers = 8 };
+
+    // Compute shader work queued for FlushUploads: the plasma effect at time t written into a texture,
+    // or the vertex wave into a vertex buffer
+    struct PendingDispatch
+    {
+        void* handle; // Unity texture or vertex buffer
+        bool isTexture;
+        int width, height; // textures only
+        int vertexCount; // vertex buffers only
+        float t;
+    };
+
+    // View and descriptor set for writing an image from a compute shader. Unity can destroy an image
+    // and get the same handle for a new one, so the memory it is bound to has to match as well.
+    struct StorageImageBinding
+    {
+        VkImage image;
+        VkDeviceMemory memory;
+        VkDeviceSize memoryOffset;
+        VkImageView view;
+        VkDescriptorSet descriptorSet;
+        unsigned long long lastUsedFrame;
+    };
+    enum { kMaxStorageImageBindings = 4 };
+
+    // Descriptor set of the vertex wave shader: m_VertexSourceBuffer, and the vertex buffer it writes
+    // (identified like images in StorageImageBinding)
+    struct VertexWaveBinding
+    {
+        VkBuffer vertices;
+        VkDeviceMemory memory;
+        VkDeviceSize memoryOffset;
+        VkDescriptorSet descriptorSet;
+    };
+
+private:
+    bool CreateVulkanBuffer(size_t bytes, VulkanBuffer* buffer, VkBufferUsageFlags usage,
+        VkMemoryPropertyFlags memoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, bool shareWithTransferQueue = false);
+    void ImmediateDestroyVulkanBuffer(const VulkanBuffer& buffer);
+    void FlushVulkanBuffer(const VulkanBuffer& buffer, VkDeviceSize offset, VkDeviceSize size);
+    void SafeDestroy(unsigned long long frameNumber, const VulkanBuffer& buffer);
+    void SafeDestroy(unsigned long long frameNumber, VkPipeline pipeline);
+    RetiredResources& GetRetiredResources(unsigned long long frameNumber);
+    void DestroyRetiredResources(RetiredResources& resources);
+    void GarbageCollect(bool force = false);
+    void* AcquireStagingBuffer(size_t sizeInBytes, const UnityVulkanRecordingState& recordingState);
+    const StagingBuffer* FindStagingBuffer(const void* mapped) const;
+    StagingBuffer* AcquirePooledBuffer(StagingPool& pool, size_t sizeInBytes, const UnityVulkanRecordingState& recordingState);
+    StagingBuffer* FindPooledBuffer(StagingPool& pool, VkBuffer buffer);
+    void RecyclePooledBuffers(StagingPool& pool, unsigned long long safeFrameNumber, unsigned long long currentFrameNumber);
+    void DestroyPooledBuffers(StagingPool& pool);
+    void QueueUpload(const PendingUpload& upload, unsigned long long frameNumber);
+    void AddPendingUpload(const PendingUpload& upload);
+    bool InitTransferQueue();
+    void ShutdownTransferQueue();
+    void CollectAsyncUploads(const UnityVulkanRecordingState& recordingState);
+    void SubmitAsyncUploads(const UnityVulkanRecordingState& recordingState);
+    void InitCompute();
+    void ShutdownCompute();
+    VkDescriptorSet GetStorageImageDescriptorSet(const UnityVulkanImage& image, unsigned long long frameNumber);
+    VkDescriptorSet GetVertexWaveDescriptorSet(const UnityVulkanBuffer& vertices, unsigned long long frameNumber);
+    bool UploadVertexSource(const MeshSource& source, const UnityVulkanRecordingState& recordingState);
+    void QueueDispatch(const PendingDispatch& dispatch, unsigned long long frameNumber);
+    void RecordDispatches(const UnityVulkanRecordingState& recordingState);
+    bool AllocateVertexRing(VkDeviceSize sizeInBytes, const UnityVulkanRecordingState& recordingState, VkDeviceSize* outOffset);
+    VkPipeline GetTrianglePipeline(const UnityVulkanRecordingState& recordingState);
+    void LoadPipelineCache();
+    bool SavePipelineCache();
 
 private:
     IUnityGraphicsVulkan* m_UnityVulkan;
     UnityVulkanInstance m_Instance;
-    VulkanBuffer m_TextureStagingBuffer;
+    VulkanMemoryAllocator m_MemoryAllocator;
+    StagingPool m_StagingPool; // host visible, written by the CPU
+    StagingPool m_TransferPool; // device local, written by the transfer queue
+    std::vector<PendingUpload> m_PendingUploads; // at most one per resource
+    unsigned long long m_PendingUploadFrame; // frame the pending uploads and dispatches were queued in
+    std::vector<VkImageMemoryBarrier> m_UploadImageBarriers; // scratch for FlushUploads
+    std::vector<VkBufferMemoryBarrier> m_UploadBufferBarriers;
+    VkQueue m_TransferQueue; // VK_NULL_HANDLE if there is none; all uploads are then recorded by FlushUploads
+    uint32_t m_TransferQueueFamily;
+    VkCommandPool m_TransferCommandPool;
+    VkCommandBuffer m_TransferCommandBuffers[kTransferCommandBuffers]; // used round robin
+    uint64_t m_TransferCommandBufferValues[kTransferCommandBuffers]; // timeline value of their last submit
+    int m_NextTransferCommandBuffer;
+    VkSemaphore m_TransferTimeline;
+    uint64_t m_TransferTimelineValue; // last value signaled by a submit
+    std::vector<AsyncUpload> m_AsyncUploads; // oldest first
+    std::vector<PendingDispatch> m_PendingDispatches; // at most one per resource
+    bool m_ComputeInitialized; // InitCompute was called; not tried again if it failed
+    VkDescriptorPool m_ComputeDescriptorPool;
+    VkDescriptorSetLayout m_PlasmaSetLayout;
+    VkPipelineLayout m_PlasmaPipelineLayout;
+    VkPipeline m_PlasmaPipeline;
+    StorageImageBinding m_StorageImages[kMaxStorageImageBindings]; // least recently used one is replaced
+    int m_StorageImageCount;
+    VkDescriptorSetLayout m_VertexWaveSetLayout;
+    VkPipelineLayout m_VertexWavePipelineLayout;
+    VkPipeline m_VertexWavePipeline;
+    VertexWaveBinding m_VertexWaveBinding; // for the vertex buffer written last
+    VulkanBuffer m_VertexSourceBuffer; // device local copy of the source mesh, for the vertex wave shader
+    int m_VertexSourceCount;
+    unsigned int m_VertexSourceVersion; // sourceVersion given to DeformVertexBuffer with it
+    VkBuffer m_VertexSourceStaging; // staging buffer of a copy to m_VertexSourceBuffer not recorded yet
     VulkanBuffer m_VertexStagingBuffer;
-    std::map<unsigned long long, VulkanBuffers> m_DeleteQueue;
+    VulkanBuffer m_VertexRingBuffer; // DrawSimpleTriangles vertices, persistently mapped
+    FrameRingAllocator m_VertexRing;
+    VkPhysicalDeviceProperties m_DeviceProperties;
+    VkDeviceSize m_NonCoherentAtomSize;
+    std::string m_CacheDirectory;
+    VkPipelineCache m_PipelineCache;
+    RetiredResources m_DeleteQueue[kDeleteQueueFrames];
+    unsigned long long m_CollectedFrameNumber; // safeFrameNumber at the last GarbageCollect
     VkPipelineLayout m_TrianglePipelineLayout;
-    VkPipeline m_TrianglePipeline;
-    VkRenderPass m_TrianglePipelineRenderPass;
+    TrianglePipeline m_TrianglePipelines[kMaxTrianglePipelines]; // least recently used one is replaced
+    int m_TrianglePipelineCount;
+    int m_LastTrianglePipeline; // index of the one the previous draw used
 };
 
 
@@ -478,12 +1725,50 @@ RenderAPI* CreateRenderAPI_Vulkan()
 
 RenderAPI_Vulkan::RenderAPI_Vulkan()
     : m_UnityVulkan(NULL)
-    , m_TextureStagingBuffer()
+    , m_PendingUploadFrame(0)
+    , m_TransferQueue(VK_NULL_HANDLE)
+    , m_TransferQueueFamily(VK_QUEUE_FAMILY_IGNORED)
+    , m_TransferCommandPool(VK_NULL_HANDLE)
+    , m_NextTransferCommandBuffer(0)
+    , m_TransferTimeline(VK_NULL_HANDLE)
+    , m_TransferTimelineValue(0)
+    , m_ComputeInitialized(false)
+    , m_ComputeDescriptorPool(VK_NULL_HANDLE)
+    , m_PlasmaSetLayout(VK_NULL_HANDLE)
+    , m_PlasmaPipelineLayout(VK_NULL_HANDLE)
+    , m_PlasmaPipeline(VK_NULL_HANDLE)
+    , m_StorageImageCount(0)
+    , m_VertexWaveSetLayout(VK_NULL_HANDLE)
+    , m_VertexWavePipelineLayout(VK_NULL_HANDLE)
+    , m_VertexWavePipeline(VK_NULL_HANDLE)
+    , m_VertexSourceBuffer()
+    , m_VertexSourceCount(0)
+    , m_VertexSourceVersion(0)
+    , m_VertexSourceStaging(VK_NULL_HANDLE)
     , m_VertexStagingBuffer()
+    , m_VertexRingBuffer()
+    , m_NonCoherentAtomSize(1)
+    , m_PipelineCache(VK_NULL_HANDLE)
+    , m_CollectedFrameNumber(0)
     , m_TrianglePipelineLayout(VK_NULL_HANDLE)
-    , m_TrianglePipeline(VK_NULL_HANDLE)
-    , m_TrianglePipelineRenderPass(VK_NULL_HANDLE)
+    , m_TrianglePipelineCount(0)
+    , m_LastTrianglePipeline(0)
 {
+    memset(&m_DeviceProperties, 0, sizeof(m_DeviceProperties));
+    memset(&m_VertexWaveBinding, 0, sizeof(m_VertexWaveBinding));
+    for (int i = 0; i < kDeleteQueueFrames; ++i)
+        m_DeleteQueue[i].frameNumber = 0;
+    for (int i = 0; i < kTransferCommandBuffers; ++i)
+    {
+        m_TransferCommandBuffers[i] = VK_NULL_HANDLE;
+        m_TransferCommandBufferValues[i] = 0;
+    }
+    m_StagingPool.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    m_StagingPool.memoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    m_StagingPool.shareWithTransferQueue = false;
+    m_TransferPool.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    m_TransferPool.memoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    m_TransferPool.shareWithTransferQueue = false;
 }
 
 void RenderAPI_Vulkan::ProcessDeviceEvent(UnityGfxDeviceEventType type, IUnityInterfaces* interfaces)
@@ -497,12 +1782,31 @@ void RenderAPI_Vulkan::ProcessDeviceEvent(UnityGfxDeviceEventType type, IUnityIn
         // Make sure Vulkan API functions are loaded
         LoadVulkanAPI(m_Instance.getInstanceProcAddr, m_Instance.instance);
 
+        vkGetPhysicalDeviceProperties(m_Instance.physicalDevice, &m_DeviceProperties);
+        m_NonCoherentAtomSize = m_DeviceProperties.limits.nonCoherentAtomSize > 0 ? m_DeviceProperties.limits.nonCoherentAtomSize : 1;
+        m_MemoryAllocator.Init(m_Instance.device, m_Instance.physicalDevice);
+
+        // Big uploads go through the transfer queue, if Hook_vkCreateDevice could add one
+        m_StagingPool.shareWithTransferQueue = InitTransferQueue();
+
+        // Pipelines compiled in earlier runs, if the cache directory is known already
+        LoadPipelineCache();
+
         UnityVulkanPluginEventConfig config_1;
         config_1.graphicsQueueAccess = kUnityVulkanGraphicsQueueAccess_DontCare;
         config_1.renderPassPrecondition = kUnityVulkanRenderPass_EnsureInside;
         config_1.flags = kUnityVulkanEventConfigFlag_EnsurePreviousFrameSubmission | kUnityVulkanEventConfigFlag_ModifiesCommandBuffersState;
         m_UnityVulkan->ConfigureEvent(1, &config_1);
 
+        // Event 3 records the texture and vertex buffer uploads and compute dispatches queued during
+        // event 1 (FlushUploads), so that Unity's render pass is broken at most once per frame for them.
+        // Dispatches bind a compute pipeline and descriptor set, Unity has to rebind its own after.
+        UnityVulkanPluginEventConfig config_3;
+        config_3.graphicsQueueAccess = kUnityVulkanGraphicsQueueAccess_DontCare;
+        config_3.renderPassPrecondition = kUnityVulkanRenderPass_EnsureOutside;
+        config_3.flags = kUnityVulkanEventConfigFlag_EnsurePreviousFrameSubmission | kUnityVulkanEventConfigFlag_ModifiesCommandBuffersState;
+        m_UnityVulkan->ConfigureEvent(3, &config_3);
+
         // alternative way to intercept API
         m_UnityVulkan->InterceptVulkanAPI("vkCmdBeginRenderPass", (PFN_vkVoidFunction)Hook_vkCmdBeginRenderPass);
         break;
@@ -510,11 +1814,27 @@ void RenderAPI_Vulkan::ProcessDeviceEvent(UnityGfxDeviceEventType type, IUnityIn
 
         if (m_Instance.device != VK_NULL_HANDLE)
         {
+            m_PendingUploads.clear();
+            m_PendingDispatches.clear();
+            ShutdownTransferQueue();
             GarbageCollect(true);
-            if (m_TrianglePipeline != VK_NULL_HANDLE)
+            ShutdownCompute();
+            ImmediateDestroyVulkanBuffer(m_VertexRingBuffer);
+            m_VertexRingBuffer = VulkanBuffer();
+            m_VertexRing.Reset(0);
+            DestroyPooledBuffers(m_StagingPool);
+            DestroyPooledBuffers(m_TransferPool);
+            m_MemoryAllocator.Shutdown();
+            SavePipelineCache();
+            if (m_PipelineCache != VK_NULL_HANDLE)
+            {
+                vkDestroyPipelineCache(m_Instance.device, m_PipelineCache, NULL);
+                m_PipelineCache = VK_NULL_HANDLE;
+            }
+            for (int i = 0; i < m_TrianglePipelineCount; ++i)
             {
-                vkDestroyPipeline(m_Instance.device, m_TrianglePipeline, NULL);
-                m_TrianglePipeline = VK_NULL_HANDLE;
+                if (m_TrianglePipelines[i].pipeline != VK_NULL_HANDLE)
+                    vkDestroyPipeline(m_Instance.device, m_TrianglePipelines[i].pipeline, NULL);
             }
             if (m_TrianglePipelineLayout != VK_NULL_HANDLE)
             {
@@ -524,7 +1844,8 @@ void RenderAPI_Vulkan::ProcessDeviceEvent(UnityGfxDeviceEventType type, IUnityIn
         }
 
         m_UnityVulkan = NULL;
-        m_TrianglePipelineRenderPass = VK_NULL_HANDLE;
+        m_TrianglePipelineCount = 0;
+        m_LastTrianglePipeline = 0;
         m_Instance = UnityVulkanInstance();
 
         break;
@@ -532,17 +1853,76 @@ void RenderAPI_Vulkan::ProcessDeviceEvent(UnityGfxDeviceEventType type, IUnityIn
 }
 
 
-bool RenderAPI_Vulkan::CreateVulkanBuffer(size_t sizeInBytes, VulkanBuffer* buffer, VkBufferUsageFlags usage)
+void RenderAPI_Vulkan::SetCacheDirectory(const char* directory)
 {
+    m_CacheDirectory = directory;
+    if (m_Instance.device != VK_NULL_HANDLE)
+        LoadPipelineCache();
+}
+
+bool RenderAPI_Vulkan::SaveCaches()
+{
+    return SavePipelineCache();
+}
+
+// Creates m_PipelineCache from the file in the cache directory, or merges the file into it when
+// the directory is set after initialization. Always leaves a (possibly empty) cache behind.
+void RenderAPI_Vulkan::LoadPipelineCache()
+{
+    PROFILE_SCOPE("RenderAPI_Vulkan::LoadPipelineCache");
+    std::vector<unsigned char> data;
+    if (!m_CacheDirectory.empty())
+        ReadPipelineCacheFile(m_CacheDirectory + "/" + kPipelineCacheFileName, m_DeviceProperties, &data);
+    if (data.empty() && m_PipelineCache != VK_NULL_HANDLE)
+        return;
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.empty() ? NULL : &data[0];
+    VkPipelineCache cache;
+    if (vkCreatePipelineCache(m_Instance.device, &createInfo, NULL, &cache) != VK_SUCCESS)
+        return;
+
+    if (m_PipelineCache == VK_NULL_HANDLE)
+        m_PipelineCache = cache;
+    else
+    {
+        vkMergePipelineCaches(m_Instance.device, m_PipelineCache, 1, &cache);
+        vkDestroyPipelineCache(m_Instance.device, cache, NULL);
+    }
+}
+
+bool RenderAPI_Vulkan::SavePipelineCache()
+{
+    if (m_CacheDirectory.empty() || m_PipelineCache == VK_NULL_HANDLE)
+        return true;
+
+    PROFILE_SCOPE("RenderAPI_Vulkan::SavePipelineCache");
+    size_t size = 0;
+    if (vkGetPipelineCacheData(m_Instance.device, m_PipelineCache, &size, NULL) != VK_SUCCESS)
+        return false;
+    std::vector<unsigned char> data(size);
+    if (size > 0 && vkGetPipelineCacheData(m_Instance.device, m_PipelineCache, &size, &data[0]) != VK_SUCCESS)
+        return false;
+    data.resize(size);
+    return WritePipelineCacheFile(m_CacheDirectory + "/" + kPipelineCacheFileName, m_DeviceProperties, data);
+}
+
+bool RenderAPI_Vulkan::CreateVulkanBuffer(size_t sizeInBytes, VulkanBuffer* buffer, VkBufferUsageFlags usage,
+    VkMemoryPropertyFlags memoryFlags /*= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT*/, bool shareWithTransferQueue /*= false*/)
+{
+    PROFILE_SCOPE("RenderAPI_Vulkan::CreateVulkanBuffer");
     if (sizeInBytes == 0)
         return false;
 
     VkBufferCreateInfo bufferCreateInfo;
     bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferCreateInfo.pNext = NULL;
-    bufferCreateInfo.pQueueFamilyIndices = &m_Instance.queueFamilyIndex;
-    bufferCreateInfo.queueFamilyIndexCount = 1;
-    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    const uint32_t queueFamilies[2] = { m_Instance.queueFamilyIndex, m_TransferQueueFamily };
+    bufferCreateInfo.pQueueFamilyIndices = queueFamilies;
+    bufferCreateInfo.queueFamilyIndexCount = shareWithTransferQueue ? 2 : 1;
+    bufferCreateInfo.sharingMode = shareWithTransferQueue ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
     bufferCreateInfo.usage = usage;
     bufferCreateInfo.flags = 0;
     bufferCreateInfo.size = sizeInBytes;
@@ -552,89 +1932,212 @@ bool RenderAPI_Vulkan::CreateVulkanBuffer(size_t sizeInBytes, VulkanBuffer* buff
     if (vkCreateBuffer(m_Instance.device, &bufferCreateInfo, NULL, &buffer->buffer) != VK_SUCCESS)
         return false;
 
-    VkPhysicalDeviceMemoryProperties physicalDeviceProperties;
-    vkGetPhysicalDeviceMemoryProperties(m_Instance.physicalDevice, &physicalDeviceProperties);
-
     VkMemoryRequirements memoryRequirements;
     vkGetBufferMemoryRequirements(m_Instance.device, buffer->buffer, &memoryRequirements);
 
-    const int memoryTypeIndex = FindMemoryTypeIndex(physicalDeviceProperties, memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-    if (memoryTypeIndex < 0)
-    {
-        ImmediateDestroyVulkanBuffer(*buffer);
-        return false;
-    }
-
-    VkMemoryAllocateInfo memoryAllocateInfo;
-    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memoryAllocateInfo.pNext = NULL;
-    memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
-    memoryAllocateInfo.allocationSize = memoryRequirements.size;
-
-    if (vkAllocateMemory(m_Instance.device, &memoryAllocateInfo, NULL, &buffer->deviceMemory) != VK_SUCCESS)
-    {
-        ImmediateDestroyVulkanBuffer(*buffer);
-        return false;
-    }
-
-    if (vkMapMemory(m_Instance.device, buffer->deviceMemory, 0, VK_WHOLE_SIZE, 0, &buffer->mapped) != VK_SUCCESS)
+    if (!m_MemoryAllocator.Allocate(memoryRequirements, memoryFlags, true, &buffer->memory))
     {
         ImmediateDestroyVulkanBuffer(*buffer);
         return false;
     }
 
-    if (vkBindBufferMemory(m_Instance.device, buffer->buffer, buffer->deviceMemory, 0) != VK_SUCCESS)
+    if (vkBindBufferMemory(m_Instance.device, buffer->buffer, buffer->memory.memory, buffer->memory.offset) != VK_SUCCESS)
     {
         ImmediateDestroyVulkanBuffer(*buffer);
         return false;
     }
 
     buffer->sizeInBytes = sizeInBytes;
-    buffer->deviceMemoryFlags = physicalDeviceProperties.memoryTypes[memoryTypeIndex].propertyFlags;
-    buffer->deviceMemorySize = memoryAllocateInfo.allocationSize;
 
     return true;
 }
 
 void RenderAPI_Vulkan::ImmediateDestroyVulkanBuffer(const VulkanBuffer& buffer)
 {
+    PROFILE_SCOPE("RenderAPI_Vulkan::ImmediateDestroyVulkanBuffer");
     if (buffer.buffer != VK_NULL_HANDLE)
         vkDestroyBuffer(m_Instance.device, buffer.buffer, NULL);
 
-    if (buffer.mapped && buffer.deviceMemory != VK_NULL_HANDLE)
-        vkUnmapMemory(m_Instance.device, buffer.deviceMemory);
+    m_MemoryAllocator.Free(buffer.memory);
+}
+
+// Makes CPU writes to [offset, offset + size) of a buffer visible to the GPU, if its memory is not coherent
+void RenderAPI_Vulkan::FlushVulkanBuffer(const VulkanBuffer& buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+    if (buffer.memory.flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+        return;
 
-    if (buffer.deviceMemory != VK_NULL_HANDLE)
-        vkFreeMemory(m_Instance.device, buffer.deviceMemory, NULL);
+    // Memory ranges from the allocator start on an atom boundary, and are a whole number of atoms long
+    VkMappedMemoryRange range;
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.pNext = NULL;
+    range.memory = buffer.memory.memory;
+    range.offset = buffer.memory.offset + offset / m_NonCoherentAtomSize * m_NonCoherentAtomSize;
+    range.size = AlignUp(buffer.memory.offset + offset + size, m_NonCoherentAtomSize) - range.offset;
+    vkFlushMappedMemoryRanges(m_Instance.device, 1, &range);
+}
+
+bool RenderAPI_Vulkan::GetMemoryStats(PluginMemoryStats* stats)
+{
+    m_MemoryAllocator.GetStats(stats);
+    return true;
 }
 
 
+RenderAPI_Vulkan::RetiredResources& RenderAPI_Vulkan::GetRetiredResources(unsigned long long frameNumber)
+{
+    // The slot is either empty, or holds an older frame the GPU is not done with yet (as it would have
+    // been collected otherwise); its resources then wait for this frame instead
+    RetiredResources& resources = m_DeleteQueue[frameNumber % kDeleteQueueFrames];
+    if (resources.frameNumber < frameNumber)
+        resources.frameNumber = frameNumber;
+    return resources;
+}
+
 void RenderAPI_Vulkan::SafeDestroy(unsigned long long frameNumber, const VulkanBuffer& buffer)
 {
-    m_DeleteQueue[frameNumber].push_back(buffer);
+    GetRetiredResources(frameNumber).buffers.push_back(buffer);
+}
+
+void RenderAPI_Vulkan::SafeDestroy(unsigned long long frameNumber, VkPipeline pipeline)
+{
+    GetRetiredResources(frameNumber).pipelines.push_back(pipeline);
+}
+
+void RenderAPI_Vulkan::DestroyRetiredResources(RetiredResources& resources)
+{
+    for (size_t i = 0; i < resources.buffers.size(); ++i)
+        ImmediateDestroyVulkanBuffer(resources.buffers[i]);
+    for (size_t i = 0; i < resources.pipelines.size(); ++i)
+        vkDestroyPipeline(m_Instance.device, resources.pipelines[i], NULL);
+    for (size_t i = 0; i < resources.imageViews.size(); ++i)
+        vkDestroyImageView(m_Instance.device, resources.imageViews[i], NULL);
+    if (!resources.descriptorSets.empty())
+        vkFreeDescriptorSets(m_Instance.device, m_ComputeDescriptorPool, (uint32_t)resources.descriptorSets.size(), &resources.descriptorSets[0]);
+    resources.buffers.clear();
+    resources.pipelines.clear();
+    resources.imageViews.clear();
+    resources.descriptorSets.clear();
 }
 
 void RenderAPI_Vulkan::GarbageCollect(bool force /*= false*/)
 {
-    UnityVulkanRecordingState recordingState;
+    PROFILE_SCOPE("RenderAPI_Vulkan::GarbageCollect");
     if (force)
-        recordingState.safeFrameNumber = ~0ull;
-    else
-        if (!m_UnityVulkan->CommandRecordingState(&recordingState, kUnityVulkanGraphicsQueueAccess_DontCare))
-            return;
+    {
+        for (int i = 0; i < kDeleteQueueFrames; ++i)
+            DestroyRetiredResources(m_DeleteQueue[i]);
+        return;
+    }
 
-    DeleteQueue::iterator it = m_DeleteQueue.begin();
-    while (it != m_DeleteQueue.end())
+    UnityVulkanRecordingState recordingState;
+    if (!m_UnityVulkan->CommandRecordingState(&recordingState, kUnityVulkanGraphicsQueueAccess_DontCare))
+        return;
+
+    // Only the slots of frames that became safe since the last call can have anything to delete
+    const unsigned long long safeFrameNumber = recordingState.safeFrameNumber;
+    if (safeFrameNumber <= m_CollectedFrameNumber)
+        return;
+    const unsigned long long newlySafeFrames = safeFrameNumber - m_CollectedFrameNumber;
+    const int slotCount = newlySafeFrames < kDeleteQueueFrames ? int(newlySafeFrames) : kDeleteQueueFrames;
+    for (int i = 0; i < slotCount; ++i)
     {
-        if (it->first <= recordingState.safeFrameNumber)
+        RetiredResources& resources = m_DeleteQueue[(safeFrameNumber - i) % kDeleteQueueFrames];
+        if (resources.frameNumber <= safeFrameNumber)
+            DestroyRetiredResources(resources);
+    }
+    m_CollectedFrameNumber = safeFrameNumber;
+}
+
+// Vertex data of all draws of a frame goes into one ring buffer; sized for this many frames of it.
+static const int kVertexRingFrames = 3;
+static const VkDeviceSize kVertexRingMinSize = 256 * 1024;
+
+bool RenderAPI_Vulkan::AllocateVertexRing(VkDeviceSize sizeInBytes, const UnityVulkanRecordingState& recordingState, VkDeviceSize* outOffset)
+{
+    if (sizeInBytes == 0)
+        return false;
+
+    // Ranges flushed for non-coherent memory have to start and end on atom boundaries
+    const bool coherent = (m_VertexRingBuffer.memory.flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    VkDeviceSize alignment = 16;
+    if (m_VertexRingBuffer.buffer != VK_NULL_HANDLE && !coherent)
+        alignment = AlignUp(m_NonCoherentAtomSize, 16);
+
+    if (m_VertexRingBuffer.buffer != VK_NULL_HANDLE
+        && m_VertexRing.Allocate(sizeInBytes, alignment, recordingState.currentFrameNumber, recordingState.safeFrameNumber, outOffset))
+        return true;
+
+    // Full (or not created yet): start over with a bigger buffer. Draws recorded earlier keep using
+    // the old one, so it is only destroyed once the GPU is done with this frame.
+    PROFILE_SCOPE("RenderAPI_Vulkan::GrowVertexRing");
+    const VkDeviceSize atomAlignment = AlignUp(m_NonCoherentAtomSize, 16);
+    VkDeviceSize newSize = m_VertexRing.GetSize() * 2;
+    if (newSize < kVertexRingMinSize)
+        newSize = kVertexRingMinSize;
+    if (newSize < sizeInBytes * kVertexRingFrames)
+        newSize = sizeInBytes * kVertexRingFrames;
+    newSize = AlignUp(newSize, atomAlignment);
+
+    if (m_VertexRingBuffer.buffer != VK_NULL_HANDLE)
+        SafeDestroy(recordingState.currentFrameNumber, m_VertexRingBuffer);
+    m_VertexRingBuffer = VulkanBuffer();
+    m_VertexRing.Reset(0);
+    if (!CreateVulkanBuffer(static_cast<size_t>(newSize), &m_VertexRingBuffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT))
+        return false;
+    m_VertexRing.Reset(newSize);
+
+    alignment = (m_VertexRingBuffer.memory.flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) ? 16 : atomAlignment;
+    return m_VertexRing.Allocate(sizeInBytes, alignment, recordingState.currentFrameNumber, recordingState.safeFrameNumber, outOffset);
+}
+
+VkPipeline RenderAPI_Vulkan::GetTrianglePipeline(const UnityVulkanRecordingState& recordingState)
+{
+    // Unity does not destroy render passes, so this is safe regarding ABA-problem
+    int index = m_LastTrianglePipeline;
+    if (index >= m_TrianglePipelineCount
+        || m_TrianglePipelines[index].renderPass != recordingState.renderPass
+        || m_TrianglePipelines[index].subPassIndex != recordingState.subPassIndex)
+    {
+        index = -1;
+        for (int i = 0; i < m_TrianglePipelineCount && index < 0; ++i)
         {
-            for (size_t i = 0; i < it->second.size(); ++i)
-                ImmediateDestroyVulkanBuffer(it->second[i]);
-            m_DeleteQueue.erase(it++);
+            if (m_TrianglePipelines[i].renderPass == recordingState.renderPass && m_TrianglePipelines[i].subPassIndex == recordingState.subPassIndex)
+                index = i;
         }
+    }
+
+    if (index < 0)
+    {
+        if (m_TrianglePipelineLayout == VK_NULL_HANDLE)
+            m_TrianglePipelineLayout = CreateTrianglePipelineLayout(m_Instance.device);
+
+        if (m_TrianglePipelineCount < kMaxTrianglePipelines)
+            index = m_TrianglePipelineCount++;
         else
-            ++it;
+        {
+            // Replace the least recently used one; command buffers in flight may still use it
+            index = 0;
+            for (int i = 1; i < m_TrianglePipelineCount; ++i)
+            {
+                if (m_TrianglePipelines[i].lastUsedFrame < m_TrianglePipelines[index].lastUsedFrame)
+                    index = i;
+            }
+            if (m_TrianglePipelines[index].pipeline != VK_NULL_HANDLE)
+                SafeDestroy(recordingState.currentFrameNumber, m_TrianglePipelines[index].pipeline);
+        }
+
+        PROFILE_SCOPE("RenderAPI_Vulkan::CreateTrianglePipeline");
+        TrianglePipeline& entry = m_TrianglePipelines[index];
+        entry.renderPass = recordingState.renderPass;
+        entry.subPassIndex = recordingState.subPassIndex;
+        entry.pipeline = CreateTrianglePipeline(m_Instance.device, m_TrianglePipelineLayout, recordingState.renderPass,
+            recordingState.subPassIndex > 0 ? recordingState.subPassIndex : 0, m_PipelineCache);
     }
+
+    m_TrianglePipelines[index].lastUsedFrame = recordingState.currentFrameNumber;
+    m_LastTrianglePipeline = index;
+    return m_TrianglePipelines[index].pipeline;
 }
 
 void RenderAPI_Vulkan::DrawSimpleTriangles(const float worldMatrix[16], int triangleCount, const void* verticesFloat3Byte4)
@@ -646,44 +2149,146 @@ void RenderAPI_Vulkan::DrawSimpleTriangles(const float worldMatrix[16], int tria
     if (!m_UnityVulkan->CommandRecordingState(&recordingState, kUnityVulkanGraphicsQueueAccess_DontCare))
         return;
 
-    // Unity does not destroy render passes, so this is safe regarding ABA-problem
-    if (recordingState.renderPass != m_TrianglePipelineRenderPass)
+    const VkPipeline pipeline = GetTrianglePipeline(recordingState);
+    if (pipeline != VK_NULL_HANDLE && m_TrianglePipelineLayout != VK_NULL_HANDLE)
     {
-        if (m_TrianglePipelineLayout == VK_NULL_HANDLE)
-            m_TrianglePipelineLayout = CreateTrianglePipelineLayout(m_Instance.device);
+        const VkDeviceSize sizeInBytes = 16 * 3 * triangleCount;
+        VkDeviceSize offset;
+        if (!AllocateVertexRing(sizeInBytes, recordingState, &offset))
+            return;
+
+        memcpy((char*)m_VertexRingBuffer.memory.mapped + offset, verticesFloat3Byte4, static_cast<size_t>(sizeInBytes));
+        FlushVulkanBuffer(m_VertexRingBuffer, offset, sizeInBytes);
 
-        m_TrianglePipeline = CreateTrianglePipeline(m_Instance.device, m_TrianglePipelineLayout, recordingState.renderPass, VK_NULL_HANDLE);
-		m_TrianglePipelineRenderPass = recordingState.renderPass;
+        vkCmdBindVertexBuffers(recordingState.commandBuffer, 0, 1, &m_VertexRingBuffer.buffer, &offset);
+        vkCmdPushConstants(recordingState.commandBuffer, m_TrianglePipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, 64, (const void*)worldMatrix);
+        vkCmdBindPipeline(recordingState.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        vkCmdDraw(recordingState.commandBuffer, triangleCount * 3, 1, 0, 0);
     }
 
-    if (m_TrianglePipeline != VK_NULL_HANDLE && m_TrianglePipelineLayout != VK_NULL_HANDLE)
+    GarbageCollect();
+}
+
+// Staging buffers are 64 KB << size class; free ones not used for this many frames are destroyed.
+static const size_t kStagingMinSize = 64 * 1024;
+static const unsigned long long kStagingKeepFrames = 120;
+
+static int GetStagingSizeClass(size_t sizeInBytes)
+{
+    int sizeClass = 0;
+    while ((kStagingMinSize << sizeClass) < sizeInBytes)
+        ++sizeClass;
+    return sizeClass;
+}
+
+// Marks pooled buffers a transfer queue copy is using; recycled after it is done, not by frame number
+static const unsigned long long kStagingOnTransferQueue = ~0ull;
+
+// Returns the mapped memory of a staging buffer of at least sizeInBytes, that is not used by the GPU,
+// nor handed out already this frame
+void* RenderAPI_Vulkan::AcquireStagingBuffer(size_t sizeInBytes, const UnityVulkanRecordingState& recordingState)
+{
+    PROFILE_SCOPE("RenderAPI_Vulkan::AcquireStagingBuffer");
+    // Uploads (or the source mesh copy of dispatches) of an earlier frame that nobody flushed (event 3
+    // not issued): record them now, before their staging buffers could be recycled
+    if ((!m_PendingUploads.empty() || !m_PendingDispatches.empty()) && m_PendingUploadFrame != recordingState.currentFrameNumber)
+        FlushUploads();
+
+    StagingBuffer* staging = AcquirePooledBuffer(m_StagingPool, sizeInBytes, recordingState);
+    return staging ? staging->buffer.memory.mapped : NULL;
+}
+
+const RenderAPI_Vulkan::StagingBuffer* RenderAPI_Vulkan::FindStagingBuffer(const void* mapped) const
+{
+    // Usually the one handed out last
+    for (size_t i = m_StagingPool.inUse.size(); i-- > 0; )
     {
-        VulkanBuffer buffer;
-        if (!CreateVulkanBuffer(16 * 3 * triangleCount, &buffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT))
-            return;
+        if (m_StagingPool.inUse[i].buffer.memory.mapped == mapped)
+            return &m_StagingPool.inUse[i];
+    }
+    return NULL;
+}
 
-        memcpy(buffer.mapped, verticesFloat3Byte4, static_cast<size_t>(buffer.sizeInBytes));
-        if (!(buffer.deviceMemoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
-        {
-            VkMappedMemoryRange range;
-            range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-            range.pNext = NULL;
-            range.memory = buffer.deviceMemory;
-            range.offset = 0;
-            range.size = buffer.deviceMemorySize;
-            vkFlushMappedMemoryRanges(m_Instance.device, 1, &range);
-        }
+// Hands out a buffer of the pool that is not used by the GPU; marked as used in the current frame.
+// The pointer is only valid until the next buffer is handed out.
+RenderAPI_Vulkan::StagingBuffer* RenderAPI_Vulkan::AcquirePooledBuffer(StagingPool& pool, size_t sizeInBytes, const UnityVulkanRecordingState& recordingState)
+{
+    RecyclePooledBuffers(pool, recordingState.safeFrameNumber, recordingState.currentFrameNumber);
 
-        const VkDeviceSize offset = 0;
-        vkCmdBindVertexBuffers(recordingState.commandBuffer, 0, 1, &buffer.buffer, &offset);
-        vkCmdPushConstants(recordingState.commandBuffer, m_TrianglePipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, 64, (const void*)worldMatrix);
-        vkCmdBindPipeline(recordingState.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_TrianglePipeline);
-        vkCmdDraw(recordingState.commandBuffer, triangleCount * 3, 1, 0, 0);
+    const int sizeClass = GetStagingSizeClass(sizeInBytes);
+    if (sizeClass >= kStagingSizeClasses)
+        return NULL;
 
-        SafeDestroy(recordingState.currentFrameNumber, buffer);
+    StagingBuffer staging;
+    std::vector<StagingBuffer>& freeBuffers = pool.free[sizeClass];
+    if (!freeBuffers.empty())
+    {
+        staging = freeBuffers.back();
+        freeBuffers.pop_back();
     }
+    else
+    {
+        if (!CreateVulkanBuffer(kStagingMinSize << sizeClass, &staging.buffer, pool.usage, pool.memoryFlags, pool.shareWithTransferQueue))
+            return NULL;
+        staging.sizeClass = sizeClass;
+    }
+    staging.lastUsedFrame = recordingState.currentFrameNumber;
+    pool.inUse.push_back(staging);
+    return &pool.inUse.back();
+}
 
-    GarbageCollect();
+RenderAPI_Vulkan::StagingBuffer* RenderAPI_Vulkan::FindPooledBuffer(StagingPool& pool, VkBuffer buffer)
+{
+    for (size_t i = 0; i < pool.inUse.size(); ++i)
+    {
+        if (pool.inUse[i].buffer.buffer == buffer)
+            return &pool.inUse[i];
+    }
+    return NULL;
+}
+
+// Moves the buffers the GPU is done with back to the free lists, and destroys free buffers that
+// were not needed for a while
+void RenderAPI_Vulkan::RecyclePooledBuffers(StagingPool& pool, unsigned long long safeFrameNumber, unsigned long long currentFrameNumber)
+{
+    size_t inUseCount = 0;
+    for (size_t i = 0; i < pool.inUse.size(); ++i)
+    {
+        const StagingBuffer& staging = pool.inUse[i];
+        if (staging.lastUsedFrame <= safeFrameNumber)
+            pool.free[staging.sizeClass].push_back(staging);
+        else
+            pool.inUse[inUseCount++] = staging;
+    }
+    pool.inUse.resize(inUseCount);
+
+    for (int sizeClass = 0; sizeClass < kStagingSizeClasses; ++sizeClass)
+    {
+        std::vector<StagingBuffer>& freeBuffers = pool.free[sizeClass];
+        size_t keepCount = 0;
+        for (size_t i = 0; i < freeBuffers.size(); ++i)
+        {
+            if (freeBuffers[i].lastUsedFrame + kStagingKeepFrames < currentFrameNumber)
+                ImmediateDestroyVulkanBuffer(freeBuffers[i].buffer);
+            else
+                freeBuffers[keepCount++] = freeBuffers[i];
+        }
+        freeBuffers.resize(keepCount);
+    }
+}
+
+// Only when the GPU is done with all of them
+void RenderAPI_Vulkan::DestroyPooledBuffers(StagingPool& pool)
+{
+    for (size_t i = 0; i < pool.inUse.size(); ++i)
+        ImmediateDestroyVulkanBuffer(pool.inUse[i].buffer);
+    pool.inUse.clear();
+    for (int sizeClass = 0; sizeClass < kStagingSizeClasses; ++sizeClass)
+    {
+        for (size_t i = 0; i < pool.free[sizeClass].size(); ++i)
+            ImmediateDestroyVulkanBuffer(pool.free[sizeClass][i].buffer);
+        pool.free[sizeClass].clear();
+    }
 }
 
 void* RenderAPI_Vulkan::BeginModifyTexture(void* textureHandle, int textureWidth, int textureHeight, int* outRowPitch)
@@ -695,43 +2300,57 @@ void* RenderAPI_Vulkan::BeginModifyTexture(void* textureHandle, int textureWidth
     if (!m_UnityVulkan->CommandRecordingState(&recordingState, kUnityVulkanGraphicsQueueAccess_DontCare))
         return NULL;
 
-    SafeDestroy(recordingState.currentFrameNumber, m_TextureStagingBuffer);
-    m_TextureStagingBuffer = VulkanBuffer();
-    if (!CreateVulkanBuffer(stagingBufferSizeRequirements, &m_TextureStagingBuffer, VK_BUFFER_USAGE_TRANSFER_SRC_BIT))
-        return NULL;
-
-    return m_TextureStagingBuffer.mapped;
+    return AcquireStagingBuffer(stagingBufferSizeRequirements, recordingState);
 }
 
 void RenderAPI_Vulkan::EndModifyTexture(void* textureHandle, int textureWidth, int textureHeight, int rowPitch, void* dataPtr)
 {
-    // cannot do resource uploads inside renderpass
-    m_UnityVulkan->EnsureOutsideRenderPass();
-
-    UnityVulkanImage image;
-    if (!m_UnityVulkan->AccessTexture(textureHandle, UnityVulkanWholeImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, kUnityVulkanResourceAccess_PipelineBarrier, &image))
+    const StagingBuffer* staging = FindStagingBuffer(dataPtr);
+    if (!staging)
         return;
+    FlushVulkanBuffer(staging->buffer, 0, staging->buffer.sizeInBytes);
+
+    // The copy is recorded by FlushUploads, outside of the render pass
+    PendingUpload upload;
+    upload.handle = textureHandle;
+    upload.isTexture = true;
+    upload.stagingBuffer = staging->buffer.buffer;
+    upload.width = textureWidth;
+    upload.height = textureHeight;
+    upload.sizeInBytes = VkDeviceSize(rowPitch) * textureHeight;
+    upload.fromTransferQueue = false;
+    QueueUpload(upload, staging->lastUsedFrame);
+}
 
+// The compute shader writes the texture in FlushUploads, straight into Unity's image: no staging
+// buffer, and no copy
+bool RenderAPI_Vulkan::GenerateTexture(void* textureHandle, int textureWidth, int textureHeight, float t)
+{
     UnityVulkanRecordingState recordingState;
     if (!m_UnityVulkan->CommandRecordingState(&recordingState, kUnityVulkanGraphicsQueueAccess_DontCare))
-        return;
+        return false;
 
-    VkBufferImageCopy region;
-    region.bufferImageHeight = 0;
-    region.bufferRowLength = 0;
-    region.bufferOffset = 0;
-    region.imageOffset.x = 0;
-    region.imageOffset.y = 0;
-    region.imageOffset.z = 0;
-    region.imageExtent.width = textureWidth;
-    region.imageExtent.height = textureHeight;
-    region.imageExtent.depth = 1;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageSubresource.mipLevel = 0;
-    vkCmdCopyBufferToImage(recordingState.commandBuffer, m_TextureStagingBuffer.buffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    // The shader writes rgba8 texels, so it takes an RGBA8 image created for storage (a random write RenderTexture)
+    UnityVulkanImage image;
+    if (!m_UnityVulkan->AccessTexture(textureHandle, UnityVulkanWholeImage, VK_IMAGE_LAYOUT_UNDEFINED, 0, 0, kUnityVulkanResourceAccess_ObserveOnly, &image))
+        return false;
+    if (image.format != VK_FORMAT_R8G8B8A8_UNORM || !(image.usage & VK_IMAGE_USAGE_STORAGE_BIT)
+        || image.extent.width < (uint32_t)textureWidth || image.extent.height < (uint32_t)textureHeight)
+        return false;
+
+    InitCompute();
+    if (m_PlasmaPipeline == VK_NULL_HANDLE)
+        return false;
+
+    PendingDispatch dispatch;
+    dispatch.handle = textureHandle;
+    dispatch.isTexture = true;
+    dispatch.width = textureWidth;
+    dispatch.height = textureHeight;
+    dispatch.vertexCount = 0;
+    dispatch.t = t;
+    QueueDispatch(dispatch, recordingState.currentFrameNumber);
+    return true;
 }
 
 void* RenderAPI_Vulkan::BeginModifyVertexBuffer(void* bufferHandle, size_t* outBufferSize)
@@ -746,8 +2365,25 @@ void* RenderAPI_Vulkan::BeginModifyVertexBuffer(void* bufferHandle, size_t* outB
 
     *outBufferSize = bufferInfo.sizeInBytes;
 
+    // Not host visible: write to a staging buffer, copied over by FlushUploads
     if (!bufferInfo.memory.mapped)
-        return NULL;
+    {
+        if (!(bufferInfo.usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT))
+            return NULL;
+        void* mapped = AcquireStagingBuffer(bufferInfo.sizeInBytes, recordingState);
+        if (!mapped)
+            return NULL;
+
+        PendingUpload upload;
+        upload.handle = bufferHandle;
+        upload.isTexture = false;
+        upload.stagingBuffer = FindStagingBuffer(mapped)->buffer.buffer;
+        upload.width = upload.height = 0;
+        upload.sizeInBytes = bufferInfo.sizeInBytes;
+        upload.fromTransferQueue = false;
+        QueueUpload(upload, recordingState.currentFrameNumber);
+        return mapped;
+    }
 
     // We don't want to start modifying a resource that might still be used by the GPU,
     // so we can use kUnityVulkanResourceAccess_Recreate to recreate it while still keeping the old one alive if it's in use.
@@ -761,8 +2397,17 @@ void* RenderAPI_Vulkan::BeginModifyVertexBuffer(void* bufferHandle, size_t* outB
 
 void RenderAPI_Vulkan::EndModifyVertexBuffer(void* bufferHandle)
 {
-    // cannot do resource uploads inside renderpass, but we know that the texture modification is done first and that already ends the renderpass
-    // m_UnityVulkan->EnsureOutsideRenderPass(); 
+    // Staged: make the staging writes visible, the copy itself is recorded by FlushUploads
+    for (size_t i = 0; i < m_PendingUploads.size(); ++i)
+    {
+        const PendingUpload& upload = m_PendingUploads[i];
+        if (upload.handle == bufferHandle && !upload.isTexture)
+        {
+            if (const StagingBuffer* staging = FindPooledBuffer(m_StagingPool, upload.stagingBuffer))
+                FlushVulkanBuffer(staging->buffer, 0, upload.sizeInBytes);
+            return;
+        }
+    }
 
     UnityVulkanBuffer buffer;
     if (!m_UnityVulkan->AccessBuffer(bufferHandle, 0, 0, kUnityVulkanResourceAccess_ObserveOnly, &buffer))
@@ -780,4 +2425,916 @@ void RenderAPI_Vulkan::EndModifyVertexBuffer(void* bufferHandle)
     }
 }
 
+// The compute shader writes the vertices in FlushUploads, straight into Unity's vertex buffer, from a
+// copy of the source mesh in device local memory. Per frame that is one dispatch, whatever the vertex count.
+bool RenderAPI_Vulkan::DeformVertexBuffer(void* bufferHandle, int vertexCount, const MeshSource& source, unsigned int sourceVersion, float t)
+{
+    UnityVulkanRecordingState recordingState;
+    if (!m_UnityVulkan->CommandRecordingState(&recordingState, kUnityVulkanGraphicsQueueAccess_DontCare))
+        return false;
+    if (vertexCount <= 0 || vertexCount > source.GetVertexCount())
+        return false;
+
+    // The shader writes MeshVertex structs through a storage buffer (a raw GraphicsBuffer in Unity)
+    UnityVulkanBuffer bufferInfo;
+    if (!m_UnityVulkan->AccessBuffer(bufferHandle, 0, 0, kUnityVulkanResourceAccess_ObserveOnly, &bufferInfo))
+        return false;
+    if (!(bufferInfo.usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) || bufferInfo.sizeInBytes < VkDeviceSize(vertexCount) * sizeof(MeshVertex))
+        return false;
+
+    // All vertices in one dispatch, 64 per group
+    if (uint32_t((vertexCount + 63) / 64) > m_DeviceProperties.limits.maxComputeWorkGroupCount[0])
+        return false;
+
+    InitCompute();
+    if (m_VertexWavePipeline == VK_NULL_HANDLE)
+        return false;
+
+    if (m_VertexSourceBuffer.buffer == VK_NULL_HANDLE || sourceVersion != m_VertexSourceVersion)
+    {
+        if (!UploadVertexSource(source, recordingState))
+            return false;
+        m_VertexSourceVersion = sourceVersion;
+    }
+
+    PendingDispatch dispatch;
+    dispatch.handle = bufferHandle;
+    dispatch.isTexture = false;
+    dispatch.width = dispatch.height = 0;
+    dispatch.vertexCount = vertexCount;
+    dispatch.t = t;
+    QueueDispatch(dispatch, recordingState.currentFrameNumber);
+    return true;
+}
+
+// Source mesh as the vertex wave shader reads it: position, normal and UV of a vertex next to each other
+static const int kVertexSourceFloats = 8;
+
+// Creates m_VertexSourceBuffer for the source mesh; the copy to it is recorded with the next dispatches
+bool RenderAPI_Vulkan::UploadVertexSource(const MeshSource& source, const UnityVulkanRecordingState& recordingState)
+{
+    PROFILE_SCOPE("RenderAPI_Vulkan::UploadVertexSource");
+
+    // The descriptor set refers to the old buffer; both are still used by the frames in flight
+    if (m_VertexWaveBinding.descriptorSet != VK_NULL_HANDLE)
+        GetRetiredResources(recordingState.currentFrameNumber).descriptorSets.push_back(m_VertexWaveBinding.descriptorSet);
+    memset(&m_VertexWaveBinding, 0, sizeof(m_VertexWaveBinding));
+    if (m_VertexSourceBuffer.buffer != VK_NULL_HANDLE)
+        SafeDestroy(recordingState.currentFrameNumber, m_VertexSourceBuffer);
+    m_VertexSourceBuffer = VulkanBuffer();
+    m_VertexSourceCount = 0;
+    m_VertexSourceStaging = VK_NULL_HANDLE;
+
+    const int vertexCount = source.GetVertexCount();
+    const size_t sizeInBytes = size_t(vertexCount) * kVertexSourceFloats * sizeof(float);
+    if (sizeInBytes == 0)
+        return false;
+    float* dst = (float*)AcquireStagingBuffer(sizeInBytes, recordingState);
+    if (!dst)
+        return false;
+    if (!CreateVulkanBuffer(sizeInBytes, &m_VertexSourceBuffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+    {
+        m_VertexSourceBuffer = VulkanBuffer();
+        return false;
+    }
+
+    const float* x = source.GetX();
+    const float* y = source.GetY();
+    const float* z = source.GetZ();
+    const float* normals = source.GetNormals();
+    const float* uvs = source.GetUVs();
+    for (int i = 0; i < vertexCount; ++i, dst += kVertexSourceFloats)
+    {
+        dst[0] = x[i];
+        dst[1] = y[i];
+        dst[2] = z[i];
+        dst[3] = normals[i * 3 + 0];
+        dst[4] = normals[i * 3 + 1];
+        dst[5] = normals[i * 3 + 2];
+        dst[6] = uvs[i * 2 + 0];
+        dst[7] = uvs[i * 2 + 1];
+    }
+
+    const StagingBuffer* staging = FindStagingBuffer(dst - vertexCount * kVertexSourceFloats);
+    FlushVulkanBuffer(staging->buffer, 0, sizeInBytes);
+    m_VertexSourceStaging = staging->buffer.buffer;
+    m_VertexSourceCount = vertexCount;
+    return true;
+}
+
+// Compute work: a later dispatch for the same resource replaces an earlier one still pending
+void RenderAPI_Vulkan::QueueDispatch(const PendingDispatch& dispatch, unsigned long long frameNumber)
+{
+    // Work of an earlier frame that nobody flushed (event 3 not issued) is recorded now
+    if ((!m_PendingUploads.empty() || !m_PendingDispatches.empty()) && m_PendingUploadFrame != frameNumber)
+        FlushUploads();
+    m_PendingUploadFrame = frameNumber;
+
+    for (size_t i = 0; i < m_PendingDispatches.size(); ++i)
+    {
+        if (m_PendingDispatches[i].handle == dispatch.handle)
+        {
+            m_PendingDispatches[i] = dispatch;
+            return;
+        }
+    }
+    m_PendingDispatches.push_back(dispatch);
+}
+
+// Whole resource uploads: a later one of the same resource replaces an earlier one still pending
+void RenderAPI_Vulkan::QueueUpload(const PendingUpload& upload, unsigned long long frameNumber)
+{
+    if ((!m_PendingUploads.empty() || !m_PendingDispatches.empty()) && m_PendingUploadFrame != frameNumber)
+        FlushUploads();
+    m_PendingUploadFrame = frameNumber;
+    AddPendingUpload(upload);
+}
+
+// An upload from the CPU and one done on the transfer queue (older data) can both be pending for a
+// resource; FlushUploads sorts that out
+void RenderAPI_Vulkan::AddPendingUpload(const PendingUpload& upload)
+{
+    for (size_t i = 0; i < m_PendingUploads.size(); ++i)
+    {
+        if (m_PendingUploads[i].handle == upload.handle && m_PendingUploads[i].fromTransferQueue == upload.fromTransferQueue)
+        {
+            m_PendingUploads[i] = upload;
+            return;
+        }
+    }
+    m_PendingUploads.push_back(upload);
+}
+
+// Uploads at least this big are copied to device local memory on the transfer queue first, when
+// there is one. Smaller ones are not worth the frame or two of extra latency.
+static const VkDeviceSize kAsyncUploadMinSize = 1024 * 1024;
+
+// Sets up the transfer queue Hook_vkCreateDevice added to Unity's device, if it did
+bool RenderAPI_Vulkan::InitTransferQueue()
+{
+    if (s_TransferQueueDevice != m_Instance.device || s_TransferQueueFamily == VK_QUEUE_FAMILY_IGNORED || !vkGetSemaphoreCounterValue)
+        return false;
+
+    m_TransferQueueFamily = s_TransferQueueFamily;
+    vkGetDeviceQueue(m_Instance.device, m_TransferQueueFamily, 0, &m_TransferQueue);
+
+    VkCommandPoolCreateInfo poolCreateInfo;
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolCreateInfo.pNext = NULL;
+    poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolCreateInfo.queueFamilyIndex = m_TransferQueueFamily;
+
+    VkCommandBufferAllocateInfo allocateInfo;
+    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.pNext = NULL;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = kTransferCommandBuffers;
+
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo;
+    semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    semaphoreTypeCreateInfo.pNext = NULL;
+    semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeCreateInfo.initialValue = 0;
+    VkSemaphoreCreateInfo semaphoreCreateInfo;
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+    semaphoreCreateInfo.flags = 0;
+
+    if (m_TransferQueue == VK_NULL_HANDLE
+        || vkCreateCommandPool(m_Instance.device, &poolCreateInfo, NULL, &m_TransferCommandPool) != VK_SUCCESS
+        || (allocateInfo.commandPool = m_TransferCommandPool, vkAllocateCommandBuffers(m_Instance.device, &allocateInfo, m_TransferCommandBuffers) != VK_SUCCESS)
+        || vkCreateSemaphore(m_Instance.device, &semaphoreCreateInfo, NULL, &m_TransferTimeline) != VK_SUCCESS)
+    {
+        ShutdownTransferQueue();
+        return false;
+    }
+    return true;
+}
+
+void RenderAPI_Vulkan::ShutdownTransferQueue()
+{
+    if (m_TransferQueue != VK_NULL_HANDLE)
+        vkQueueWaitIdle(m_TransferQueue);
+    m_AsyncUploads.clear(); // their buffers are still in the pools, which are destroyed after this
+    if (m_TransferTimeline != VK_NULL_HANDLE)
+        vkDestroySemaphore(m_Instance.device, m_TransferTimeline, NULL);
+    if (m_TransferCommandPool != VK_NULL_HANDLE)
+        vkDestroyCommandPool(m_Instance.device, m_TransferCommandPool, NULL); // frees the command buffers too
+    for (int i = 0; i < kTransferCommandBuffers; ++i)
+    {
+        m_TransferCommandBuffers[i] = VK_NULL_HANDLE;
+        m_TransferCommandBufferValues[i] = 0;
+    }
+    m_TransferTimeline = VK_NULL_HANDLE;
+    m_TransferTimelineValue = 0;
+    m_TransferCommandPool = VK_NULL_HANDLE;
+    m_TransferQueue = VK_NULL_HANDLE;
+    m_TransferQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+    m_NextTransferCommandBuffer = 0;
+}
+
+// Turns the transfer queue copies that are done into pending uploads from their device local buffers.
+// The CPU seeing the timeline value orders the graphics queue's acquire after the transfer queue's
+// release, so Unity's command buffer does not have to wait on the semaphore.
+void RenderAPI_Vulkan::CollectAsyncUploads(const UnityVulkanRecordingState& recordingState)
+{
+    if (m_AsyncUploads.empty())
+        return;
+
+    uint64_t completedValue = 0;
+    if (vkGetSemaphoreCounterValue(m_Instance.device, m_TransferTimeline, &completedValue) != VK_SUCCESS)
+        return;
+
+    size_t doneCount = 0;
+    while (doneCount < m_AsyncUploads.size() && m_AsyncUploads[doneCount].timelineValue <= completedValue)
+    {
+        const AsyncUpload& async = m_AsyncUploads[doneCount++];
+        if (StagingBuffer* hostBuffer = FindPooledBuffer(m_StagingPool, async.hostBuffer))
+            hostBuffer->lastUsedFrame = recordingState.safeFrameNumber;
+        // Recorded this frame, or dropped if newer contents are recorded instead
+        if (StagingBuffer* deviceBuffer = FindPooledBuffer(m_TransferPool, async.deviceBuffer))
+            deviceBuffer->lastUsedFrame = recordingState.currentFrameNumber;
+        if (async.superseded)
+            continue;
+
+        PendingUpload upload = async.upload;
+        upload.stagingBuffer = async.deviceBuffer;
+        upload.fromTransferQueue = true;
+        if (m_PendingUploads.empty())
+            m_PendingUploadFrame = recordingState.currentFrameNumber;
+        AddPendingUpload(upload);
+    }
+    m_AsyncUploads.erase(m_AsyncUploads.begin(), m_AsyncUploads.begin() + doneCount);
+}
+
+// Moves the big pending uploads to the transfer queue: copied to device local buffers there, which
+// are then released to the graphics queue family. Leaves them pending if no command buffer is free.
+void RenderAPI_Vulkan::SubmitAsyncUploads(const UnityVulkanRecordingState& recordingState)
+{
+    uint64_t completedValue = 0;
+    const int slot = m_NextTransferCommandBuffer;
+    if (vkGetSemaphoreCounterValue(m_Instance.device, m_TransferTimeline, &completedValue) != VK_SUCCESS
+        || m_TransferCommandBufferValues[slot] > completedValue)
+        return;
+
+    PROFILE_SCOPE("RenderAPI_Vulkan::SubmitAsyncUploads");
+    const VkCommandBuffer commandBuffer = m_TransferCommandBuffers[slot];
+    const uint64_t timelineValue = m_TransferTimelineValue + 1;
+    m_UploadBufferBarriers.clear();
+
+    std::vector<PendingUpload>::iterator it = m_PendingUploads.begin();
+    while (it != m_PendingUploads.end())
+    {
+        StagingBuffer* deviceBuffer = NULL;
+        if (!it->fromTransferQueue && it->sizeInBytes >= kAsyncUploadMinSize)
+            deviceBuffer = AcquirePooledBuffer(m_TransferPool, static_cast<size_t>(it->sizeInBytes), recordingState);
+        if (!deviceBuffer)
+        {
+            ++it;
+            continue;
+        }
+
+        if (m_UploadBufferBarriers.empty())
+        {
+            VkCommandBufferBeginInfo beginInfo;
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.pNext = NULL;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            beginInfo.pInheritanceInfo = NULL;
+            vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        }
+
+        // The device buffer's old contents are not needed, so the transfer queue can use it without
+        // the graphics queue releasing it first
+        VkBufferCopy region;
+        region.srcOffset = 0;
+        region.dstOffset = 0;
+        region.size = it->sizeInBytes;
+        vkCmdCopyBuffer(commandBuffer, it->stagingBuffer, deviceBuffer->buffer.buffer, 1, &region);
+
+        VkBufferMemoryBarrier release;
+        release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        release.pNext = NULL;
+        release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        release.dstAccessMask = 0;
+        release.srcQueueFamilyIndex = m_TransferQueueFamily;
+        release.dstQueueFamilyIndex = m_Instance.queueFamilyIndex;
+        release.buffer = deviceBuffer->buffer.buffer;
+        release.offset = 0;
+        release.size = it->sizeInBytes;
+        m_UploadBufferBarriers.push_back(release);
+
+        AsyncUpload async;
+        async.upload = *it;
+        async.hostBuffer = it->stagingBuffer;
+        async.deviceBuffer = deviceBuffer->buffer.buffer;
+        async.timelineValue = timelineValue;
+        async.superseded = false;
+        m_AsyncUploads.push_back(async);
+        deviceBuffer->lastUsedFrame = kStagingOnTransferQueue;
+        if (StagingBuffer* hostBuffer = FindPooledBuffer(m_StagingPool, it->stagingBuffer))
+            hostBuffer->lastUsedFrame = kStagingOnTransferQueue;
+        it = m_PendingUploads.erase(it);
+    }
+
+    if (m_UploadBufferBarriers.empty())
+        return;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+        0, NULL, (uint32_t)m_UploadBufferBarriers.size(), &m_UploadBufferBarriers[0], 0, NULL);
+    vkEndCommandBuffer(commandBuffer);
+
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo;
+    timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineSubmitInfo.pNext = NULL;
+    timelineSubmitInfo.waitSemaphoreValueCount = 0;
+    timelineSubmitInfo.pWaitSemaphoreValues = NULL;
+    timelineSubmitInfo.signalSemaphoreValueCount = 1;
+    timelineSubmitInfo.pSignalSemaphoreValues = &timelineValue;
+
+    VkSubmitInfo submitInfo;
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineSubmitInfo;
+    submitInfo.waitSemaphoreCount = 0;
+    submitInfo.pWaitSemaphores = NULL;
+    submitInfo.pWaitDstStageMask = NULL;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &m_TransferTimeline;
+
+    if (vkQueueSubmit(m_TransferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+    {
+        // Nothing was submitted: back to the graphics queue path, the device buffers are free again
+        while (!m_AsyncUploads.empty() && m_AsyncUploads.back().timelineValue == timelineValue)
+        {
+            const AsyncUpload& async = m_AsyncUploads.back();
+            FindPooledBuffer(m_TransferPool, async.deviceBuffer)->lastUsedFrame = recordingState.safeFrameNumber;
+            FindPooledBuffer(m_StagingPool, async.hostBuffer)->lastUsedFrame = recordingState.currentFrameNumber;
+            AddPendingUpload(async.upload);
+            m_AsyncUploads.pop_back();
+        }
+        return;
+    }
+
+    m_TransferTimelineValue = timelineValue;
+    m_TransferCommandBufferValues[slot] = timelineValue;
+    m_NextTransferCommandBuffer = (slot + 1) % kTransferCommandBuffers;
+}
+
+// Records all pending uploads with one barrier batch before the copies and one after. The layouts
+// and accesses Unity tracks for the resources are left as they were, so its own barriers stay right.
+void RenderAPI_Vulkan::FlushUploads()
+{
+    UnityVulkanRecordingState recordingState;
+    if (!m_UnityVulkan->CommandRecordingState(&recordingState, kUnityVulkanGraphicsQueueAccess_DontCare))
+        return;
+
+    if (m_TransferQueue != VK_NULL_HANDLE)
+    {
+        CollectAsyncUploads(recordingState);
+        SubmitAsyncUploads(recordingState);
+    }
+    if (m_PendingUploads.empty() && m_PendingDispatches.empty())
+        return;
+    PROFILE_SCOPE("RenderAPI_Vulkan::FlushUploads");
+
+    // Contents from the CPU recorded here are newer than any from the transfer queue, done or not
+    for (size_t i = 0; i < m_PendingUploads.size(); ++i)
+    {
+        if (m_PendingUploads[i].fromTransferQueue)
+            continue;
+        for (size_t j = 0; j < m_AsyncUploads.size(); ++j)
+        {
+            if (m_AsyncUploads[j].upload.handle == m_PendingUploads[i].handle)
+                m_AsyncUploads[j].superseded = true;
+        }
+        for (size_t j = 0; j < m_PendingUploads.size(); ++j)
+        {
+            if (m_PendingUploads[j].fromTransferQueue && m_PendingUploads[j].handle == m_PendingUploads[i].handle)
+            {
+                m_PendingUploads.erase(m_PendingUploads.begin() + j);
+                i -= i > j ? 1 : 0;
+                break;
+            }
+        }
+    }
+
+    // The staging buffers are read by this frame's commands now
+    for (size_t i = 0; i < m_PendingUploads.size(); ++i)
+    {
+        if (StagingBuffer* staging = FindPooledBuffer(m_StagingPool, m_PendingUploads[i].stagingBuffer))
+            staging->lastUsedFrame = recordingState.currentFrameNumber;
+    }
+
+    // No-op when called for event 3, which runs outside of render passes already
+    m_UnityVulkan->EnsureOutsideRenderPass();
+    if (!m_UnityVulkan->CommandRecordingState(&recordingState, kUnityVulkanGraphicsQueueAccess_DontCare))
+    {
+        m_PendingUploads.clear();
+        m_PendingDispatches.clear();
+        return;
+    }
+
+    // Look up the destinations. Images Unity has not given a layout yet (never written) go through
+    // Unity's own barrier instead, since they could not be transitioned back to an undefined layout.
+    m_UploadImageBarriers.clear();
+    m_UploadBufferBarriers.clear();
+    std::vector<PendingUpload>::iterator it = m_PendingUploads.begin();
+    while (it != m_PendingUploads.end())
+    {
+        bool valid = false;
+        if (it->isTexture)
+        {
+            UnityVulkanImage image;
+            if (m_UnityVulkan->AccessTexture(it->handle, UnityVulkanWholeImage, VK_IMAGE_LAYOUT_UNDEFINED, 0, 0, kUnityVulkanResourceAccess_ObserveOnly, &image))
+            {
+                valid = true;
+                if (image.layout == VK_IMAGE_LAYOUT_UNDEFINED || image.layout == VK_IMAGE_LAYOUT_PREINITIALIZED)
+                {
+                    valid = m_UnityVulkan->AccessTexture(it->handle, UnityVulkanWholeImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, kUnityVulkanResourceAccess_PipelineBarrier, &image);
+                    image.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                }
+                VkImageMemoryBarrier barrier;
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.pNext = NULL;
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.oldLayout = image.layout;
+                barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.image = image.image;
+                barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                barrier.subresourceRange.baseMipLevel = 0;
+                barrier.subresourceRange.levelCount = 1;
+                barrier.subresourceRange.baseArrayLayer = 0;
+                barrier.subresourceRange.layerCount = 1;
+                if (valid)
+                    m_UploadImageBarriers.push_back(barrier);
+            }
+        }
+        else
+        {
+            UnityVulkanBuffer buffer;
+            if (m_UnityVulkan->AccessBuffer(it->handle, 0, 0, kUnityVulkanResourceAccess_ObserveOnly, &buffer))
+            {
+                VkBufferMemoryBarrier barrier;
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.pNext = NULL;
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.buffer = buffer.buffer;
+                barrier.offset = 0;
+                barrier.size = it->sizeInBytes;
+                m_UploadBufferBarriers.push_back(barrier);
+                valid = true;
+            }
+        }
+        if (valid)
+            ++it;
+        else
+            it = m_PendingUploads.erase(it);
+    }
+
+    // Copies from the transfer queue: acquire its buffers for the graphics queue family (the other half of
+    // the release in SubmitAsyncUploads)
+    const size_t destinationBufferCount = m_UploadBufferBarriers.size();
+    for (size_t i = 0; i < m_PendingUploads.size(); ++i)
+    {
+        if (!m_PendingUploads[i].fromTransferQueue)
+            continue;
+        VkBufferMemoryBarrier acquire;
+        acquire.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        acquire.pNext = NULL;
+        acquire.srcAccessMask = 0;
+        acquire.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        acquire.srcQueueFamilyIndex = m_TransferQueueFamily;
+        acquire.dstQueueFamilyIndex = m_Instance.queueFamilyIndex;
+        acquire.buffer = m_PendingUploads[i].stagingBuffer;
+        acquire.offset = 0;
+        acquire.size = m_PendingUploads[i].sizeInBytes;
+        m_UploadBufferBarriers.push_back(acquire);
+    }
+
+    // Before: wait for earlier reads (write after read; the old contents are not needed), and move the
+    // images to the transfer layout
+    if (!m_UploadImageBarriers.empty() || !m_UploadBufferBarriers.empty())
+    {
+        vkCmdPipelineBarrier(recordingState.commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, NULL, (uint32_t)m_UploadBufferBarriers.size(), m_UploadBufferBarriers.empty() ? NULL : &m_UploadBufferBarriers[0],
+            (uint32_t)m_UploadImageBarriers.size(), m_UploadImageBarriers.empty() ? NULL : &m_UploadImageBarriers[0]);
+    }
+
+    // Barriers were added in the order of m_PendingUploads, for textures and buffers separately
+    size_t imageIndex = 0, bufferIndex = 0;
+    for (size_t i = 0; i < m_PendingUploads.size(); ++i)
+    {
+        const PendingUpload& upload = m_PendingUploads[i];
+        if (upload.isTexture)
+        {
+            VkBufferImageCopy region;
+            region.bufferImageHeight = 0;
+            region.bufferRowLength = 0;
+            region.bufferOffset = 0;
+            region.imageOffset.x = 0;
+            region.imageOffset.y = 0;
+            region.imageOffset.z = 0;
+            region.imageExtent.width = upload.width;
+            region.imageExtent.height = upload.height;
+            region.imageExtent.depth = 1;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageSubresource.mipLevel = 0;
+            vkCmdCopyBufferToImage(recordingState.commandBuffer, upload.stagingBuffer, m_UploadImageBarriers[imageIndex++].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        }
+        else
+        {
+            VkBufferCopy region;
+            region.srcOffset = 0;
+            region.dstOffset = 0;
+            region.size = upload.sizeInBytes;
+            vkCmdCopyBuffer(recordingState.commandBuffer, upload.stagingBuffer, m_UploadBufferBarriers[bufferIndex++].buffer, 1, &region);
+        }
+    }
+
+    // After: back to the layouts Unity tracks, with the writes visible to whatever reads next
+    m_UploadBufferBarriers.resize(destinationBufferCount);
+    for (size_t i = 0; i < m_UploadImageBarriers.size(); ++i)
+    {
+        VkImageMemoryBarrier& barrier = m_UploadImageBarriers[i];
+        barrier.newLayout = barrier.oldLayout;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    }
+    for (size_t i = 0; i < m_UploadBufferBarriers.size(); ++i)
+    {
+        m_UploadBufferBarriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        m_UploadBufferBarriers[i].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    }
+    if (!m_UploadImageBarriers.empty() || !m_UploadBufferBarriers.empty())
+    {
+        vkCmdPipelineBarrier(recordingState.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+            0, NULL, (uint32_t)m_UploadBufferBarriers.size(), m_UploadBufferBarriers.empty() ? NULL : &m_UploadBufferBarriers[0],
+            (uint32_t)m_UploadImageBarriers.size(), m_UploadImageBarriers.empty() ? NULL : &m_UploadImageBarriers[0]);
+    }
+
+    m_PendingUploads.clear();
+
+    // Compute work goes after the uploads, so that it wins when a texture got both this frame
+    RecordDispatches(recordingState);
+}
+
+// Push constants of the plasma compute shader
+struct PlasmaPushConstants
+{
+    int32_t width, height;
+    float t;
+    float padding;
+};
+
+// Push constants of the vertex wave compute shader
+struct VertexWavePushConstants
+{
+    uint32_t vertexCount;
+    float t;
+};
+
+// Descriptor sets the compute pool has room for; retired ones wait a few frames before they are freed
+static const uint32_t kComputeDescriptorSets = 16;
+
+// Creates the compute pipelines and the descriptor pool for their sets, the first time compute work is
+// queued. What could not be created stays VK_NULL_HANDLE, and that work stays on the CPU.
+void RenderAPI_Vulkan::InitCompute()
+{
+    if (m_ComputeInitialized)
+        return;
+    m_ComputeInitialized = true;
+    PROFILE_SCOPE("RenderAPI_Vulkan::InitCompute");
+
+    // Any set can take any of its descriptor types: at most one storage image, two storage buffers
+    VkDescriptorPoolSize poolSizes[2];
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[0].descriptorCount = kComputeDescriptorSets;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = kComputeDescriptorSets * 2;
+    VkDescriptorPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolCreateInfo.maxSets = kComputeDescriptorSets;
+    poolCreateInfo.poolSizeCount = 2;
+    poolCreateInfo.pPoolSizes = poolSizes;
+    if (vkCreateDescriptorPool(m_Instance.device, &poolCreateInfo, NULL, &m_ComputeDescriptorPool) != VK_SUCCESS)
+    {
+        m_ComputeDescriptorPool = VK_NULL_HANDLE;
+        return;
+    }
+
+    m_PlasmaSetLayout = CreateComputeSetLayout(m_Instance.device, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1);
+    m_PlasmaPipelineLayout = CreateComputePipelineLayout(m_Instance.device, m_PlasmaSetLayout, sizeof(PlasmaPushConstants));
+    m_PlasmaPipeline = CreateComputePipeline(m_Instance.device, m_PlasmaPipelineLayout,
+        Shader::plasmaComputeShaderSpirv, sizeof(Shader::plasmaComputeShaderSpirv), m_PipelineCache);
+
+    m_VertexWaveSetLayout = CreateComputeSetLayout(m_Instance.device, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2);
+    m_VertexWavePipelineLayout = CreateComputePipelineLayout(m_Instance.device, m_VertexWaveSetLayout, sizeof(VertexWavePushConstants));
+    m_VertexWavePipeline = CreateComputePipeline(m_Instance.device, m_VertexWavePipelineLayout,
+        Shader::vertexWaveComputeShaderSpirv, sizeof(Shader::vertexWaveComputeShaderSpirv), m_PipelineCache);
+}
+
+// After GarbageCollect(true), so that no retired descriptor set is left to free
+void RenderAPI_Vulkan::ShutdownCompute()
+{
+    for (int i = 0; i < m_StorageImageCount; ++i)
+    {
+        if (m_StorageImages[i].view != VK_NULL_HANDLE)
+            vkDestroyImageView(m_Instance.device, m_StorageImages[i].view, NULL);
+    }
+    m_StorageImageCount = 0;
+    memset(&m_VertexWaveBinding, 0, sizeof(m_VertexWaveBinding));
+    ImmediateDestroyVulkanBuffer(m_VertexSourceBuffer);
+    m_VertexSourceBuffer = VulkanBuffer();
+    m_VertexSourceCount = 0;
+    m_VertexSourceVersion = 0;
+    m_VertexSourceStaging = VK_NULL_HANDLE;
+
+    // Destroying the pool frees the sets allocated from it
+    if (m_ComputeDescriptorPool != VK_NULL_HANDLE)
+        vkDestroyDescriptorPool(m_Instance.device, m_ComputeDescriptorPool, NULL);
+    if (m_PlasmaPipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(m_Instance.device, m_PlasmaPipeline, NULL);
+    if (m_PlasmaPipelineLayout != VK_NULL_HANDLE)
+        vkDestroyPipelineLayout(m_Instance.device, m_PlasmaPipelineLayout, NULL);
+    if (m_PlasmaSetLayout != VK_NULL_HANDLE)
+        vkDestroyDescriptorSetLayout(m_Instance.device, m_PlasmaSetLayout, NULL);
+    if (m_VertexWavePipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(m_Instance.device, m_VertexWavePipeline, NULL);
+    if (m_VertexWavePipelineLayout != VK_NULL_HANDLE)
+        vkDestroyPipelineLayout(m_Instance.device, m_VertexWavePipelineLayout, NULL);
+    if (m_VertexWaveSetLayout != VK_NULL_HANDLE)
+        vkDestroyDescriptorSetLayout(m_Instance.device, m_VertexWaveSetLayout, NULL);
+    m_ComputeDescriptorPool = VK_NULL_HANDLE;
+    m_PlasmaPipeline = VK_NULL_HANDLE;
+    m_PlasmaPipelineLayout = VK_NULL_HANDLE;
+    m_PlasmaSetLayout = VK_NULL_HANDLE;
+    m_VertexWavePipeline = VK_NULL_HANDLE;
+    m_VertexWavePipelineLayout = VK_NULL_HANDLE;
+    m_VertexWaveSetLayout = VK_NULL_HANDLE;
+    m_ComputeInitialized = false;
+}
+
+// Descriptor set binding the image as the plasma shader's storage image. Returns VK_NULL_HANDLE if the
+// view or set could not be created; tried again the next time.
+VkDescriptorSet RenderAPI_Vulkan::GetStorageImageDescriptorSet(const UnityVulkanImage& image, unsigned long long frameNumber)
+{
+    int index = -1;
+    for (int i = 0; i < m_StorageImageCount && index < 0; ++i)
+    {
+        const StorageImageBinding& binding = m_StorageImages[i];
+        if (binding.image == image.image && binding.memory == image.memory.memory && binding.memoryOffset == image.memory.offset)
+            index = i;
+    }
+
+    if (index < 0)
+    {
+        if (m_StorageImageCount < kMaxStorageImageBindings)
+            index = m_StorageImageCount++;
+        else
+        {
+            // Replace the least recently used one; command buffers in flight may still use it
+            index = 0;
+            for (int i = 1; i < m_StorageImageCount; ++i)
+            {
+                if (m_StorageImages[i].lastUsedFrame < m_StorageImages[index].lastUsedFrame)
+                    index = i;
+            }
+            RetiredResources& retired = GetRetiredResources(frameNumber);
+            if (m_StorageImages[index].view != VK_NULL_HANDLE)
+                retired.imageViews.push_back(m_StorageImages[index].view);
+            if (m_StorageImages[index].descriptorSet != VK_NULL_HANDLE)
+                retired.descriptorSets.push_back(m_StorageImages[index].descriptorSet);
+        }
+
+        PROFILE_SCOPE("RenderAPI_Vulkan::CreateStorageImageBinding");
+        StorageImageBinding& binding = m_StorageImages[index];
+        binding.image = image.image;
+        binding.memory = image.memory.memory;
+        binding.memoryOffset = image.memory.offset;
+        binding.view = VK_NULL_HANDLE;
+        binding.descriptorSet = VK_NULL_HANDLE;
+
+        VkImageViewCreateInfo viewCreateInfo = {};
+        viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewCreateInfo.image = image.image;
+        viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewCreateInfo.format = image.format;
+        viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewCreateInfo.subresourceRange.baseMipLevel = 0;
+        viewCreateInfo.subresourceRange.levelCount = 1;
+        viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+        viewCreateInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(m_Instance.device, &viewCreateInfo, NULL, &binding.view) != VK_SUCCESS)
+            binding.view = VK_NULL_HANDLE;
+
+        if (binding.view != VK_NULL_HANDLE)
+        {
+            VkDescriptorSetAllocateInfo allocateInfo = {};
+            allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocateInfo.descriptorPool = m_ComputeDescriptorPool;
+            allocateInfo.descriptorSetCount = 1;
+            allocateInfo.pSetLayouts = &m_PlasmaSetLayout;
+            if (vkAllocateDescriptorSets(m_Instance.device, &allocateInfo, &binding.descriptorSet) != VK_SUCCESS)
+                binding.descriptorSet = VK_NULL_HANDLE;
+        }
+
+        if (binding.descriptorSet != VK_NULL_HANDLE)
+        {
+            VkDescriptorImageInfo imageInfo;
+            imageInfo.sampler = VK_NULL_HANDLE;
+            imageInfo.imageView = binding.view;
+            imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            VkWriteDescriptorSet write = {};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = binding.descriptorSet;
+            write.dstBinding = 0;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            write.pImageInfo = &imageInfo;
+            vkUpdateDescriptorSets(m_Instance.device, 1, &write, 0, NULL);
+        }
+        else
+        {
+            // Nothing uses the view yet; leave an unused slot behind, replaced first
+            if (binding.view != VK_NULL_HANDLE)
+                vkDestroyImageView(m_Instance.device, binding.view, NULL);
+            binding.view = VK_NULL_HANDLE;
+            binding.image = VK_NULL_HANDLE;
+            binding.lastUsedFrame = 0;
+            return VK_NULL_HANDLE;
+        }
+    }
+
+    m_StorageImages[index].lastUsedFrame = frameNumber;
+    return m_StorageImages[index].descriptorSet;
+}
+
+// Descriptor set binding m_VertexSourceBuffer and the vertex buffer for the vertex wave shader. Returns
+// VK_NULL_HANDLE if it could not be created; tried again the next time.
+VkDescriptorSet RenderAPI_Vulkan::GetVertexWaveDescriptorSet(const UnityVulkanBuffer& vertices, unsigned long long frameNumber)
+{
+    VertexWaveBinding& binding = m_VertexWaveBinding;
+    if (binding.descriptorSet != VK_NULL_HANDLE && binding.vertices == vertices.buffer
+        && binding.memory == vertices.memory.memory && binding.memoryOffset == vertices.memory.offset)
+        return binding.descriptorSet;
+
+    // A different vertex buffer; command buffers in flight may still use the old set
+    if (binding.descriptorSet != VK_NULL_HANDLE)
+        GetRetiredResources(frameNumber).descriptorSets.push_back(binding.descriptorSet);
+    memset(&binding, 0, sizeof(binding));
+
+    VkDescriptorSetAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = m_ComputeDescriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &m_VertexWaveSetLayout;
+    if (vkAllocateDescriptorSets(m_Instance.device, &allocateInfo, &binding.descriptorSet) != VK_SUCCESS)
+    {
+        binding.descriptorSet = VK_NULL_HANDLE;
+        return VK_NULL_HANDLE;
+    }
+    binding.vertices = vertices.buffer;
+    binding.memory = vertices.memory.memory;
+    binding.memoryOffset = vertices.memory.offset;
+
+    VkDescriptorBufferInfo bufferInfos[2];
+    bufferInfos[0].buffer = m_VertexSourceBuffer.buffer;
+    bufferInfos[0].offset = 0;
+    bufferInfos[0].range = VK_WHOLE_SIZE;
+    bufferInfos[1].buffer = vertices.buffer;
+    bufferInfos[1].offset = 0;
+    bufferInfos[1].range = VK_WHOLE_SIZE;
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = binding.descriptorSet;
+    write.dstBinding = 0;
+    write.descriptorCount = 2;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = bufferInfos;
+    vkUpdateDescriptorSets(m_Instance.device, 1, &write, 0, NULL);
+    return binding.descriptorSet;
+}
+
+// Records the compute work GenerateTexture and DeformVertexBuffer queued; outside of render passes
+void RenderAPI_Vulkan::RecordDispatches(const UnityVulkanRecordingState& recordingState)
+{
+    if (m_PendingDispatches.empty())
+        return;
+    PROFILE_SCOPE("RenderAPI_Vulkan::RecordDispatches");
+
+    // A new source mesh: copy it to the device local buffer first
+    if (m_VertexSourceStaging != VK_NULL_HANDLE)
+    {
+        if (StagingBuffer* staging = FindPooledBuffer(m_StagingPool, m_VertexSourceStaging))
+            staging->lastUsedFrame = recordingState.currentFrameNumber;
+        VkBufferCopy region;
+        region.srcOffset = 0;
+        region.dstOffset = 0;
+        region.size = m_VertexSourceBuffer.sizeInBytes;
+        vkCmdCopyBuffer(recordingState.commandBuffer, m_VertexSourceStaging, m_VertexSourceBuffer.buffer, 1, &region);
+
+        VkBufferMemoryBarrier barrier;
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.pNext = NULL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = m_VertexSourceBuffer.buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(recordingState.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+            0, NULL, 1, &barrier, 0, NULL);
+        m_VertexSourceStaging = VK_NULL_HANDLE;
+    }
+
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    bool wroteVertices = false;
+    for (size_t i = 0; i < m_PendingDispatches.size(); ++i)
+    {
+        const PendingDispatch& dispatch = m_PendingDispatches[i];
+        if (dispatch.isTexture)
+        {
+            // Unity records the barrier from whatever used the image last, and then knows that the shader
+            // wrote it in the general layout, for whatever reads it next
+            UnityVulkanImage image;
+            if (!m_UnityVulkan->AccessTexture(dispatch.handle, UnityVulkanWholeImage, VK_IMAGE_LAYOUT_GENERAL,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, kUnityVulkanResourceAccess_PipelineBarrier, &image))
+                continue;
+            const VkDescriptorSet descriptorSet = GetStorageImageDescriptorSet(image, recordingState.currentFrameNumber);
+            if (descriptorSet == VK_NULL_HANDLE)
+                continue;
+
+            if (boundPipeline != m_PlasmaPipeline)
+            {
+                vkCmdBindPipeline(recordingState.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PlasmaPipeline);
+                boundPipeline = m_PlasmaPipeline;
+            }
+            PlasmaPushConstants constants;
+            constants.width = dispatch.width;
+            constants.height = dispatch.height;
+            constants.t = dispatch.t;
+            constants.padding = 0.0f;
+            vkCmdBindDescriptorSets(recordingState.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PlasmaPipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+            vkCmdPushConstants(recordingState.commandBuffer, m_PlasmaPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+            // 8x8 threads per group
+            vkCmdDispatch(recordingState.commandBuffer, (dispatch.width + 7) / 8, (dispatch.height + 7) / 8, 1);
+        }
+        else
+        {
+            // Same for the vertex buffer: the barrier from earlier draws reading it (write after read)
+            const int vertexCount = dispatch.vertexCount < m_VertexSourceCount ? dispatch.vertexCount : m_VertexSourceCount;
+            UnityVulkanBuffer buffer;
+            if (vertexCount <= 0 || !m_UnityVulkan->AccessBuffer(dispatch.handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                kUnityVulkanResourceAccess_PipelineBarrier, &buffer))
+                continue;
+            const VkDescriptorSet descriptorSet = GetVertexWaveDescriptorSet(buffer, recordingState.currentFrameNumber);
+            if (descriptorSet == VK_NULL_HANDLE)
+                continue;
+
+            if (boundPipeline != m_VertexWavePipeline)
+            {
+                vkCmdBindPipeline(recordingState.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_VertexWavePipeline);
+                boundPipeline = m_VertexWavePipeline;
+            }
+            VertexWavePushConstants constants;
+            constants.vertexCount = vertexCount;
+            constants.t = dispatch.t;
+            vkCmdBindDescriptorSets(recordingState.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_VertexWavePipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+            vkCmdPushConstants(recordingState.commandBuffer, m_VertexWavePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+            // 64 threads per group
+            vkCmdDispatch(recordingState.commandBuffer, (vertexCount + 63) / 64, 1, 1);
+            wroteVertices = true;
+        }
+    }
+
+    // The vertices are read by draws later in the frame
+    if (wroteVertices)
+    {
+        VkMemoryBarrier barrier;
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext = NULL;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+        vkCmdPipelineBarrier(recordingState.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+            1, &barrier, 0, NULL, 0, NULL);
+    }
+    m_PendingDispatches.clear();
+}
+
 #endif // #if SUPPORT_VULKAN
@@ -2,9 +2,20 @@
 
 #include "PlatformBase.h"
 #include "RenderAPI.h"
+#include "PlasmaKernel.h"
+#include "PluginProfiling.h"
+#include "PluginThreadPool.h"
+#include "TextureProducer.h"
+#include "VertexKernel.h"
 
 #include <assert.h>
 #include <math.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
 #include <vector>
 
 
@@ -35,20 +46,117 @@ extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetTextureFromUnity(v
 }
 
 
+// --------------------------------------------------------------------------
+// SetTextureRingDepthFromUnity / GetTextureFramesBehind, example functions we export which can be
+// called by scripts.
+// With a ring depth of 2 or more, worker threads generate the texture into that many CPU side buffers
+// ahead of time, and the render event only uploads the newest one (see TextureProducer.h). This takes
+// most of the work off the render thread, but the texture shows an older frame; GetTextureFramesBehind
+// tells by how many frames. 0 (the default) generates the texture in the render event.
+
+static int g_TextureRingDepth = 0;
+static int g_TextureFramesBehind = 0;
+#if SUPPORT_THREADS
+static TextureProducer* s_TextureProducer = NULL;
+#endif
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetTextureRingDepthFromUnity(int ringDepth)
+{
+	g_TextureRingDepth = ringDepth;
+}
+
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetTextureFramesBehind()
+{
+	return g_TextureFramesBehind;
+}
+
+
+// --------------------------------------------------------------------------
+// SetPluginComputeMode, an example function we export which can be called by scripts.
+// Selects per frame work the GPU does itself with compute shaders, on APIs that support it (Vulkan),
+// instead of the CPU writing the results and uploading them. A combination of PluginComputeFlags;
+// 0 (the default) does everything on the CPU. Work the API or resource does not support stays on the CPU.
+
+enum PluginComputeFlags
+{
+	kPluginComputeTexture = 1 << 0, // plasma texture; it must have been created for random write access
+	kPluginComputeVertices = 1 << 1, // vertex wave; the vertex buffer must be usable as a raw (storage) buffer
+};
+
+static int g_ComputeMode = 0;
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetPluginComputeMode(int mode)
+{
+	g_ComputeMode = mode;
+}
+
+
+// --------------------------------------------------------------------------
+// SetWorkerThreadCountFromUnity, an example function we export which can be called by scripts.
+// The plugin splits CPU heavy work (filling the texture) across this many threads, including
+// the render thread. 0 (the default) means one per CPU core; 1 means only use the render thread.
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetWorkerThreadCountFromUnity(int threadCount)
+{
+	SetWorkerThreadCount(threadCount);
+}
+
+
+// --------------------------------------------------------------------------
+// SetPluginTimingEnabled / GetPluginTimingStats / ResetPluginTimingStats / GetPluginTimingStageName, example
+// functions we export which can be called by scripts.
+// While enabled, the plugin times each stage of the render event and each RenderAPI call
+// (see PluginProfiling.h); GetPluginTimingStats copies out the counts, times and histograms
+// of every stage, GetPluginTimingStageName gives the name of a stage.
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetPluginTimingEnabled(int enabled)
+{
+	EnablePluginTiming(enabled != 0);
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetPluginTimingStats(PluginTimingStats* outStats)
+{
+	if (outStats)
+		CollectPluginTimingStats(outStats);
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ResetPluginTimingStats()
+{
+	ClearPluginTimingStats();
+}
+
+extern "C" UNITY_INTERFACE_EXPORT const char* UNITY_INTERFACE_API GetPluginTimingStageName(int stage)
+{
+	return GetPluginStageName(stage);
+}
+
+
+// --------------------------------------------------------------------------
+// SetPluginTracingEnabled / WritePluginTrace, example functions we export which can be called by scripts.
+// While enabled, the plugin records an event for each render event, RenderAPI call and some work
+// inside the backends, keeping the most recent ones per thread (see PluginProfiling.h).
+// WritePluginTrace writes the events recorded since the last call to a Chrome trace event JSON
+// file, for chrome://tracing or https://ui.perfetto.dev; returns 0 if the file could not be written.
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetPluginTracingEnabled(int enabled)
+{
+	EnablePluginTracing(enabled != 0);
+}
+
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API WritePluginTrace(const char* path)
+{
+	return path && WritePluginTraceFile(path) ? 1 : 0;
+}
+
+
 // --------------------------------------------------------------------------
 // SetMeshBuffersFromUnity, an example function we export which is called by one of the scripts.
 
 static void* g_VertexBufferHandle = NULL;
 static int g_VertexBufferVertexCount;
 
-struct MeshVertex
-{
-	float pos[3];
-	float normal[3];
-	float color[4];
-	float uv[2];
-};
-static std::vector<MeshVertex> g_VertexSource;
+static MeshSource g_VertexSource;
+static std::atomic<unsigned int> g_VertexSourceVersion(0); // bumped each time g_VertexSource is set
 
 
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetMeshBuffersFromUnity(void* vertexBufferHandle, int vertexCount, float* sourceVertices, float* sourceNormals, float* sourceUV)
@@ -63,22 +171,9 @@ extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetMeshBuffersFromUni
 	// will be marked as "dynamic", and on many platforms this means we can only write into it, but not read its previous
 	// contents. In this example we're not creating meshes from scratch, but are just altering original mesh data --
 	// so remember it. The script just passes pointers to regular C# array contents.
-	g_VertexSource.resize(vertexCount);
-	for (int i = 0; i < vertexCount; ++i)
-	{
-		MeshVertex& v = g_VertexSource[i];
-		v.pos[0] = sourceVertices[0];
-		v.pos[1] = sourceVertices[1];
-		v.pos[2] = sourceVertices[2];
-		v.normal[0] = sourceNormals[0];
-		v.normal[1] = sourceNormals[1];
-		v.normal[2] = sourceNormals[2];
-		v.uv[0] = sourceUV[0];
-		v.uv[1] = sourceUV[1];
-		sourceVertices += 3;
-		sourceNormals += 3;
-		sourceUV += 2;
-	}
+	// It is kept as separate streams (see MeshSource in VertexKernel.h), which is what the per frame code reads best.
+	g_VertexSource.Set(vertexCount, sourceVertices, sourceNormals, sourceUV);
+	++g_VertexSourceVersion;
 }
 
 
@@ -108,9 +203,27 @@ extern "C" void	UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginLoad(IUnit
 	OnGraphicsDeviceEvent(kUnityGfxDeviceEventInitialize);
 }
 
+// Has Vulkan create the device with an extra transfer-only queue (and timeline semaphores) for the
+// plugin's uploads. Off by default; it only has an effect when called before the device is created,
+// i.e. by the host application or another native plugin, not by scripts.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetPluginVulkanTransferQueue(int enabled)
+{
+#if SUPPORT_VULKAN
+	extern void RenderAPI_Vulkan_SetTransferQueueEnabled(bool);
+	RenderAPI_Vulkan_SetTransferQueueEnabled(enabled != 0);
+#endif // SUPPORT_VULKAN
+}
+
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginUnload()
 {
 	s_Graphics->UnregisterDeviceEventCallback(OnGraphicsDeviceEvent);
+
+	// Don't leave threads running inside a library that is about to be unloaded
+#if SUPPORT_THREADS
+	delete s_TextureProducer;
+	s_TextureProducer = NULL;
+#endif
+	ShutdownWorkerThreads();
 }
 
 #if UNITY_WEBGL
@@ -132,20 +245,47 @@ extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API RegisterPlugin()
 static RenderAPI* s_CurrentAPI = NULL;
 static UnityGfxRenderer s_DeviceType = kUnityGfxRendererNull;
 
+// The software implementation writes through whatever it gets as native texture / buffer / render buffer
+// handles, so it is only used for the "null" device when the host asked for it and passes
+// SoftwareTexture / SoftwareBuffer pointers (see RenderAPI_Software.h). Unity itself does not; a player
+// or editor running with -nographics gets no implementation, and the plugin does nothing.
+static bool g_SoftwareRendering = false;
+
+// Has to be called before UnityPluginLoad
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetPluginSoftwareRendering(int enabled)
+{
+	g_SoftwareRendering = enabled != 0;
+}
+
+static void ApplyCacheDirectory(bool newAPI);
+
 
 static void UNITY_INTERFACE_API OnGraphicsDeviceEvent(UnityGfxDeviceEventType eventType)
 {
 	// Create graphics API implementation upon initialization
 	if (eventType == kUnityGfxDeviceEventInitialize)
 	{
+		// UnityPluginLoad runs the initialize event before the real graphics device might exist
+		// (e.g. when intercepting Vulkan initialization), which may create the software implementation
+		// for the "null" device. Replace it when the actual device comes up.
+		if (s_CurrentAPI != NULL && s_DeviceType == kUnityGfxRendererNull)
+		{
+			s_CurrentAPI->ProcessDeviceEvent(kUnityGfxDeviceEventShutdown, s_UnityInterfaces);
+			delete s_CurrentAPI;
+			s_CurrentAPI = NULL;
+		}
 		assert(s_CurrentAPI == NULL);
 		s_DeviceType = s_Graphics->GetRenderer();
-		s_CurrentAPI = CreateRenderAPI(s_DeviceType);
+		if (s_DeviceType != kUnityGfxRendererNull || g_SoftwareRendering)
+			s_CurrentAPI = CreateRenderAPI(s_DeviceType);
+		if (s_CurrentAPI)
+			ApplyCacheDirectory(true);
 	}
 
 	// Let the implementation process the device related events
 	if (s_CurrentAPI)
 	{
+		PROFILE_STAGE(kPluginStageApiProcessDeviceEvent);
 		s_CurrentAPI->ProcessDeviceEvent(eventType, s_UnityInterfaces);
 	}
 
@@ -159,6 +299,79 @@ static void UNITY_INTERFACE_API OnGraphicsDeviceEvent(UnityGfxDeviceEventType ev
 }
 
 
+// --------------------------------------------------------------------------
+// SetPluginCacheDirectory / SavePluginCaches, example functions we export which can be called by scripts.
+// Graphics APIs that support it keep compiled pipelines or programs in files in this directory (e.g.
+// Application.temporaryCachePath), so later runs do not have to compile them again. The caches are
+// read when the directory is set (on the next render event, or when the device is initialized) and
+// written at shutdown. To write them earlier, a script issues render event 4, which saves them on the
+// render thread, and then calls SavePluginCaches: it waits for that event and returns 0 if the caches
+// could not be written (or the event did not run within kSaveCachesTimeoutMs).
+
+static std::mutex g_CacheMutex; // guards g_CacheDirectory and g_SaveCachesResult
+static std::condition_variable g_SaveCachesDone;
+static std::string g_CacheDirectory;
+static std::atomic<int> g_CacheDirectoryVersion(0); // bumped each time the directory is set
+static int g_AppliedCacheDirectoryVersion = 0; // version s_CurrentAPI knows about
+static int g_SaveCachesResult = -1; // result of the last render event 4 nobody waited for yet, or -1
+
+static const int kSaveCachesTimeoutMs = 2000;
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetPluginCacheDirectory(const char* directory)
+{
+	std::lock_guard<std::mutex> lock(g_CacheMutex);
+	g_CacheDirectory = directory ? directory : "";
+	g_CacheDirectoryVersion.fetch_add(1);
+}
+
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SavePluginCaches()
+{
+	std::unique_lock<std::mutex> lock(g_CacheMutex);
+	g_SaveCachesDone.wait_for(lock, std::chrono::milliseconds(kSaveCachesTimeoutMs), [] { return g_SaveCachesResult >= 0; });
+	const int result = g_SaveCachesResult > 0 ? 1 : 0;
+	g_SaveCachesResult = -1;
+	return result;
+}
+
+// Render event 4
+static void SaveCaches()
+{
+	const bool saved = s_CurrentAPI && s_CurrentAPI->SaveCaches();
+	{
+		std::lock_guard<std::mutex> lock(g_CacheMutex);
+		g_SaveCachesResult = saved ? 1 : 0;
+	}
+	g_SaveCachesDone.notify_all();
+}
+
+
+// --------------------------------------------------------------------------
+// GetPluginMemoryStats, an example function we export which can be called by scripts.
+// Fills in stats of the device memory the graphics API sub-allocates for the plugin's own resources
+// (see PluginMemoryStats in RenderAPI.h); returns 0 if the current API does not do that.
+
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetPluginMemoryStats(PluginMemoryStats* outStats)
+{
+	return s_CurrentAPI && outStats && s_CurrentAPI->GetMemoryStats(outStats) ? 1 : 0;
+}
+
+
+// Passes a newly set directory (or any directory, to a newly created API) on to the graphics API,
+// on the render thread
+static void ApplyCacheDirectory(bool newAPI)
+{
+	if (g_CacheDirectoryVersion.load() == (newAPI ? 0 : g_AppliedCacheDirectoryVersion))
+		return;
+	std::string directory;
+	{
+		std::lock_guard<std::mutex> lock(g_CacheMutex);
+		g_AppliedCacheDirectoryVersion = g_CacheDirectoryVersion.load();
+		directory = g_CacheDirectory;
+	}
+	s_CurrentAPI->SetCacheDirectory(directory.c_str());
+}
+
+
 
 // --------------------------------------------------------------------------
 // OnRenderEvent
@@ -169,6 +382,8 @@ static void UNITY_INTERFACE_API OnGraphicsDeviceEvent(UnityGfxDeviceEventType ev
 
 static void DrawColoredTriangle()
 {
+	PROFILE_STAGE(kPluginStageDrawColoredTriangle);
+
 	// Draw a colored triangle. Note that colors will come out differently
 	// in D3D and OpenGL, for example, since they expect color bytes
 	// in different ordering.
@@ -197,66 +412,149 @@ static void DrawColoredTriangle()
 		0,0,finalDepth,1,
 	};
 
+	PROFILE_STAGE(kPluginStageApiDrawSimpleTriangles);
 	s_CurrentAPI->DrawSimpleTriangles(worldMatrix, 1, verts);
 }
 
 
+// Tables for the current texture size, so that each frame only needs a few sines per row/column
+static PlasmaPlan s_PlasmaPlan;
+
+#if SUPPORT_THREADS
+static void UploadProducedTexture(void* textureHandle, int width, int height, float t)
+{
+	int framesBehind;
+	const unsigned char* frame = s_TextureProducer->AcquireFrame(t, &framesBehind);
+	g_TextureFramesBehind = framesBehind;
+
+	// Nothing finished yet (just started); the texture keeps its previous contents
+	if (frame)
+	{
+		int textureRowPitch;
+		unsigned char* dst;
+		{
+			PROFILE_STAGE(kPluginStageApiBeginModifyTexture);
+			dst = (unsigned char*)s_CurrentAPI->BeginModifyTexture(textureHandle, width, height, &textureRowPitch);
+		}
+		if (dst)
+		{
+			for (int y = 0; y < height; ++y)
+				memcpy(dst + y * textureRowPitch, frame + y * width * 4, width * 4);
+			PROFILE_STAGE(kPluginStageApiEndModifyTexture);
+			s_CurrentAPI->EndModifyTexture(textureHandle, width, height, textureRowPitch, dst);
+		}
+	}
+	s_TextureProducer->ReleaseFrame();
+}
+#endif // #if SUPPORT_THREADS
+
 static void ModifyTexturePixels()
 {
+	PROFILE_STAGE(kPluginStageModifyTexturePixels);
+
 	void* textureHandle = g_TextureHandle;
 	int width = g_TextureWidth;
 	int height = g_TextureHeight;
 	if (!textureHandle)
 		return;
 
-	int textureRowPitch;
-	void* textureDataPtr = s_CurrentAPI->BeginModifyTexture(textureHandle, width, height, &textureRowPitch);
-	if (!textureDataPtr)
-		return;
-
 	const float t = g_Time * 4.0f;
 
-	unsigned char* dst = (unsigned char*)textureDataPtr;
-	for (int y = 0; y < height; ++y)
+	if (g_ComputeMode & kPluginComputeTexture)
 	{
-		unsigned char* ptr = dst;
-		for (int x = 0; x < width; ++x)
+		bool generated;
+		{
+			PROFILE_STAGE(kPluginStageApiGenerateTexture);
+			generated = s_CurrentAPI->GenerateTexture(textureHandle, width, height, t);
+		}
+		if (generated)
 		{
-			// Simple "plasma effect": several combined sine waves
-			int vv = int(
-				(127.0f + (127.0f * sinf(x / 7.0f + t))) +
-				(127.0f + (127.0f * sinf(y / 5.0f - t))) +
-				(127.0f + (127.0f * sinf((x + y) / 6.0f - t))) +
-				(127.0f + (127.0f * sinf(sqrtf(float(x*x + y*y)) / 4.0f - t)))
-				) / 4;
-
-			// Write the texture pixel
-			ptr[0] = vv;
-			ptr[1] = vv;
-			ptr[2] = vv;
-			ptr[3] = vv;
-
-			// To next pixel (our pixels are 4 bpp)
-			ptr += 4;
+			g_TextureFramesBehind = 0;
+			return;
 		}
+	}
 
-		// To next image row
-		dst += textureRowPitch;
+#if SUPPORT_THREADS
+	// Texture generated ahead of time by worker threads?
+	const int ringDepth = g_TextureRingDepth;
+	if (s_TextureProducer && (s_TextureProducer->GetRingDepth() != ringDepth || s_TextureProducer->GetWidth() != width || s_TextureProducer->GetHeight() != height))
+	{
+		delete s_TextureProducer;
+		s_TextureProducer = NULL;
+	}
+	if (ringDepth >= 2)
+	{
+		if (!s_TextureProducer)
+			s_TextureProducer = new TextureProducer(width, height, ringDepth);
+		UploadProducedTexture(textureHandle, width, height, t);
+		return;
+	}
+#endif // #if SUPPORT_THREADS
+	g_TextureFramesBehind = 0;
+
+	int textureRowPitch;
+	void* textureDataPtr;
+	{
+		PROFILE_STAGE(kPluginStageApiBeginModifyTexture);
+		textureDataPtr = s_CurrentAPI->BeginModifyTexture(textureHandle, width, height, &textureRowPitch);
 	}
+	if (!textureDataPtr)
+		return;
 
+	// Simple "plasma effect": several combined sine waves, see PlasmaKernel.cpp
+	if (!s_PlasmaPlan.Matches(width, height))
+		s_PlasmaPlan.Build(width, height);
+	s_PlasmaPlan.Update(t);
+	FillPlasmaImage(s_PlasmaPlan, (unsigned char*)textureDataPtr, textureRowPitch, width, height);
+
+	PROFILE_STAGE(kPluginStageApiEndModifyTexture);
 	s_CurrentAPI->EndModifyTexture(textureHandle, width, height, textureRowPitch, textureDataPtr);
 }
 
 
+// Enough work per task to be worth handing to another thread; a multiple of the 8 vertices
+// the vectorized kernels do per iteration.
+static const int kVerticesPerTask = 8192;
+
+struct VertexWaveJob
+{
+	VertexWaveFunc kernel;
+	const MeshSource* src;
+	MeshVertex* dst;
+	int vertexCount;
+	float t;
+};
+
+static void DeformVertexRange(void* userData, int taskIndex)
+{
+	const VertexWaveJob& job = *(const VertexWaveJob*)userData;
+	const int begin = taskIndex * kVerticesPerTask;
+	const int end = begin + kVerticesPerTask < job.vertexCount ? begin + kVerticesPerTask : job.vertexCount;
+	job.kernel(*job.src, job.dst, begin, end, job.t);
+}
+
 static void ModifyVertexBuffer()
 {
+	PROFILE_STAGE(kPluginStageModifyVertexBuffer);
+
 	void* bufferHandle = g_VertexBufferHandle;
 	int vertexCount = g_VertexBufferVertexCount;
 	if (!bufferHandle)
 		return;
 
+	if (g_ComputeMode & kPluginComputeVertices)
+	{
+		PROFILE_STAGE(kPluginStageApiDeformVertexBuffer);
+		if (s_CurrentAPI->DeformVertexBuffer(bufferHandle, vertexCount, g_VertexSource, g_VertexSourceVersion, g_Time * 3.0f))
+			return;
+	}
+
 	size_t bufferSize;
-	void* bufferDataPtr = s_CurrentAPI->BeginModifyVertexBuffer(bufferHandle, &bufferSize);
+	void* bufferDataPtr;
+	{
+		PROFILE_STAGE(kPluginStageApiBeginModifyVertexBuffer);
+		bufferDataPtr = s_CurrentAPI->BeginModifyVertexBuffer(bufferHandle, &bufferSize);
+	}
 	if (!bufferDataPtr)
 		return;
 	int vertexStride = int(bufferSize / vertexCount);
@@ -268,44 +566,46 @@ static void ModifyVertexBuffer()
 	if (static_cast<unsigned int>(vertexStride) != sizeof(MeshVertex))
 		return;
 
-	const float t = g_Time * 3.0f;
-
-	char* bufferPtr = (char*)bufferDataPtr;
-	// modify vertex Y position with several scrolling sine waves,
-	// copy the rest of the source data unmodified
-	for (int i = 0; i < vertexCount; ++i)
-	{
-		const MeshVertex& src = g_VertexSource[i];
-		MeshVertex& dst = *(MeshVertex*)bufferPtr;
-		dst.pos[0] = src.pos[0];
-		dst.pos[1] = src.pos[1] + sinf(src.pos[0] * 1.1f + t) * 0.4f + sinf(src.pos[2] * 0.9f - t) * 0.3f;
-		dst.pos[2] = src.pos[2];
-		dst.normal[0] = src.normal[0];
-		dst.normal[1] = src.normal[1];
-		dst.normal[2] = src.normal[2];
-		dst.uv[0] = src.uv[0];
-		dst.uv[1] = src.uv[1];
-		bufferPtr += vertexStride;
-	}
-
+	// Modify vertex Y position with several scrolling sine waves, copy the rest of the source
+	// data unmodified (see VertexKernel.cpp); big meshes are split across the worker threads.
+	VertexWaveJob job;
+	job.kernel = GetVertexWaveKernel(GetBestVertexKernelISA());
+	job.src = &g_VertexSource;
+	job.dst = (MeshVertex*)bufferDataPtr;
+	job.vertexCount = vertexCount;
+	job.t = g_Time * 3.0f;
+	ParallelFor((vertexCount + kVerticesPerTask - 1) / kVerticesPerTask, DeformVertexRange, &job);
+
+	PROFILE_STAGE(kPluginStageApiEndModifyVertexBuffer);
 	s_CurrentAPI->EndModifyVertexBuffer(bufferHandle);
 }
 
 static void drawToPluginTexture()
 {
+	PROFILE_STAGE(kPluginStageDrawToPluginTexture);
 	s_CurrentAPI->drawToPluginTexture();
 }
 
 static void drawToRenderTexture()
 {
+	PROFILE_STAGE(kPluginStageDrawToRenderTexture);
 	s_CurrentAPI->drawToRenderTexture();
 }
 
 static void UNITY_INTERFACE_API OnRenderEvent(int eventID)
 {
-	// Unknown / unsupported graphics device type? Do nothing
+	// Unknown / unsupported graphics device type? Do nothing, but don't keep SavePluginCaches waiting
 	if (s_CurrentAPI == NULL)
+	{
+		if (eventID == 4)
+			SaveCaches();
 		return;
+	}
+
+	PROFILE_STAGE_ARG(kPluginStageRenderEvent, eventID);
+
+	ApplyCacheDirectory(false);
+	s_CurrentAPI->BeginRenderEvent();
 
 	if (eventID == 1)
 	{
@@ -320,6 +620,20 @@ static void UNITY_INTERFACE_API OnRenderEvent(int eventID)
 		drawToPluginTexture();
 	}
 
+	// Texture and vertex buffer updates of event 1, recorded in one go; Vulkan runs this event outside of
+	// render passes (see RenderAPI_Vulkan.cpp)
+	if (eventID == 3)
+	{
+		PROFILE_STAGE(kPluginStageApiFlushUploads);
+		s_CurrentAPI->FlushUploads();
+	}
+
+	if (eventID == 4)
+	{
+		SaveCaches();
+	}
+
+	s_CurrentAPI->EndRenderEvent();
 }
 
 // --------------------------------------------------------------------------
@@ -0,0 +1,153 @@
+#pragma once
+
+// Vectorized math helpers shared by the SIMD kernels.
+//
+// SinApprox*: sine approximation, max abs error ~4e-6 for |x| up to ~1e5 (plenty for 8 bit
+// color values and vertex offsets). Range reduction to [-pi, pi] with a two part 2*pi constant,
+// folding into [-pi/2, pi/2] using sin(pi - x) = sin(x), then a degree 9 odd polynomial.
+
+#include "PlatformBase.h"
+
+#if SUPPORT_SSE2
+#	include <emmintrin.h>
+#endif
+#if SUPPORT_AVX2 || SUPPORT_AVX512
+#	include <immintrin.h>
+#endif
+#if SUPPORT_NEON
+#	include <arm_neon.h>
+#endif
+
+
+#define SIMD_MATH_INV_2PI	0.15915494309189535f
+#define SIMD_MATH_2PI_HI	6.28125f // few mantissa bits, so k * SIMD_MATH_2PI_HI is exact
+#define SIMD_MATH_2PI_LO	0.0019353071795864769f
+#define SIMD_MATH_PI		3.14159265358979323f
+#define SIMD_MATH_SIN_C3	-1.6666666666666667e-1f
+#define SIMD_MATH_SIN_C5	8.3333333333333333e-3f
+#define SIMD_MATH_SIN_C7	-1.9841269841269841e-4f
+#define SIMD_MATH_SIN_C9	2.7557319223985891e-6f
+
+
+#if SUPPORT_SSE2
+
+static inline __m128 SinApproxSSE2(__m128 x)
+{
+	const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+	// cvtps rounds to nearest with the default rounding mode
+	const __m128 k = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(SIMD_MATH_INV_2PI))));
+	__m128 r = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(SIMD_MATH_2PI_HI)));
+	r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(SIMD_MATH_2PI_LO)));
+
+	const __m128 sign = _mm_and_ps(r, signMask);
+	__m128 a = _mm_andnot_ps(signMask, r);
+	a = _mm_min_ps(a, _mm_sub_ps(_mm_set1_ps(SIMD_MATH_PI), a));
+
+	const __m128 a2 = _mm_mul_ps(a, a);
+	__m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIMD_MATH_SIN_C9), a2), _mm_set1_ps(SIMD_MATH_SIN_C7));
+	p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(SIMD_MATH_SIN_C5));
+	p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(SIMD_MATH_SIN_C3));
+	p = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, a2), a), a);
+	return _mm_or_ps(p, sign);
+}
+
+#endif // #if SUPPORT_SSE2
+
+
+#if SUPPORT_AVX2
+
+SIMD_TARGET_AVX2 static inline __m256 SinApproxAVX2(__m256 x)
+{
+	const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+	const __m256 k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(SIMD_MATH_INV_2PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256 r = _mm256_fnmadd_ps(k, _mm256_set1_ps(SIMD_MATH_2PI_HI), x);
+	r = _mm256_fnmadd_ps(k, _mm256_set1_ps(SIMD_MATH_2PI_LO), r);
+
+	const __m256 sign = _mm256_and_ps(r, signMask);
+	__m256 a = _mm256_andnot_ps(signMask, r);
+	a = _mm256_min_ps(a, _mm256_sub_ps(_mm256_set1_ps(SIMD_MATH_PI), a));
+
+	const __m256 a2 = _mm256_mul_ps(a, a);
+	__m256 p = _mm256_fmadd_ps(_mm256_set1_ps(SIMD_MATH_SIN_C9), a2, _mm256_set1_ps(SIMD_MATH_SIN_C7));
+	p = _mm256_fmadd_ps(p, a2, _mm256_set1_ps(SIMD_MATH_SIN_C5));
+	p = _mm256_fmadd_ps(p, a2, _mm256_set1_ps(SIMD_MATH_SIN_C3));
+	p = _mm256_fmadd_ps(_mm256_mul_ps(p, a2), a, a);
+	return _mm256_or_ps(p, sign);
+}
+
+#endif // #if SUPPORT_AVX2
+
+
+#if SUPPORT_AVX512
+
+SIMD_TARGET_AVX512 static inline __m512 SinApproxAVX512(__m512 x)
+{
+	const __m512i signMask = _mm512_set1_epi32(0x80000000);
+	const __m512 k = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(SIMD_MATH_INV_2PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m512 r = _mm512_fnmadd_ps(k, _mm512_set1_ps(SIMD_MATH_2PI_HI), x);
+	r = _mm512_fnmadd_ps(k, _mm512_set1_ps(SIMD_MATH_2PI_LO), r);
+
+	// AVX-512F only has integer bitwise ops
+	const __m512i sign = _mm512_and_si512(_mm512_castps_si512(r), signMask);
+	__m512 a = _mm512_castsi512_ps(_mm512_andnot_si512(signMask, _mm512_castps_si512(r)));
+	a = _mm512_min_ps(a, _mm512_sub_ps(_mm512_set1_ps(SIMD_MATH_PI), a));
+
+	const __m512 a2 = _mm512_mul_ps(a, a);
+	__m512 p = _mm512_fmadd_ps(_mm512_set1_ps(SIMD_MATH_SIN_C9), a2, _mm512_set1_ps(SIMD_MATH_SIN_C7));
+	p = _mm512_fmadd_ps(p, a2, _mm512_set1_ps(SIMD_MATH_SIN_C5));
+	p = _mm512_fmadd_ps(p, a2, _mm512_set1_ps(SIMD_MATH_SIN_C3));
+	p = _mm512_fmadd_ps(_mm512_mul_ps(p, a2), a, a);
+	return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(p), sign));
+}
+
+#endif // #if SUPPORT_AVX512
+
+
+#if SUPPORT_NEON
+
+static inline float32x4_t RoundNearestNEON(float32x4_t x)
+{
+#	if defined(__aarch64__) || defined(_M_ARM64)
+	return vrndnq_f32(x);
+#	else
+	// ARMv7 has no round instruction; add +-0.5 and truncate
+	const uint32x4_t signMask = vdupq_n_u32(0x80000000u);
+	const float32x4_t half = vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(vdupq_n_f32(0.5f)), vandq_u32(vreinterpretq_u32_f32(x), signMask)));
+	return vcvtq_f32_s32(vcvtq_s32_f32(vaddq_f32(x, half)));
+#	endif
+}
+
+static inline float32x4_t SqrtNEON(float32x4_t x)
+{
+#	if defined(__aarch64__) || defined(_M_ARM64)
+	return vsqrtq_f32(x);
+#	else
+	// x * rsqrt(x) with two Newton-Raphson steps; zero inputs give zero
+	float32x4_t e = vrsqrteq_f32(x);
+	e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(x, e), e));
+	e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(x, e), e));
+	const uint32x4_t nonZero = vcgtq_f32(x, vdupq_n_f32(0.0f));
+	return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vmulq_f32(x, e)), nonZero));
+#	endif
+}
+
+static inline float32x4_t SinApproxNEON(float32x4_t x)
+{
+	const uint32x4_t signMask = vdupq_n_u32(0x80000000u);
+	const float32x4_t k = RoundNearestNEON(vmulq_n_f32(x, SIMD_MATH_INV_2PI));
+	float32x4_t r = vmlsq_n_f32(x, k, SIMD_MATH_2PI_HI);
+	r = vmlsq_n_f32(r, k, SIMD_MATH_2PI_LO);
+
+	const uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(r), signMask);
+	float32x4_t a = vabsq_f32(r);
+	a = vminq_f32(a, vsubq_f32(vdupq_n_f32(SIMD_MATH_PI), a));
+
+	const float32x4_t a2 = vmulq_f32(a, a);
+	float32x4_t p = vmlaq_n_f32(vdupq_n_f32(SIMD_MATH_SIN_C7), a2, SIMD_MATH_SIN_C9);
+	p = vmlaq_f32(vdupq_n_f32(SIMD_MATH_SIN_C5), p, a2);
+	p = vmlaq_f32(vdupq_n_f32(SIMD_MATH_SIN_C3), p, a2);
+	p = vmlaq_f32(a, vmulq_f32(p, a2), a);
+	return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(p), sign));
+}
+
+#endif // #if SUPPORT_NEON
@@ -0,0 +1,158 @@
+#include "TextureProducer.h"
+#include "PluginProfiling.h"
+#include "PluginThreadPool.h"
+
+
+// Full width bands write memory linearly, which is noticeably faster than square tiles on large textures.
+static const int kPlasmaBandRows = 16;
+
+struct PlasmaFillJob
+{
+	const PlasmaPlan* plan;
+	unsigned char* pixels;
+	int rowPitch;
+	int width;
+	int height;
+};
+
+static void FillPlasmaBand(void* userData, int bandIndex)
+{
+	const PlasmaFillJob& job = *(const PlasmaFillJob*)userData;
+	const int y0 = bandIndex * kPlasmaBandRows;
+	const int y1 = y0 + kPlasmaBandRows < job.height ? y0 + kPlasmaBandRows : job.height;
+	job.plan->Fill(job.pixels, job.rowPitch, 0, y0, job.width, y1);
+}
+
+void FillPlasmaImage(const PlasmaPlan& plan, unsigned char* pixels, int rowPitch, int width, int height)
+{
+	PlasmaFillJob job;
+	job.plan = &plan;
+	job.pixels = pixels;
+	job.rowPitch = rowPitch;
+	job.width = width;
+	job.height = height;
+	ParallelFor((height + kPlasmaBandRows - 1) / kPlasmaBandRows, FillPlasmaBand, &job);
+}
+
+
+#if SUPPORT_THREADS
+
+TextureProducer::TextureProducer(int width, int height, int ringDepth)
+: m_Width(width)
+, m_Height(height)
+, m_Slots(ringDepth)
+, m_SlotInUse(-1)
+, m_RequestedFrame(0)
+, m_RequestedTime(0.0f)
+, m_StartedFrame(0)
+, m_DisplayedFrame(0)
+, m_Quit(false)
+{
+	for (size_t i = 0; i < m_Slots.size(); ++i)
+	{
+		m_Slots[i].pixels.resize((size_t)width * height * 4);
+		m_Slots[i].state = kSlotFree;
+		m_Slots[i].frame = 0;
+	}
+	m_Thread = std::thread(&TextureProducer::ThreadMain, this);
+}
+
+TextureProducer::~TextureProducer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Quit = true;
+	}
+	m_Wake.notify_all();
+	m_Thread.join();
+}
+
+int TextureProducer::FindSlot(SlotState state) const
+{
+	for (size_t i = 0; i < m_Slots.size(); ++i)
+	{
+		if (m_Slots[i].state == state)
+			return int(i);
+	}
+	return -1;
+}
+
+void TextureProducer::ThreadMain()
+{
+	ProfilerSetThreadName("Texture producer");
+	m_Plan.Build(m_Width, m_Height);
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	for (;;)
+	{
+		// Wait for a request we have not started on, and a buffer to put it in
+		m_Wake.wait(lock, [this]() { return m_Quit || (m_RequestedFrame > m_StartedFrame && FindSlot(kSlotFree) >= 0); });
+		if (m_Quit)
+			return;
+
+		const int slotIndex = FindSlot(kSlotFree);
+		Slot& slot = m_Slots[slotIndex];
+		slot.state = kSlotProducing;
+		const unsigned long long frame = m_RequestedFrame;
+		const float t = m_RequestedTime;
+		m_StartedFrame = frame;
+		lock.unlock();
+
+		{
+			PROFILE_STAGE(kPluginStageProduceTexture);
+			m_Plan.Update(t);
+			FillPlasmaImage(m_Plan, &slot.pixels[0], m_Width * 4, m_Width, m_Height);
+		}
+
+		lock.lock();
+		slot.frame = frame;
+		slot.state = kSlotReady;
+	}
+}
+
+const unsigned char* TextureProducer::AcquireFrame(float t, int* outFramesBehind)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	++m_RequestedFrame;
+	m_RequestedTime = t;
+
+	// Take the newest finished frame; older finished ones will never be shown, recycle them
+	int newest = -1;
+	for (size_t i = 0; i < m_Slots.size(); ++i)
+	{
+		if (m_Slots[i].state != kSlotReady)
+			continue;
+		if (newest < 0 || m_Slots[i].frame > m_Slots[newest].frame)
+		{
+			if (newest >= 0)
+				m_Slots[newest].state = kSlotFree;
+			newest = int(i);
+		}
+		else
+			m_Slots[i].state = kSlotFree;
+	}
+	if (newest >= 0)
+	{
+		m_Slots[newest].state = kSlotInUse;
+		m_DisplayedFrame = m_Slots[newest].frame;
+	}
+	m_SlotInUse = newest;
+	m_Wake.notify_one();
+
+	*outFramesBehind = int(m_RequestedFrame - m_DisplayedFrame);
+	return newest >= 0 ? &m_Slots[newest].pixels[0] : NULL;
+}
+
+void TextureProducer::ReleaseFrame()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_SlotInUse >= 0)
+	{
+		m_Slots[m_SlotInUse].state = kSlotFree;
+		m_SlotInUse = -1;
+		m_Wake.notify_one();
+	}
+}
+
+#endif // #if SUPPORT_THREADS
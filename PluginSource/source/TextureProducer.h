@@ -0,0 +1,81 @@
+#pragma once
+
+// Generates the plasma texture contents on CPU threads, away from Unity's render thread.
+//
+// A producer thread renders frames into a ring of CPU side buffers, always for the most recently
+// requested time. Each render event requests the next frame, and uploads the newest finished one;
+// so the render thread only copies pixels, at the cost of showing frames that are one or more frames
+// old ("frames behind").
+//
+// Needs SUPPORT_THREADS; without it (and with a ring depth below 2) the plugin generates the texture
+// synchronously in the render event.
+
+#include "PlatformBase.h"
+#include "PlasmaKernel.h"
+
+// Fills a whole width x height RGBA8 image from the plan, in bands of rows spread over the
+// plugin's worker threads (PluginThreadPool.h).
+void FillPlasmaImage(const PlasmaPlan& plan, unsigned char* pixels, int rowPitch, int width, int height);
+
+
+#if SUPPORT_THREADS
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TextureProducer
+{
+public:
+	TextureProducer(int width, int height, int ringDepth);
+	~TextureProducer();
+
+	int GetWidth() const { return m_Width; }
+	int GetHeight() const { return m_Height; }
+	int GetRingDepth() const { return int(m_Slots.size()); }
+
+	// Render thread: requests a frame for time t, and returns the newest finished frame (width*4 bytes
+	// per row), or NULL if there is none yet. The frame stays valid until ReleaseFrame.
+	// outFramesBehind is how many requests ago the returned frame was requested.
+	const unsigned char* AcquireFrame(float t, int* outFramesBehind);
+	void ReleaseFrame();
+
+private:
+	enum SlotState
+	{
+		kSlotFree,
+		kSlotProducing,
+		kSlotReady,
+		kSlotInUse
+	};
+
+	struct Slot
+	{
+		std::vector<unsigned char> pixels;
+		SlotState state;
+		unsigned long long frame; // request number the pixels were made for
+	};
+
+	void ThreadMain();
+	int FindSlot(SlotState state) const;
+
+	int m_Width;
+	int m_Height;
+	std::vector<Slot> m_Slots;
+	int m_SlotInUse;
+
+	// Protects everything below and the slot states
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	unsigned long long m_RequestedFrame;
+	float m_RequestedTime;
+	unsigned long long m_StartedFrame;
+	unsigned long long m_DisplayedFrame;
+	bool m_Quit;
+
+	PlasmaPlan m_Plan; // used by the producer thread only
+	std::thread m_Thread;
+};
+
+#endif // #if SUPPORT_THREADS
@@ -0,0 +1,271 @@
+#include "VertexKernel.h"
+#include "CpuFeatures.h"
+#include "PlatformBase.h"
+#include "SimdMath.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+
+MeshSource::MeshSource()
+: m_VertexCount(0)
+, m_StreamStride(0)
+, m_FirstStream(0)
+{
+}
+
+void MeshSource::Set(int vertexCount, const float* positions, const float* normals, const float* uvs)
+{
+	const size_t kBlockFloats = kMeshSourceAlignment / sizeof(float);
+	m_VertexCount = vertexCount;
+	m_StreamStride = (size_t(vertexCount) + kBlockFloats - 1) / kBlockFloats * kBlockFloats;
+
+	// std::vector only aligns for float; allocate one block more and start at the first aligned float
+	m_Storage.assign(m_StreamStride * 8 + kBlockFloats - 1, 0.0f);
+	const size_t misalignment = size_t(uintptr_t(&m_Storage[0]) % kMeshSourceAlignment);
+	m_FirstStream = misalignment ? (kMeshSourceAlignment - misalignment) / sizeof(float) : 0;
+
+	float* x = &m_Storage[0] + m_FirstStream;
+	float* y = x + m_StreamStride;
+	float* z = y + m_StreamStride;
+	for (int i = 0; i < vertexCount; ++i)
+	{
+		x[i] = positions[i * 3 + 0];
+		y[i] = positions[i * 3 + 1];
+		z[i] = positions[i * 3 + 2];
+	}
+	if (vertexCount > 0)
+	{
+		memcpy(z + m_StreamStride, normals, vertexCount * 3 * sizeof(float));
+		memcpy(z + m_StreamStride * 4, uvs, vertexCount * 2 * sizeof(float));
+	}
+}
+
+
+// Source as structure of arrays (MeshSource)
+
+struct SourceStreams
+{
+	explicit SourceStreams(const MeshSource& src)
+	: x(src.GetX()), y(src.GetY()), z(src.GetZ()), normals(src.GetNormals()), uvs(src.GetUVs())
+	{
+	}
+
+	const float* x;
+	const float* y;
+	const float* z;
+	const float* normals;
+	const float* uvs;
+};
+
+static inline void WriteVertex(const SourceStreams& s, int i, MeshVertex& dst, float y)
+{
+	dst.pos[0] = s.x[i];
+	dst.pos[1] = y;
+	dst.pos[2] = s.z[i];
+	dst.normal[0] = s.normals[i * 3 + 0];
+	dst.normal[1] = s.normals[i * 3 + 1];
+	dst.normal[2] = s.normals[i * 3 + 2];
+	dst.uv[0] = s.uvs[i * 2 + 0];
+	dst.uv[1] = s.uvs[i * 2 + 1];
+}
+
+// Reference version; this is what ModifyVertexBuffer originally did per vertex.
+static void WaveScalarRange(const SourceStreams& s, MeshVertex* dst, int begin, int end, float t)
+{
+	// modify vertex Y position with several scrolling sine waves,
+	// copy the rest of the source data unmodified
+	for (int i = begin; i < end; ++i)
+		WriteVertex(s, i, dst[i], s.y[i] + sinf(s.x[i] * 1.1f + t) * 0.4f + sinf(s.z[i] * 0.9f - t) * 0.3f);
+}
+
+static void VertexWaveScalar(const MeshSource& src, MeshVertex* dst, int begin, int end, float t)
+{
+	WaveScalarRange(SourceStreams(src), dst, begin, end, t);
+}
+
+// First vertex at or after begin (and not past end) whose stream elements start a vector of n floats.
+// The streams are aligned to kMeshSourceAlignment, so from there on vector loads are aligned too.
+static inline int AlignVertexIndex(int begin, int end, int n)
+{
+	const int aligned = (begin + n - 1) / n * n;
+	return aligned < end ? aligned : end;
+}
+
+
+// Vectorized versions compute the new Y of 8 vertices at a time with aligned loads, then write the
+// vertices out (SSE2 / AVX2 four at a time, NEON one by one). Vertices before the first aligned one,
+// and remaining vertices that do not fill a whole iteration, are done with the reference code.
+
+#if SUPPORT_SSE2
+
+// Writes vertices i..i+3 (i a multiple of 4) with their new Y. Position and normal x of each vertex are
+// transposed into one 16 byte store, normal y/z and UV are 8 byte stores, and colors are skipped: three
+// stores per vertex instead of eight.
+static inline void WriteVertices4SSE2(const SourceStreams& s, int i, __m128 y, MeshVertex* dst)
+{
+	const __m128 n0 = _mm_load_ps(s.normals + i * 3); // nx0 ny0 nz0 nx1
+	const __m128 n1 = _mm_load_ps(s.normals + i * 3 + 4); // ny1 nz1 nx2 ny2
+	const __m128 n2 = _mm_load_ps(s.normals + i * 3 + 8); // nz2 nx3 ny3 nz3
+	const __m128 nx23 = _mm_shuffle_ps(n1, n2, _MM_SHUFFLE(1, 1, 2, 2));
+	__m128 r0 = _mm_load_ps(s.x + i);
+	__m128 r1 = y;
+	__m128 r2 = _mm_load_ps(s.z + i);
+	__m128 r3 = _mm_shuffle_ps(n0, nx23, _MM_SHUFFLE(2, 0, 3, 0));
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	_mm_storeu_ps(dst[0].pos, r0);
+	_mm_storeu_ps(dst[1].pos, r1);
+	_mm_storeu_ps(dst[2].pos, r2);
+	_mm_storeu_ps(dst[3].pos, r3);
+
+	const __m128 n2y = _mm_shuffle_ps(n1, n2, _MM_SHUFFLE(0, 0, 3, 3));
+	_mm_storel_pi((__m64*)&dst[0].normal[1], _mm_shuffle_ps(n0, n0, _MM_SHUFFLE(2, 1, 2, 1)));
+	_mm_storel_pi((__m64*)&dst[1].normal[1], n1);
+	_mm_storel_pi((__m64*)&dst[2].normal[1], _mm_shuffle_ps(n2y, n2y, _MM_SHUFFLE(2, 0, 2, 0)));
+	_mm_storeh_pi((__m64*)&dst[3].normal[1], n2);
+
+	const __m128 uv01 = _mm_load_ps(s.uvs + i * 2);
+	const __m128 uv23 = _mm_load_ps(s.uvs + i * 2 + 4);
+	_mm_storel_pi((__m64*)dst[0].uv, uv01);
+	_mm_storeh_pi((__m64*)dst[1].uv, uv01);
+	_mm_storel_pi((__m64*)dst[2].uv, uv23);
+	_mm_storeh_pi((__m64*)dst[3].uv, uv23);
+}
+
+static inline __m128 WaveYSSE2(const SourceStreams& s, int i, __m128 t)
+{
+	const __m128 x = _mm_load_ps(s.x + i);
+	const __m128 y = _mm_load_ps(s.y + i);
+	const __m128 z = _mm_load_ps(s.z + i);
+	const __m128 s0 = SinApproxSSE2(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.1f)), t));
+	const __m128 s1 = SinApproxSSE2(_mm_sub_ps(_mm_mul_ps(z, _mm_set1_ps(0.9f)), t));
+	return _mm_add_ps(y, _mm_add_ps(_mm_mul_ps(s0, _mm_set1_ps(0.4f)), _mm_mul_ps(s1, _mm_set1_ps(0.3f))));
+}
+
+static void VertexWaveSSE2(const MeshSource& src, MeshVertex* dst, int begin, int end, float t)
+{
+	const SourceStreams s(src);
+	const __m128 vt = _mm_set1_ps(t);
+	int i = AlignVertexIndex(begin, end, 4);
+	WaveScalarRange(s, dst, begin, i, t);
+	for (; i + 8 <= end; i += 8)
+	{
+		WriteVertices4SSE2(s, i, WaveYSSE2(s, i, vt), dst + i);
+		WriteVertices4SSE2(s, i + 4, WaveYSSE2(s, i + 4, vt), dst + i + 4);
+	}
+	WaveScalarRange(s, dst, i, end, t);
+}
+
+#endif // #if SUPPORT_SSE2
+
+
+#if SUPPORT_AVX2
+
+SIMD_TARGET_AVX2 static void VertexWaveAVX2(const MeshSource& src, MeshVertex* dst, int begin, int end, float t)
+{
+	const SourceStreams s(src);
+	const __m256 vt = _mm256_set1_ps(t);
+	int i = AlignVertexIndex(begin, end, 8);
+	WaveScalarRange(s, dst, begin, i, t);
+	for (; i + 8 <= end; i += 8)
+	{
+		const __m256 x = _mm256_load_ps(s.x + i);
+		const __m256 y = _mm256_load_ps(s.y + i);
+		const __m256 z = _mm256_load_ps(s.z + i);
+		const __m256 s0 = SinApproxAVX2(_mm256_fmadd_ps(x, _mm256_set1_ps(1.1f), vt));
+		const __m256 s1 = SinApproxAVX2(_mm256_fmsub_ps(z, _mm256_set1_ps(0.9f), vt));
+		const __m256 newY = _mm256_fmadd_ps(s1, _mm256_set1_ps(0.3f), _mm256_fmadd_ps(s0, _mm256_set1_ps(0.4f), y));
+		WriteVertices4SSE2(s, i, _mm256_castps256_ps128(newY), dst + i);
+		WriteVertices4SSE2(s, i + 4, _mm256_extractf128_ps(newY, 1), dst + i + 4);
+	}
+	WaveScalarRange(s, dst, i, end, t);
+}
+
+#endif // #if SUPPORT_AVX2
+
+
+#if SUPPORT_NEON
+
+static inline float32x4_t WaveYNEON(const SourceStreams& s, int i, float32x4_t t)
+{
+	const float32x4_t x = vld1q_f32(s.x + i);
+	const float32x4_t y = vld1q_f32(s.y + i);
+	const float32x4_t z = vld1q_f32(s.z + i);
+	const float32x4_t s0 = SinApproxNEON(vmlaq_n_f32(t, x, 1.1f));
+	const float32x4_t s1 = SinApproxNEON(vsubq_f32(vmulq_n_f32(z, 0.9f), t));
+	return vmlaq_n_f32(vmlaq_n_f32(y, s0, 0.4f), s1, 0.3f);
+}
+
+static void VertexWaveNEON(const MeshSource& src, MeshVertex* dst, int begin, int end, float t)
+{
+	const SourceStreams s(src);
+	const float32x4_t vt = vdupq_n_f32(t);
+	int i = AlignVertexIndex(begin, end, 4);
+	WaveScalarRange(s, dst, begin, i, t);
+	for (; i + 8 <= end; i += 8)
+	{
+		float y[8];
+		vst1q_f32(y, WaveYNEON(s, i, vt));
+		vst1q_f32(y + 4, WaveYNEON(s, i + 4, vt));
+		for (int k = 0; k < 8; ++k)
+			WriteVertex(s, i + k, dst[i + k], y[k]);
+	}
+	WaveScalarRange(s, dst, i, end, t);
+}
+
+#endif // #if SUPPORT_NEON
+
+
+VertexWaveFunc GetVertexWaveKernel(VertexKernelISA isa)
+{
+	const unsigned int features = GetCpuFeatures();
+	switch (isa)
+	{
+	case kVertexKernelScalar:
+		return VertexWaveScalar;
+#	if SUPPORT_SSE2
+	case kVertexKernelSSE2:
+		return (features & kCpuFeatureSSE2) ? VertexWaveSSE2 : NULL;
+#	endif
+#	if SUPPORT_AVX2
+	case kVertexKernelAVX2:
+		return (features & kCpuFeatureAVX2) ? VertexWaveAVX2 : NULL;
+#	endif
+#	if SUPPORT_NEON
+	case kVertexKernelNEON:
+		return (features & kCpuFeatureNEON) ? VertexWaveNEON : NULL;
+#	endif
+	default:
+		return NULL;
+	}
+}
+
+static VertexKernelISA DetectBestVertexKernelISA()
+{
+	static const VertexKernelISA kPreferred[] = { kVertexKernelAVX2, kVertexKernelSSE2, kVertexKernelNEON };
+	for (size_t i = 0; i < sizeof(kPreferred) / sizeof(kPreferred[0]); ++i)
+	{
+		if (GetVertexWaveKernel(kPreferred[i]) != NULL)
+			return kPreferred[i];
+	}
+	return kVertexKernelScalar;
+}
+
+VertexKernelISA GetBestVertexKernelISA()
+{
+	static const VertexKernelISA s_Best = DetectBestVertexKernelISA();
+	return s_Best;
+}
+
+const char* GetVertexKernelISAName(VertexKernelISA isa)
+{
+	switch (isa)
+	{
+	case kVertexKernelScalar: return "scalar";
+	case kVertexKernelSSE2: return "SSE2";
+	case kVertexKernelAVX2: return "AVX2";
+	case kVertexKernelNEON: return "NEON";
+	default: return "unknown";
+	}
+}
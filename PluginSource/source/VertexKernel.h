@@ -0,0 +1,84 @@
+#pragma once
+
+// The wave the plugin applies to the mesh every frame (see ModifyVertexBuffer in RenderingPlugin.cpp):
+// vertex Y is moved by two scrolling sine waves, the rest is copied from the source mesh. There is a
+// plain C version and vectorized versions doing 8 vertices per iteration; the best one the CPU
+// supports is picked at runtime.
+//
+// The source mesh is kept as separate streams (MeshSource below), so the kernels read it with aligned
+// vector loads and write each vertex with a few wide stores. HeadlessHost --bench-vertices compares them
+// with kernels reading the source from an array of MeshVertex, like the plugin used to keep it.
+//
+// Vectorized versions use an approximate sine, so positions may differ from the plain C version
+// by a few millionths.
+
+#include <stddef.h>
+#include <vector>
+
+// Vertex layout of the mesh the plugin modifies (position, normal, color, UV; 48 bytes)
+struct MeshVertex
+{
+	float pos[3];
+	float normal[3];
+	float color[4];
+	float uv[2];
+};
+
+// Source mesh as structure of arrays: x, y and z of the positions as three streams, normals
+// (3 floats per vertex) and UVs (2 floats per vertex) as two more. Each stream starts on a
+// kMeshSourceAlignment byte boundary, and is padded to a whole number of such blocks.
+static const int kMeshSourceAlignment = 64;
+
+class MeshSource
+{
+public:
+	MeshSource();
+
+	// positions and normals have 3 floats per vertex, uvs 2, like the arrays of a Unity Mesh.
+	void Set(int vertexCount, const float* positions, const float* normals, const float* uvs);
+
+	int GetVertexCount() const { return m_VertexCount; }
+	const float* GetX() const { return GetStream(0); }
+	const float* GetY() const { return GetStream(1); }
+	const float* GetZ() const { return GetStream(2); }
+	const float* GetNormals() const { return GetStream(3); }
+	const float* GetUVs() const { return GetStream(6); }
+
+	// Memory used by the streams, in bytes
+	size_t GetMemorySize() const { return m_Storage.size() * sizeof(float); }
+
+private:
+	// Stream n starts n * m_StreamStride floats after the first one; normals take 3 strides, UVs 2.
+	const float* GetStream(int n) const { return m_Storage.empty() ? NULL : &m_Storage[0] + m_FirstStream + n * m_StreamStride; }
+
+	// Not copyable: a copy of m_Storage would not be aligned the same way
+	MeshSource(const MeshSource&);
+	MeshSource& operator=(const MeshSource&);
+
+	int m_VertexCount;
+	size_t m_StreamStride; // vertex count rounded up to whole alignment blocks, in floats
+	size_t m_FirstStream; // offset of the first aligned float in m_Storage
+	std::vector<float> m_Storage;
+};
+
+
+enum VertexKernelISA
+{
+	kVertexKernelScalar = 0,
+	kVertexKernelSSE2,
+	kVertexKernelAVX2,
+	kVertexKernelNEON,
+	kVertexKernelCount
+};
+
+// Writes vertices [begin,end) of dst from the same vertices of src: position with the wave at
+// time t applied, normal and UV copied. Vertex colors in dst are left as they are.
+typedef void (*VertexWaveFunc)(const MeshSource& src, MeshVertex* dst, int begin, int end, float t);
+
+// Return NULL if the kernel is not compiled in, or the CPU does not support it.
+VertexWaveFunc GetVertexWaveKernel(VertexKernelISA isa);
+
+// Fastest kernel this CPU can run; detected once.
+VertexKernelISA GetBestVertexKernelISA();
+
+const char* GetVertexKernelISAName(VertexKernelISA isa);
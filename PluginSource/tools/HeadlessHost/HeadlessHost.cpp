@@ -0,0 +1,1078 @@
+// Headless stand-in for the Unity player, for measuring the plugin without a real engine.
+//
+// Loads libRenderingPlugin.so, hands it minimal IUnityInterfaces / IUnityGraphics implementations,
+// passes a texture and a mesh the same way UseRenderingPlugin.cs does, and then pumps the render
+// event function for a number of frames, reporting per-event latency percentiles and frames/sec.
+//
+// With --renderer gl / gles it runs the plugin's OpenGL backend instead of the software one, on an EGL
+// context without any window (e.g. Mesa's llvmpipe, with EGL_PLATFORM=surfaceless).
+//
+// With --bench-plasma / --bench-vertices it instead checks the vectorized plasma / vertex wave kernels
+// (PlasmaKernel.cpp, VertexKernel.cpp, linked in directly) against the plain C version and measures
+// each of them.
+//
+// Linux/POSIX only (uses dlopen and EGL); build with "make host" in projects/GNUMake.
+
+#include "PlatformBase.h"
+#include "PlasmaKernel.h"
+#include "PluginProfiling.h"
+#include "RenderAPI_Software.h"
+#include "VertexKernel.h"
+#include "VertexKernelAoS.h"
+#include "Unity/IUnityGraphics.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+
+#include <dlfcn.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// --------------------------------------------------------------------------
+// Mock IUnityInterfaces registry
+
+struct RegisteredInterface
+{
+	UnityInterfaceGUID guid;
+	IUnityInterface* ptr;
+};
+static std::vector<RegisteredInterface> s_Interfaces;
+
+static IUnityInterface* UNITY_INTERFACE_API HostGetInterface(UnityInterfaceGUID guid)
+{
+	for (size_t i = 0; i < s_Interfaces.size(); ++i)
+	{
+		if (s_Interfaces[i].guid == guid)
+			return s_Interfaces[i].ptr;
+	}
+	return NULL;
+}
+
+static void UNITY_INTERFACE_API HostRegisterInterface(UnityInterfaceGUID guid, IUnityInterface* ptr)
+{
+	for (size_t i = 0; i < s_Interfaces.size(); ++i)
+	{
+		if (s_Interfaces[i].guid == guid)
+		{
+			s_Interfaces[i].ptr = ptr;
+			return;
+		}
+	}
+	RegisteredInterface entry = { guid, ptr };
+	s_Interfaces.push_back(entry);
+}
+
+static IUnityInterface* UNITY_INTERFACE_API HostGetInterfaceSplit(unsigned long long guidHigh, unsigned long long guidLow)
+{
+	return HostGetInterface(UnityInterfaceGUID(guidHigh, guidLow));
+}
+
+static void UNITY_INTERFACE_API HostRegisterInterfaceSplit(unsigned long long guidHigh, unsigned long long guidLow, IUnityInterface* ptr)
+{
+	HostRegisterInterface(UnityInterfaceGUID(guidHigh, guidLow), ptr);
+}
+
+static IUnityInterfaces s_UnityInterfaces =
+{
+	HostGetInterface,
+	HostRegisterInterface,
+	HostGetInterfaceSplit,
+	HostRegisterInterfaceSplit,
+};
+
+
+// --------------------------------------------------------------------------
+// Mock IUnityGraphics
+
+static UnityGfxRenderer s_Renderer = kUnityGfxRendererNull;
+static std::vector<IUnityGraphicsDeviceEventCallback> s_DeviceEventCallbacks;
+static int s_NextEventID = 1000;
+
+static UnityGfxRenderer UNITY_INTERFACE_API HostGetRenderer()
+{
+	return s_Renderer;
+}
+
+static void UNITY_INTERFACE_API HostRegisterDeviceEventCallback(IUnityGraphicsDeviceEventCallback callback)
+{
+	s_DeviceEventCallbacks.push_back(callback);
+}
+
+static void UNITY_INTERFACE_API HostUnregisterDeviceEventCallback(IUnityGraphicsDeviceEventCallback callback)
+{
+	s_DeviceEventCallbacks.erase(std::remove(s_DeviceEventCallbacks.begin(), s_DeviceEventCallbacks.end(), callback), s_DeviceEventCallbacks.end());
+}
+
+static int UNITY_INTERFACE_API HostReserveEventIDRange(int count)
+{
+	int base = s_NextEventID;
+	s_NextEventID += count;
+	return base;
+}
+
+static IUnityGraphics s_UnityGraphics;
+
+static void InitUnityGraphics()
+{
+	s_UnityGraphics.GetRenderer = HostGetRenderer;
+	s_UnityGraphics.RegisterDeviceEventCallback = HostRegisterDeviceEventCallback;
+	s_UnityGraphics.UnregisterDeviceEventCallback = HostUnregisterDeviceEventCallback;
+	s_UnityGraphics.ReserveEventIDRange = HostReserveEventIDRange;
+}
+
+static void SendDeviceEvent(UnityGfxDeviceEventType type)
+{
+	// Callbacks may unregister themselves while being called, so iterate over a copy
+	std::vector<IUnityGraphicsDeviceEventCallback> callbacks = s_DeviceEventCallbacks;
+	for (size_t i = 0; i < callbacks.size(); ++i)
+		callbacks[i](type);
+}
+
+
+// --------------------------------------------------------------------------
+// Plugin entry points
+
+typedef void (UNITY_INTERFACE_API * PluginLoadFunc)(IUnityInterfaces*);
+typedef void (UNITY_INTERFACE_API * PluginUnloadFunc)();
+typedef void (UNITY_INTERFACE_API * SetTimeFunc)(float);
+typedef void (UNITY_INTERFACE_API * SetTextureFunc)(void*, int, int);
+typedef void (UNITY_INTERFACE_API * SetMeshBuffersFunc)(void*, int, float*, float*, float*);
+typedef UnityRenderingEvent (UNITY_INTERFACE_API * GetRenderEventFuncFunc)();
+typedef void (UNITY_INTERFACE_API * SetRenderTextureFunc)(UnityRenderBuffer);
+typedef void (UNITY_INTERFACE_API * SetWorkerThreadCountFunc)(int);
+typedef void (UNITY_INTERFACE_API * SetTextureRingDepthFunc)(int);
+typedef int (UNITY_INTERFACE_API * GetTextureFramesBehindFunc)();
+typedef void (UNITY_INTERFACE_API * SetPluginTimingEnabledFunc)(int);
+typedef void (UNITY_INTERFACE_API * GetPluginTimingStatsFunc)(PluginTimingStats*);
+typedef void (UNITY_INTERFACE_API * ResetPluginTimingStatsFunc)();
+typedef const char* (UNITY_INTERFACE_API * GetPluginTimingStageNameFunc)(int);
+typedef void (UNITY_INTERFACE_API * SetPluginTracingEnabledFunc)(int);
+typedef int (UNITY_INTERFACE_API * WritePluginTraceFunc)(const char*);
+typedef void (UNITY_INTERFACE_API * SetPluginCacheDirectoryFunc)(const char*);
+typedef int (UNITY_INTERFACE_API * SavePluginCachesFunc)();
+typedef void (UNITY_INTERFACE_API * SetPluginSoftwareRenderingFunc)(int);
+
+struct PluginFunctions
+{
+	PluginLoadFunc UnityPluginLoad;
+	PluginUnloadFunc UnityPluginUnload;
+	SetTimeFunc SetTimeFromUnity;
+	SetTextureFunc SetTextureFromUnity;
+	SetMeshBuffersFunc SetMeshBuffersFromUnity;
+	GetRenderEventFuncFunc GetRenderEventFunc;
+	SetRenderTextureFunc SetRenderTexture;
+	SetWorkerThreadCountFunc SetWorkerThreadCountFromUnity;
+	SetTextureRingDepthFunc SetTextureRingDepthFromUnity;
+	GetTextureFramesBehindFunc GetTextureFramesBehind;
+	SetPluginTimingEnabledFunc SetPluginTimingEnabled;
+	GetPluginTimingStatsFunc GetPluginTimingStats;
+	ResetPluginTimingStatsFunc ResetPluginTimingStats;
+	GetPluginTimingStageNameFunc GetPluginTimingStageName;
+	SetPluginTracingEnabledFunc SetPluginTracingEnabled;
+	WritePluginTraceFunc WritePluginTrace;
+	SetPluginCacheDirectoryFunc SetPluginCacheDirectory;
+	SavePluginCachesFunc SavePluginCaches;
+	SetPluginSoftwareRenderingFunc SetPluginSoftwareRendering;
+};
+
+static bool LoadPlugin(const char* path, void** outLibrary, PluginFunctions* out)
+{
+	void* library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (!library)
+	{
+		fprintf(stderr, "Failed to load plugin '%s': %s\n", path, dlerror());
+		return false;
+	}
+
+#define LOAD_PLUGIN_FUNC(name) out->name = (decltype(out->name))dlsym(library, #name); \
+	if (!out->name) { fprintf(stderr, "Plugin '%s' does not export %s\n", path, #name); dlclose(library); return false; }
+	LOAD_PLUGIN_FUNC(UnityPluginLoad);
+	LOAD_PLUGIN_FUNC(UnityPluginUnload);
+	LOAD_PLUGIN_FUNC(SetTimeFromUnity);
+	LOAD_PLUGIN_FUNC(SetTextureFromUnity);
+	LOAD_PLUGIN_FUNC(SetMeshBuffersFromUnity);
+	LOAD_PLUGIN_FUNC(GetRenderEventFunc);
+	LOAD_PLUGIN_FUNC(SetRenderTexture);
+	LOAD_PLUGIN_FUNC(SetWorkerThreadCountFromUnity);
+	LOAD_PLUGIN_FUNC(SetTextureRingDepthFromUnity);
+	LOAD_PLUGIN_FUNC(GetTextureFramesBehind);
+	LOAD_PLUGIN_FUNC(SetPluginTimingEnabled);
+	LOAD_PLUGIN_FUNC(GetPluginTimingStats);
+	LOAD_PLUGIN_FUNC(ResetPluginTimingStats);
+	LOAD_PLUGIN_FUNC(GetPluginTimingStageName);
+	LOAD_PLUGIN_FUNC(SetPluginTracingEnabled);
+	LOAD_PLUGIN_FUNC(WritePluginTrace);
+	LOAD_PLUGIN_FUNC(SetPluginCacheDirectory);
+	LOAD_PLUGIN_FUNC(SavePluginCaches);
+	LOAD_PLUGIN_FUNC(SetPluginSoftwareRendering);
+#undef LOAD_PLUGIN_FUNC
+
+	*outLibrary = library;
+	return true;
+}
+
+
+// --------------------------------------------------------------------------
+// Test content: a texture and a grid mesh, like the sample scene provides
+
+struct HostMesh
+{
+	std::vector<float> vertices; // float3 per vertex
+	std::vector<float> normals; // float3 per vertex
+	std::vector<float> uvs; // float2 per vertex
+	int vertexCount;
+};
+
+static void CreateGridMesh(int vertexCount, HostMesh* mesh)
+{
+	const int side = std::max(2, int(sqrtf(float(vertexCount))));
+	mesh->vertexCount = vertexCount;
+	mesh->vertices.resize(vertexCount * 3);
+	mesh->normals.resize(vertexCount * 3);
+	mesh->uvs.resize(vertexCount * 2);
+	for (int i = 0; i < vertexCount; ++i)
+	{
+		const float u = float(i % side) / float(side - 1);
+		const float v = float(i / side) / float(side - 1);
+		mesh->vertices[i * 3 + 0] = u * 10.0f - 5.0f;
+		mesh->vertices[i * 3 + 1] = 0.0f;
+		mesh->vertices[i * 3 + 2] = v * 10.0f - 5.0f;
+		mesh->normals[i * 3 + 0] = 0.0f;
+		mesh->normals[i * 3 + 1] = 1.0f;
+		mesh->normals[i * 3 + 2] = 0.0f;
+		mesh->uvs[i * 2 + 0] = u;
+		mesh->uvs[i * 2 + 1] = v;
+	}
+}
+
+
+// Host side storage behind a SoftwareTexture handle
+struct HostTexture
+{
+	SoftwareTexture desc;
+	std::vector<unsigned char> pixels;
+};
+
+static void CreateHostTexture(int width, int height, HostTexture* texture)
+{
+	texture->pixels.assign(size_t(width) * height * 4, 0);
+	texture->desc.width = width;
+	texture->desc.height = height;
+	texture->desc.rowPitch = width * 4;
+	texture->desc.pixels = &texture->pixels[0];
+}
+
+// Writes the RGB channels of an RGBA8 image as a binary PPM
+static bool WritePPM(const char* path, const SoftwareTexture& texture)
+{
+	FILE* f = fopen(path, "wb");
+	if (!f)
+		return false;
+	fprintf(f, "P6\n%d %d\n255\n", texture.width, texture.height);
+	std::vector<unsigned char> row(texture.width * 3);
+	for (int y = 0; y < texture.height; ++y)
+	{
+		const unsigned char* src = texture.pixels + size_t(y) * texture.rowPitch;
+		for (int x = 0; x < texture.width; ++x)
+		{
+			row[x * 3 + 0] = src[x * 4 + 0];
+			row[x * 3 + 1] = src[x * 4 + 1];
+			row[x * 3 + 2] = src[x * 4 + 2];
+		}
+		fwrite(&row[0], 1, row.size(), f);
+	}
+	fclose(f);
+	return true;
+}
+
+
+// --------------------------------------------------------------------------
+// OpenGL device: an EGL context without a surface, and GL objects standing in for Unity's
+
+struct HostGLDevice
+{
+	EGLDisplay display;
+	EGLContext context;
+	GLuint texture; // passed to the plugin
+	GLuint vertexBuffer; // passed to the plugin
+	GLuint renderTarget; // color texture of the framebuffer the plugin draws into
+	GLuint depthBuffer;
+	GLuint framebuffer;
+};
+
+// Creates a GL 3.2 core (or ES 3.0) context on a surfaceless display, makes it current on this thread,
+// and creates the texture, vertex buffer and framebuffer; the framebuffer stays bound for the plugin
+static bool CreateGLDevice(bool es, int textureWidth, int textureHeight, int vertexCount, int targetWidth, int targetHeight, HostGLDevice* device)
+{
+	memset(device, 0, sizeof(*device));
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	device->display = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : EGL_NO_DISPLAY;
+	if (device->display == EGL_NO_DISPLAY)
+		device->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (device->display == EGL_NO_DISPLAY || !eglInitialize(device->display, &major, &minor))
+	{
+		fprintf(stderr, "Failed to initialize an EGL display\n");
+		return false;
+	}
+
+	const EGLint coreAttribs[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 2, EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+	const EGLint esAttribs[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 0, EGL_NONE };
+	eglBindAPI(es ? EGL_OPENGL_ES_API : EGL_OPENGL_API);
+	device->context = eglCreateContext(device->display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, es ? esAttribs : coreAttribs);
+	if (device->context == EGL_NO_CONTEXT || !eglMakeCurrent(device->display, EGL_NO_SURFACE, EGL_NO_SURFACE, device->context))
+	{
+		fprintf(stderr, "Failed to create an %s context without a surface (EGL error 0x%x)\n", es ? "OpenGL ES 3.0" : "OpenGL 3.2 core", eglGetError());
+		return false;
+	}
+
+	glGenTextures(1, &device->texture);
+	glBindTexture(GL_TEXTURE_2D, device->texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, textureWidth, textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+	glGenBuffers(1, &device->vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, device->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, std::max<size_t>(size_t(vertexCount) * sizeof(MeshVertex), 1), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glGenTextures(1, &device->renderTarget);
+	glBindTexture(GL_TEXTURE_2D, device->renderTarget);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, targetWidth, targetHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glGenRenderbuffers(1, &device->depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, device->depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, targetWidth, targetHeight);
+	glGenFramebuffers(1, &device->framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, device->framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, device->renderTarget, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, device->depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		fprintf(stderr, "Failed to create the GL render target\n");
+		return false;
+	}
+	glViewport(0, 0, targetWidth, targetHeight);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	printf("GL device: %s, %s\n", (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+	return glGetError() == GL_NO_ERROR;
+}
+
+static void DestroyGLDevice(HostGLDevice* device)
+{
+	if (device->context != EGL_NO_CONTEXT)
+	{
+		glDeleteFramebuffers(1, &device->framebuffer);
+		glDeleteRenderbuffers(1, &device->depthBuffer);
+		glDeleteTextures(1, &device->renderTarget);
+		glDeleteBuffers(1, &device->vertexBuffer);
+		glDeleteTextures(1, &device->texture);
+		eglMakeCurrent(device->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(device->display, device->context);
+	}
+	if (device->display != EGL_NO_DISPLAY)
+		eglTerminate(device->display);
+	memset(device, 0, sizeof(*device));
+}
+
+// GL call counter: the host defines the GL functions the plugin's GL backend uses, and is linked with
+// -rdynamic, so the plugin's calls land here first. Each one is counted, then forwarded to libGL.
+
+struct GLCallCount
+{
+	const char* name;
+	unsigned long long count;
+};
+static std::vector<GLCallCount>* s_GLCallCounts; // allocated by the first call
+
+static void* LookupGLFunction(const char* name, size_t* outIndex)
+{
+	if (!s_GLCallCounts)
+		s_GLCallCounts = new std::vector<GLCallCount>();
+	GLCallCount entry = { name, 0 };
+	*outIndex = s_GLCallCounts->size();
+	s_GLCallCounts->push_back(entry);
+	void* function = dlsym(RTLD_NEXT, name);
+	if (!function)
+	{
+		fprintf(stderr, "libGL does not export %s\n", name);
+		abort();
+	}
+	return function;
+}
+
+#define HOST_GL_FUNC(ret, name, params, args) \
+	extern "C" ret APIENTRY name params \
+	{ \
+		typedef ret (APIENTRY * Func) params; \
+		static size_t countIndex; \
+		static Func real = (Func)LookupGLFunction(#name, &countIndex); \
+		++(*s_GLCallCounts)[countIndex].count; \
+		return real args; \
+	}
+
+HOST_GL_FUNC(void, glAttachShader, (GLuint program, GLuint shader), (program, shader))
+HOST_GL_FUNC(void, glBindAttribLocation, (GLuint program, GLuint index, const GLchar* name), (program, index, name))
+HOST_GL_FUNC(void, glBindBuffer, (GLenum target, GLuint buffer), (target, buffer))
+HOST_GL_FUNC(void, glBindFragDataLocation, (GLuint program, GLuint color, const GLchar* name), (program, color, name))
+HOST_GL_FUNC(void, glBindTexture, (GLenum target, GLuint texture), (target, texture))
+HOST_GL_FUNC(void, glBindVertexArray, (GLuint array), (array))
+HOST_GL_FUNC(void, glBufferData, (GLenum target, GLsizeiptr size, const void* data, GLenum usage), (target, size, data, usage))
+HOST_GL_FUNC(void, glBufferStorage, (GLenum target, GLsizeiptr size, const void* data, GLbitfield flags), (target, size, data, flags))
+HOST_GL_FUNC(void, glBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void* data), (target, offset, size, data))
+HOST_GL_FUNC(GLenum, glClientWaitSync, (GLsync sync, GLbitfield flags, GLuint64 timeout), (sync, flags, timeout))
+HOST_GL_FUNC(void, glCompileShader, (GLuint shader), (shader))
+HOST_GL_FUNC(GLuint, glCreateProgram, (void), ())
+HOST_GL_FUNC(GLuint, glCreateShader, (GLenum type), (type))
+HOST_GL_FUNC(void, glDeleteBuffers, (GLsizei n, const GLuint* buffers), (n, buffers))
+HOST_GL_FUNC(void, glDeleteProgram, (GLuint program), (program))
+HOST_GL_FUNC(void, glDeleteShader, (GLuint shader), (shader))
+HOST_GL_FUNC(void, glDeleteSync, (GLsync sync), (sync))
+HOST_GL_FUNC(void, glDeleteVertexArrays, (GLsizei n, const GLuint* arrays), (n, arrays))
+HOST_GL_FUNC(void, glDepthFunc, (GLenum func), (func))
+HOST_GL_FUNC(void, glDepthMask, (GLboolean flag), (flag))
+HOST_GL_FUNC(void, glDisable, (GLenum cap), (cap))
+HOST_GL_FUNC(void, glDrawArrays, (GLenum mode, GLint first, GLsizei count), (mode, first, count))
+HOST_GL_FUNC(void, glEnable, (GLenum cap), (cap))
+HOST_GL_FUNC(void, glEnableVertexAttribArray, (GLuint index), (index))
+HOST_GL_FUNC(GLsync, glFenceSync, (GLenum condition, GLbitfield flags), (condition, flags))
+HOST_GL_FUNC(void, glGenBuffers, (GLsizei n, GLuint* buffers), (n, buffers))
+HOST_GL_FUNC(void, glGenVertexArrays, (GLsizei n, GLuint* arrays), (n, arrays))
+HOST_GL_FUNC(void, glGetBooleanv, (GLenum pname, GLboolean* data), (pname, data))
+HOST_GL_FUNC(void, glGetBufferParameteriv, (GLenum target, GLenum pname, GLint* params), (target, pname, params))
+HOST_GL_FUNC(GLenum, glGetError, (void), ())
+HOST_GL_FUNC(void, glGetIntegerv, (GLenum pname, GLint* data), (pname, data))
+HOST_GL_FUNC(void, glGetProgramBinary, (GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary), (program, bufSize, length, binaryFormat, binary))
+HOST_GL_FUNC(void, glGetProgramiv, (GLuint program, GLenum pname, GLint* params), (program, pname, params))
+HOST_GL_FUNC(GLint, glGetUniformLocation, (GLuint program, const GLchar* name), (program, name))
+HOST_GL_FUNC(GLboolean, glIsEnabled, (GLenum cap), (cap))
+HOST_GL_FUNC(void, glLinkProgram, (GLuint program), (program))
+HOST_GL_FUNC(void*, glMapBuffer, (GLenum target, GLenum access), (target, access))
+HOST_GL_FUNC(void*, glMapBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access), (target, offset, length, access))
+HOST_GL_FUNC(void, glProgramBinary, (GLuint program, GLenum binaryFormat, const void* binary, GLsizei length), (program, binaryFormat, binary, length))
+HOST_GL_FUNC(void, glProgramParameteri, (GLuint program, GLenum pname, GLint value), (program, pname, value))
+HOST_GL_FUNC(void, glShaderSource, (GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length), (shader, count, string, length))
+HOST_GL_FUNC(void, glTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels), (target, level, xoffset, yoffset, width, height, format, type, pixels))
+HOST_GL_FUNC(void, glUniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value), (location, count, transpose, value))
+HOST_GL_FUNC(GLboolean, glUnmapBuffer, (GLenum target), (target))
+HOST_GL_FUNC(void, glUseProgram, (GLuint program), (program))
+HOST_GL_FUNC(void, glVertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer), (index, size, type, normalized, stride, pointer))
+
+#undef HOST_GL_FUNC
+
+static void ResetGLCallCounts()
+{
+	for (size_t i = 0; s_GLCallCounts && i < s_GLCallCounts->size(); ++i)
+		(*s_GLCallCounts)[i].count = 0;
+}
+
+static bool CompareGLCallCounts(const GLCallCount& a, const GLCallCount& b)
+{
+	return a.count != b.count ? a.count > b.count : strcmp(a.name, b.name) < 0;
+}
+
+static void PrintGLCallCounts(int frames)
+{
+	std::vector<GLCallCount> counts;
+	unsigned long long total = 0;
+	unsigned long long queries = 0; // glGet* / glIs*: read back state, no work for the GPU
+	for (size_t i = 0; s_GLCallCounts && i < s_GLCallCounts->size(); ++i)
+	{
+		const GLCallCount& entry = (*s_GLCallCounts)[i];
+		if (entry.count == 0)
+			continue;
+		counts.push_back(entry);
+		total += entry.count;
+		if (strncmp(entry.name, "glGet", 5) == 0 || strncmp(entry.name, "glIs", 4) == 0)
+			queries += entry.count;
+	}
+	std::sort(counts.begin(), counts.end(), CompareGLCallCounts);
+	printf("GL calls per frame: %.2f, %.2f of them state queries\n", double(total) / double(frames), double(queries) / double(frames));
+	for (size_t i = 0; i < counts.size(); ++i)
+		printf("  %-36s %8.2f\n", counts[i].name, double(counts[i].count) / double(frames));
+}
+
+// Copies a GL texture into host memory, for --dump; rebinds the plugin's framebuffer after
+static void ReadGLTexture(const HostGLDevice& device, GLuint texture, HostTexture* out)
+{
+	GLuint framebuffer = 0;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, out->desc.width, out->desc.height, GL_RGBA, GL_UNSIGNED_BYTE, out->desc.pixels);
+	glBindFramebuffer(GL_FRAMEBUFFER, device.framebuffer);
+	glDeleteFramebuffers(1, &framebuffer);
+}
+
+
+// --------------------------------------------------------------------------
+// Command line & reporting
+
+struct HostOptions
+{
+	const char* pluginPath;
+	UnityGfxRenderer renderer;
+	int frames;
+	int warmupFrames;
+	int eventID;
+	int textureWidth;
+	int textureHeight;
+	int vertexCount;
+	int targetWidth;
+	int targetHeight;
+	int threadCount;
+	int ringDepth;
+	int fps; // 0: issue events back to back
+	int timing; // nonzero: enable the plugin's per stage timers and report them
+	const char* tracePath; // NULL: don't record a trace
+	const char* dumpPrefix;
+	const char* cacheDirectory; // NULL: the plugin keeps no caches
+	int benchPlasmaWidth; // 0 if not benchmarking kernels
+	int benchPlasmaHeight;
+	int benchVertexCount; // 0 if not benchmarking vertex kernels
+};
+
+static void PrintUsage()
+{
+	printf(
+		"usage: HeadlessHost [options]\n"
+		"  --plugin <path>      plugin library to load (default ./libRenderingPlugin.so)\n"
+		"  --renderer <name>    null (software), gl (OpenGL core) or gles (OpenGL ES 3.0); GL uses EGL without a window (default null)\n"
+		"  --frames <n>         number of measured frames (default 1000)\n"
+		"  --warmup <n>         frames run before measuring (default 10)\n"
+		"  --event <id>         render event ID to issue each frame (default 1)\n"
+		"  --texture <w>x<h>    size of the texture passed to the plugin (default 256x256)\n"
+		"  --vertices <n>       vertex count of the mesh passed to the plugin (default 4096)\n"
+		"  --target <w>x<h>     size of the render target for DrawSimpleTriangles (default 256x256)\n"
+		"  --threads <n>        plugin worker thread count incl. the render thread (default 0: one per core)\n"
+		"  --fps <n>            pace frames like a player running at n frames/sec (default 0: as fast as possible)\n"
+		"  --ring <n>           generate the texture ahead of time into n CPU buffers (default 0: in the render event)\n"
+		"  --timing <0|1>       time each stage inside the plugin and report it (default 0)\n"
+		"  --trace <file>       record the measured frames inside the plugin, write them as Chrome trace JSON\n"
+		"  --dump <prefix>      write <prefix>_texture.ppm and <prefix>_target.ppm after the last frame\n"
+		"  --cache-dir <dir>    have the plugin keep compiled shaders / pipelines in dir between runs\n"
+		"  --bench-plasma <w>x<h>  don't load the plugin; check and time each plasma kernel on a w x h image\n"
+		"  --bench-vertices <n>    don't load the plugin; check and time each vertex wave kernel on n vertices\n");
+}
+
+static bool ParseOptions(int argc, char** argv, HostOptions* opt)
+{
+	opt->pluginPath = "./libRenderingPlugin.so";
+	opt->renderer = kUnityGfxRendererNull;
+	opt->frames = 1000;
+	opt->warmupFrames = 10;
+	opt->eventID = 1;
+	opt->textureWidth = 256;
+	opt->textureHeight = 256;
+	opt->vertexCount = 4096;
+	opt->targetWidth = 256;
+	opt->targetHeight = 256;
+	opt->threadCount = 0;
+	opt->ringDepth = 0;
+	opt->fps = 0;
+	opt->timing = 0;
+	opt->tracePath = NULL;
+	opt->dumpPrefix = NULL;
+	opt->cacheDirectory = NULL;
+	opt->benchPlasmaWidth = 0;
+	opt->benchPlasmaHeight = 0;
+	opt->benchVertexCount = 0;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+		if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
+			return false;
+		if (!value)
+		{
+			fprintf(stderr, "Missing value for %s\n", arg);
+			return false;
+		}
+		++i;
+		if (strcmp(arg, "--plugin") == 0)
+			opt->pluginPath = value;
+		else if (strcmp(arg, "--renderer") == 0)
+		{
+			if (strcmp(value, "null") == 0)
+				opt->renderer = kUnityGfxRendererNull;
+			else if (strcmp(value, "gl") == 0)
+				opt->renderer = kUnityGfxRendererOpenGLCore;
+			else if (strcmp(value, "gles") == 0)
+				opt->renderer = kUnityGfxRendererOpenGLES30;
+			else
+			{
+				fprintf(stderr, "Unknown renderer '%s'\n", value);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--frames") == 0)
+			opt->frames = atoi(value);
+		else if (strcmp(arg, "--warmup") == 0)
+			opt->warmupFrames = atoi(value);
+		else if (strcmp(arg, "--event") == 0)
+			opt->eventID = atoi(value);
+		else if (strcmp(arg, "--texture") == 0)
+		{
+			if (sscanf(value, "%dx%d", &opt->textureWidth, &opt->textureHeight) != 2)
+			{
+				fprintf(stderr, "Invalid texture size '%s'\n", value);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--vertices") == 0)
+			opt->vertexCount = atoi(value);
+		else if (strcmp(arg, "--target") == 0)
+		{
+			if (sscanf(value, "%dx%d", &opt->targetWidth, &opt->targetHeight) != 2)
+			{
+				fprintf(stderr, "Invalid render target size '%s'\n", value);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--threads") == 0)
+			opt->threadCount = atoi(value);
+		else if (strcmp(arg, "--fps") == 0)
+			opt->fps = atoi(value);
+		else if (strcmp(arg, "--ring") == 0)
+			opt->ringDepth = atoi(value);
+		else if (strcmp(arg, "--timing") == 0)
+			opt->timing = atoi(value);
+		else if (strcmp(arg, "--trace") == 0)
+			opt->tracePath = value;
+		else if (strcmp(arg, "--dump") == 0)
+			opt->dumpPrefix = value;
+		else if (strcmp(arg, "--cache-dir") == 0)
+			opt->cacheDirectory = value;
+		else if (strcmp(arg, "--bench-plasma") == 0)
+		{
+			if (sscanf(value, "%dx%d", &opt->benchPlasmaWidth, &opt->benchPlasmaHeight) != 2 || opt->benchPlasmaWidth <= 0 || opt->benchPlasmaHeight <= 0)
+			{
+				fprintf(stderr, "Invalid plasma benchmark size '%s'\n", value);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--bench-vertices") == 0)
+		{
+			opt->benchVertexCount = atoi(value);
+			if (opt->benchVertexCount <= 0)
+			{
+				fprintf(stderr, "Invalid vertex benchmark count '%s'\n", value);
+				return false;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s\n", arg);
+			return false;
+		}
+	}
+	return opt->frames > 0 && opt->warmupFrames >= 0 && opt->threadCount >= 0 && opt->fps >= 0 && opt->textureWidth > 0 && opt->textureHeight > 0 && opt->vertexCount >= 0
+		&& opt->targetWidth > 0 && opt->targetHeight > 0;
+}
+
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty())
+		return 0.0;
+	size_t index = size_t(p * double(sorted.size() - 1) + 0.5);
+	return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static void PrintLatencyReport(const char* name, std::vector<double> samplesUs, double wallSeconds)
+{
+	std::sort(samplesUs.begin(), samplesUs.end());
+	double sum = 0.0;
+	for (size_t i = 0; i < samplesUs.size(); ++i)
+		sum += samplesUs[i];
+
+	printf("%s: %d events\n", name, int(samplesUs.size()));
+	printf("  latency us: min %.2f  p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f  mean %.2f\n",
+		samplesUs.front(), Percentile(samplesUs, 0.50), Percentile(samplesUs, 0.90), Percentile(samplesUs, 0.99),
+		Percentile(samplesUs, 0.999), samplesUs.back(), sum / double(samplesUs.size()));
+	printf("  frames/sec: %.1f\n", double(samplesUs.size()) / wallSeconds);
+}
+
+static void PrintStageTimings(const PluginFunctions& plugin)
+{
+	PluginTimingStats stats;
+	plugin.GetPluginTimingStats(&stats);
+	printf("plugin stages (us):\n");
+	printf("  %-36s %8s %10s %10s %10s %10s %10s\n", "stage", "count", "mean", "p50", "p99", "min", "max");
+	for (int i = 0; i < stats.stageCount; ++i)
+	{
+		const PluginStageTiming& stage = stats.stages[i];
+		if (stage.count == 0)
+			continue;
+		printf("  %-36s %8llu %10.2f %10.2f %10.2f %10.2f %10.2f\n", plugin.GetPluginTimingStageName(i), stage.count,
+			double(stage.totalNs) / double(stage.count) / 1000.0, double(stage.p50Ns) / 1000.0, double(stage.p99Ns) / 1000.0,
+			double(stage.minNs) / 1000.0, double(stage.maxNs) / 1000.0);
+	}
+}
+
+
+// --------------------------------------------------------------------------
+// Kernel benchmarks
+
+// Compares every plasma kernel the CPU supports against the plain C one, then times them.
+// Returns false if some kernel is off by more than one.
+static bool BenchPlasmaKernels(int width, int height)
+{
+	typedef std::chrono::steady_clock Clock;
+	const int rowPitch = width * 4;
+	std::vector<unsigned char> reference(size_t(rowPitch) * height);
+	std::vector<unsigned char> pixels(reference.size());
+	PlasmaFillFunc scalar = GetPlasmaKernel(kPlasmaKernelScalar);
+
+	// Includes large time values, where the range reduction of the approximate sine matters
+	static const float kTimes[] = { 0.0f, 0.064f, 1.7f, -3.3f, 250.0f, 4000.0f };
+	const int timeCount = int(sizeof(kTimes) / sizeof(kTimes[0]));
+
+	printf("plasma kernels, %dx%d, best for this CPU: %s\n", width, height, GetPlasmaKernelISAName(GetBestPlasmaKernelISA()));
+	bool allOk = true;
+	for (int isa = 0; isa < kPlasmaKernelCount; ++isa)
+	{
+		const char* name = GetPlasmaKernelISAName(PlasmaKernelISA(isa));
+		PlasmaFillFunc fill = GetPlasmaKernel(PlasmaKernelISA(isa));
+		if (!fill)
+		{
+			printf("  %-8s not supported\n", name);
+			continue;
+		}
+
+		int maxDiff = 0;
+		size_t mismatches = 0;
+		for (int i = 0; i < timeCount; ++i)
+		{
+			scalar(&reference[0], rowPitch, 0, 0, width, height, kTimes[i]);
+			fill(&pixels[0], rowPitch, 0, 0, width, height, kTimes[i]);
+			for (size_t j = 0; j < pixels.size(); ++j)
+			{
+				const int diff = abs(int(pixels[j]) - int(reference[j]));
+				maxDiff = std::max(maxDiff, diff);
+				if (diff != 0)
+					++mismatches;
+			}
+		}
+		const bool ok = maxDiff <= 1;
+		allOk = allOk && ok;
+
+		// Repeat for at least half a second, report the best run
+		double bestSeconds = 1.0e30;
+		double totalSeconds = 0.0;
+		int runs = 0;
+		while (runs < 3 || totalSeconds < 0.5)
+		{
+			const Clock::time_point start = Clock::now();
+			fill(&pixels[0], rowPitch, 0, 0, width, height, float(runs) * 0.064f);
+			const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+			bestSeconds = std::min(bestSeconds, seconds);
+			totalSeconds += seconds;
+			++runs;
+		}
+		const double pixelCount = double(width) * double(height);
+		printf("  %-8s max diff %d, %.4f%% bytes differ %s  |  %.3f pixels/ns (best), %.3f (mean of %d), %.3f ms/image\n",
+			name, maxDiff, 100.0 * double(mismatches) / (double(pixels.size()) * timeCount), ok ? "OK" : "FAILED",
+			pixelCount / (bestSeconds * 1.0e9), pixelCount * runs / (totalSeconds * 1.0e9), runs, bestSeconds * 1000.0);
+	}
+
+	// Same for the cached tables the plugin uses; per frame time includes updating the tables
+	PlasmaPlan plan;
+	const Clock::time_point buildStart = Clock::now();
+	plan.Build(width, height);
+	const double buildSeconds = std::chrono::duration<double>(Clock::now() - buildStart).count();
+	int maxDiff = 0;
+	size_t mismatches = 0;
+	for (int i = 0; i < timeCount; ++i)
+	{
+		scalar(&reference[0], rowPitch, 0, 0, width, height, kTimes[i]);
+		plan.Update(kTimes[i]);
+		plan.Fill(&pixels[0], rowPitch, 0, 0, width, height);
+		for (size_t j = 0; j < pixels.size(); ++j)
+		{
+			const int diff = abs(int(pixels[j]) - int(reference[j]));
+			maxDiff = std::max(maxDiff, diff);
+			if (diff != 0)
+				++mismatches;
+		}
+	}
+	const bool ok = maxDiff <= 1;
+	allOk = allOk && ok;
+	double bestSeconds = 1.0e30;
+	double totalSeconds = 0.0;
+	int runs = 0;
+	while (runs < 3 || totalSeconds < 0.5)
+	{
+		const Clock::time_point start = Clock::now();
+		plan.Update(float(runs) * 0.064f);
+		plan.Fill(&pixels[0], rowPitch, 0, 0, width, height);
+		const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		bestSeconds = std::min(bestSeconds, seconds);
+		totalSeconds += seconds;
+		++runs;
+	}
+	const double pixelCount = double(width) * double(height);
+	printf("  %-8s max diff %d, %.4f%% bytes differ %s  |  %.3f pixels/ns (best), %.3f (mean of %d), %.3f ms/image\n",
+		"plan", maxDiff, 100.0 * double(mismatches) / (double(pixels.size()) * timeCount), ok ? "OK" : "FAILED",
+		pixelCount / (bestSeconds * 1.0e9), pixelCount * runs / (totalSeconds * 1.0e9), runs, bestSeconds * 1000.0);
+	printf("  plan tables: %.1f MB, built in %.3f ms\n", double(plan.GetMemorySize()) / (1024.0 * 1024.0), buildSeconds * 1000.0);
+	return allOk;
+}
+
+// Same for the vertex wave kernels, on a grid mesh like the one the plugin gets, once with the source
+// mesh as separate streams (what the plugin uses) and once as an array of vertices. Returns false if
+// some kernel moves a vertex more than 1e-4 away from the plain C result, or changes anything else.
+static bool BenchVertexKernels(int vertexCount)
+{
+	typedef std::chrono::steady_clock Clock;
+	HostMesh mesh;
+	CreateGridMesh(vertexCount, &mesh);
+	MeshSource source;
+	source.Set(vertexCount, &mesh.vertices[0], &mesh.normals[0], &mesh.uvs[0]);
+	std::vector<MeshVertex> sourceAoS(vertexCount);
+	for (int i = 0; i < vertexCount; ++i)
+	{
+		MeshVertex& v = sourceAoS[i];
+		memcpy(v.pos, &mesh.vertices[i * 3], sizeof(v.pos));
+		memcpy(v.normal, &mesh.normals[i * 3], sizeof(v.normal));
+		memcpy(v.uv, &mesh.uvs[i * 2], sizeof(v.uv));
+		v.color[0] = v.color[1] = v.color[2] = v.color[3] = 0.5f;
+	}
+	std::vector<MeshVertex> reference(sourceAoS);
+	std::vector<MeshVertex> vertices(sourceAoS);
+	VertexWaveFunc scalar = GetVertexWaveKernel(kVertexKernelScalar);
+
+	static const float kTimes[] = { 0.0f, 0.048f, 1.7f, -3.3f, 250.0f, 4000.0f };
+	const int timeCount = int(sizeof(kTimes) / sizeof(kTimes[0]));
+
+	printf("vertex kernels, %d vertices, best for this CPU: %s\n", vertexCount, GetVertexKernelISAName(GetBestVertexKernelISA()));
+	bool allOk = true;
+	for (int layout = 0; layout < 2; ++layout)
+	{
+		const bool soa = layout == 0;
+		printf(soa ? "  source as streams (%.1f MB):\n" : "  source as array of vertices (%.1f MB):\n",
+			double(soa ? source.GetMemorySize() : sourceAoS.size() * sizeof(MeshVertex)) / (1024.0 * 1024.0));
+		for (int isa = 0; isa < kVertexKernelCount; ++isa)
+		{
+			const char* name = GetVertexKernelISAName(VertexKernelISA(isa));
+			VertexWaveFunc wave = GetVertexWaveKernel(VertexKernelISA(isa));
+			VertexWaveAoSFunc waveAoS = GetVertexWaveAoSKernel(VertexKernelISA(isa));
+			if (soa ? !wave : !waveAoS)
+			{
+				printf("    %-8s not supported\n", name);
+				continue;
+			}
+
+			float maxDiff = 0.0f;
+			bool otherDataOk = true;
+			for (int i = 0; i < timeCount; ++i)
+			{
+				scalar(source, &reference[0], 0, vertexCount, kTimes[i]);
+				if (soa)
+					wave(source, &vertices[0], 0, vertexCount, kTimes[i]);
+				else
+					waveAoS(&sourceAoS[0], &vertices[0], 0, vertexCount, kTimes[i]);
+				for (int j = 0; j < vertexCount; ++j)
+				{
+					maxDiff = std::max(maxDiff, fabsf(vertices[j].pos[1] - reference[j].pos[1]));
+					MeshVertex expected = reference[j];
+					expected.pos[1] = vertices[j].pos[1];
+					if (memcmp(&expected, &vertices[j], sizeof(MeshVertex)) != 0)
+						otherDataOk = false;
+				}
+			}
+			const bool ok = maxDiff <= 1.0e-4f && otherDataOk;
+			allOk = allOk && ok;
+
+			double bestSeconds = 1.0e30;
+			double totalSeconds = 0.0;
+			int runs = 0;
+			while (runs < 3 || totalSeconds < 0.5)
+			{
+				const float t = float(runs) * 0.048f;
+				const Clock::time_point start = Clock::now();
+				if (soa)
+					wave(source, &vertices[0], 0, vertexCount, t);
+				else
+					waveAoS(&sourceAoS[0], &vertices[0], 0, vertexCount, t);
+				const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+				bestSeconds = std::min(bestSeconds, seconds);
+				totalSeconds += seconds;
+				++runs;
+			}
+			printf("    %-8s max diff %.2g%s %s  |  %.3f vertices/ns (best), %.3f (mean of %d), %.3f ms/mesh\n",
+				name, maxDiff, otherDataOk ? "" : ", other data changed", ok ? "OK" : "FAILED",
+				double(vertexCount) / (bestSeconds * 1.0e9), double(vertexCount) * runs / (totalSeconds * 1.0e9), runs, bestSeconds * 1000.0);
+		}
+	}
+	return allOk;
+}
+
+
+// --------------------------------------------------------------------------
+// main
+
+int main(int argc, char** argv)
+{
+	HostOptions opt;
+	if (!ParseOptions(argc, argv, &opt))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (opt.benchPlasmaWidth > 0)
+		return BenchPlasmaKernels(opt.benchPlasmaWidth, opt.benchPlasmaHeight) ? 0 : 1;
+	if (opt.benchVertexCount > 0)
+		return BenchVertexKernels(opt.benchVertexCount) ? 0 : 1;
+
+	void* library = NULL;
+	PluginFunctions plugin;
+	if (!LoadPlugin(opt.pluginPath, &library, &plugin))
+		return 1;
+
+	// A GL context has to be current before the plugin is loaded, like in Unity: the plugin creates
+	// its resources in the initialize device event, from UnityPluginLoad
+	const bool useGL = opt.renderer != kUnityGfxRendererNull;
+	HostGLDevice glDevice;
+	memset(&glDevice, 0, sizeof(glDevice));
+	if (useGL && !CreateGLDevice(opt.renderer == kUnityGfxRendererOpenGLES30, opt.textureWidth, opt.textureHeight, opt.vertexCount, opt.targetWidth, opt.targetHeight, &glDevice))
+	{
+		DestroyGLDevice(&glDevice);
+		dlclose(library);
+		return 1;
+	}
+	s_Renderer = opt.renderer;
+
+	InitUnityGraphics();
+	s_UnityInterfaces.Register<IUnityGraphics>(&s_UnityGraphics);
+
+	// Same order of calls as Unity + UseRenderingPlugin.cs. The plugin initializes the device in
+	// UnityPluginLoad, but may leave part of that to the first frame (e.g. waiting for shaders the driver
+	// compiles on threads of its own); both are timed.
+	typedef std::chrono::steady_clock Clock;
+	// The host passes SoftwareTexture / SoftwareBuffer pointers to the "null" device below, so it has to
+	// tell the plugin that it may use them before the device is initialized
+	plugin.SetPluginSoftwareRendering(useGL ? 0 : 1);
+	const Clock::time_point loadStart = Clock::now();
+	plugin.UnityPluginLoad(&s_UnityInterfaces);
+	const double loadMs = std::chrono::duration<double, std::milli>(Clock::now() - loadStart).count();
+	plugin.SetWorkerThreadCountFromUnity(opt.threadCount);
+	plugin.SetTextureRingDepthFromUnity(opt.ringDepth);
+	if (opt.cacheDirectory)
+		plugin.SetPluginCacheDirectory(opt.cacheDirectory);
+
+	// The "null" device uses the software RenderAPI, which takes SoftwareTexture / SoftwareBuffer
+	// pointers as native resource handles; GL takes object names. On GL the host textures only
+	// receive the images for --dump.
+	HostTexture texture;
+	CreateHostTexture(opt.textureWidth, opt.textureHeight, &texture);
+	plugin.SetTextureFromUnity(useGL ? (void*)(size_t)glDevice.texture : (void*)&texture.desc, opt.textureWidth, opt.textureHeight);
+
+	HostTexture renderTarget;
+	CreateHostTexture(opt.targetWidth, opt.targetHeight, &renderTarget);
+	plugin.SetRenderTexture(useGL ? NULL : (UnityRenderBuffer)&renderTarget.desc);
+
+	HostMesh mesh;
+	CreateGridMesh(opt.vertexCount, &mesh);
+	std::vector<unsigned char> vertexData(size_t(opt.vertexCount) * sizeof(MeshVertex));
+	SoftwareBuffer vertexBuffer = { vertexData.empty() ? NULL : &vertexData[0], vertexData.size() };
+	if (opt.vertexCount > 0)
+		plugin.SetMeshBuffersFromUnity(useGL ? (void*)(size_t)glDevice.vertexBuffer : (void*)&vertexBuffer, mesh.vertexCount, &mesh.vertices[0], &mesh.normals[0], &mesh.uvs[0]);
+
+	UnityRenderingEvent renderEvent = plugin.GetRenderEventFunc();
+
+	printf("plugin %s, renderer %d, texture %dx%d, %d vertices, event %d, %d threads, texture ring %d\n",
+		opt.pluginPath, int(s_Renderer), opt.textureWidth, opt.textureHeight, opt.vertexCount, opt.eventID, opt.threadCount, opt.ringDepth);
+
+	int frameCounter = 0;
+	double firstFrameMs = 0.0;
+	for (int i = 0; i < opt.warmupFrames; ++i)
+	{
+		plugin.SetTimeFromUnity(float(++frameCounter) * 0.016f);
+		const Clock::time_point start = Clock::now();
+		renderEvent(opt.eventID);
+		if (i == 0)
+			firstFrameMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+	plugin.SetPluginTimingEnabled(opt.timing);
+	plugin.ResetPluginTimingStats();
+	ResetGLCallCounts();
+	plugin.SetPluginTracingEnabled(opt.tracePath != NULL);
+
+	std::vector<double> latenciesUs;
+	latenciesUs.reserve(opt.frames);
+	long long framesBehindSum = 0;
+	int framesBehindMax = 0;
+	const Clock::time_point wallStart = Clock::now();
+	Clock::time_point nextFrame = wallStart;
+	for (int i = 0; i < opt.frames; ++i)
+	{
+		if (opt.fps > 0)
+		{
+			// The rest of the frame is idle time, which other threads (e.g. the plugin's) can use
+			std::this_thread::sleep_until(nextFrame);
+			nextFrame += std::chrono::microseconds(1000000 / opt.fps);
+		}
+		plugin.SetTimeFromUnity(float(++frameCounter) * 0.016f);
+		const Clock::time_point start = Clock::now();
+		renderEvent(opt.eventID);
+		const Clock::time_point end = Clock::now();
+		latenciesUs.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+		const int framesBehind = plugin.GetTextureFramesBehind();
+		framesBehindSum += framesBehind;
+		framesBehindMax = std::max(framesBehindMax, framesBehind);
+	}
+	const double wallSeconds = std::chrono::duration<double>(Clock::now() - wallStart).count();
+	plugin.SetPluginTracingEnabled(0);
+
+	PrintLatencyReport("OnRenderEvent", latenciesUs, wallSeconds);
+	if (opt.warmupFrames == 0)
+		firstFrameMs = latenciesUs[0] / 1000.0;
+	printf("  init ms: plugin load %.2f  first frame %.2f\n", loadMs, firstFrameMs);
+	printf("  texture frames behind: mean %.2f  max %d\n", double(framesBehindSum) / double(opt.frames), framesBehindMax);
+	if (opt.timing)
+		PrintStageTimings(plugin);
+	if (useGL)
+		PrintGLCallCounts(opt.frames);
+	if (opt.tracePath && !plugin.WritePluginTrace(opt.tracePath))
+		fprintf(stderr, "Failed to write trace '%s'\n", opt.tracePath);
+
+	if (opt.dumpPrefix)
+	{
+		if (useGL)
+		{
+			ReadGLTexture(glDevice, glDevice.texture, &texture);
+			ReadGLTexture(glDevice, glDevice.renderTarget, &renderTarget);
+		}
+		std::string texturePath = std::string(opt.dumpPrefix) + "_texture.ppm";
+		std::string targetPath = std::string(opt.dumpPrefix) + "_target.ppm";
+		if (!WritePPM(texturePath.c_str(), texture.desc) || !WritePPM(targetPath.c_str(), renderTarget.desc))
+			fprintf(stderr, "Failed to write images with prefix '%s'\n", opt.dumpPrefix);
+	}
+
+	if (opt.cacheDirectory)
+	{
+		renderEvent(4);
+		if (!plugin.SavePluginCaches())
+			fprintf(stderr, "Failed to write plugin caches to '%s'\n", opt.cacheDirectory);
+	}
+
+	SendDeviceEvent(kUnityGfxDeviceEventShutdown);
+	plugin.UnityPluginUnload();
+	dlclose(library);
+	DestroyGLDevice(&glDevice);
+	return 0;
+}
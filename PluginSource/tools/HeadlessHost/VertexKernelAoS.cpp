@@ -0,0 +1,149 @@
+#include "VertexKernelAoS.h"
+#include "CpuFeatures.h"
+#include "PlatformBase.h"
+#include "SimdMath.h"
+
+#include <math.h>
+
+
+static inline void WriteVertexAoS(const MeshVertex& src, MeshVertex& dst, float y)
+{
+	dst.pos[0] = src.pos[0];
+	dst.pos[1] = y;
+	dst.pos[2] = src.pos[2];
+	dst.normal[0] = src.normal[0];
+	dst.normal[1] = src.normal[1];
+	dst.normal[2] = src.normal[2];
+	dst.uv[0] = src.uv[0];
+	dst.uv[1] = src.uv[1];
+}
+
+static void VertexWaveAoSScalar(const MeshVertex* src, MeshVertex* dst, int begin, int end, float t)
+{
+	for (int i = begin; i < end; ++i)
+	{
+		const MeshVertex& s = src[i];
+		WriteVertexAoS(s, dst[i], s.pos[1] + sinf(s.pos[0] * 1.1f + t) * 0.4f + sinf(s.pos[2] * 0.9f - t) * 0.3f);
+	}
+}
+
+
+// The vectorized versions have to pick x, y and z out of every 12 floats to fill their registers.
+
+#if SUPPORT_SSE2
+
+static inline __m128 LoadPositionComponentAoSSSE2(const MeshVertex* v, int component)
+{
+	return _mm_setr_ps(v[0].pos[component], v[1].pos[component], v[2].pos[component], v[3].pos[component]);
+}
+
+static inline __m128 WaveYAoSSSE2(const MeshVertex* v, __m128 t)
+{
+	const __m128 x = LoadPositionComponentAoSSSE2(v, 0);
+	const __m128 y = LoadPositionComponentAoSSSE2(v, 1);
+	const __m128 z = LoadPositionComponentAoSSSE2(v, 2);
+	const __m128 s0 = SinApproxSSE2(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.1f)), t));
+	const __m128 s1 = SinApproxSSE2(_mm_sub_ps(_mm_mul_ps(z, _mm_set1_ps(0.9f)), t));
+	return _mm_add_ps(y, _mm_add_ps(_mm_mul_ps(s0, _mm_set1_ps(0.4f)), _mm_mul_ps(s1, _mm_set1_ps(0.3f))));
+}
+
+static void VertexWaveAoSSSE2(const MeshVertex* src, MeshVertex* dst, int begin, int end, float t)
+{
+	const __m128 vt = _mm_set1_ps(t);
+	int i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		float y[8];
+		_mm_storeu_ps(y, WaveYAoSSSE2(src + i, vt));
+		_mm_storeu_ps(y + 4, WaveYAoSSSE2(src + i + 4, vt));
+		for (int k = 0; k < 8; ++k)
+			WriteVertexAoS(src[i + k], dst[i + k], y[k]);
+	}
+	VertexWaveAoSScalar(src, dst, i, end, t);
+}
+
+#endif // #if SUPPORT_SSE2
+
+
+#if SUPPORT_AVX2
+
+SIMD_TARGET_AVX2 static void VertexWaveAoSAVX2(const MeshVertex* src, MeshVertex* dst, int begin, int end, float t)
+{
+	const int kFloatsPerVertex = int(sizeof(MeshVertex) / sizeof(float));
+	const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(kFloatsPerVertex));
+	const __m256 vt = _mm256_set1_ps(t);
+	int i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		const __m256 x = _mm256_i32gather_ps(&src[i].pos[0], offsets, 4);
+		const __m256 y = _mm256_i32gather_ps(&src[i].pos[1], offsets, 4);
+		const __m256 z = _mm256_i32gather_ps(&src[i].pos[2], offsets, 4);
+		const __m256 s0 = SinApproxAVX2(_mm256_fmadd_ps(x, _mm256_set1_ps(1.1f), vt));
+		const __m256 s1 = SinApproxAVX2(_mm256_fmsub_ps(z, _mm256_set1_ps(0.9f), vt));
+		float newY[8];
+		_mm256_storeu_ps(newY, _mm256_fmadd_ps(s1, _mm256_set1_ps(0.3f), _mm256_fmadd_ps(s0, _mm256_set1_ps(0.4f), y)));
+		for (int k = 0; k < 8; ++k)
+			WriteVertexAoS(src[i + k], dst[i + k], newY[k]);
+	}
+	VertexWaveAoSScalar(src, dst, i, end, t);
+}
+
+#endif // #if SUPPORT_AVX2
+
+
+#if SUPPORT_NEON
+
+static inline float32x4_t WaveYAoSNEON(const MeshVertex* v, float32x4_t t)
+{
+	// De-interleave x, y, z of 4 vertices: each vertex is 12 floats
+	float32x4_t x = vdupq_n_f32(0.0f), y = x, z = x;
+	x = vld1q_lane_f32(&v[0].pos[0], x, 0); y = vld1q_lane_f32(&v[0].pos[1], y, 0); z = vld1q_lane_f32(&v[0].pos[2], z, 0);
+	x = vld1q_lane_f32(&v[1].pos[0], x, 1); y = vld1q_lane_f32(&v[1].pos[1], y, 1); z = vld1q_lane_f32(&v[1].pos[2], z, 1);
+	x = vld1q_lane_f32(&v[2].pos[0], x, 2); y = vld1q_lane_f32(&v[2].pos[1], y, 2); z = vld1q_lane_f32(&v[2].pos[2], z, 2);
+	x = vld1q_lane_f32(&v[3].pos[0], x, 3); y = vld1q_lane_f32(&v[3].pos[1], y, 3); z = vld1q_lane_f32(&v[3].pos[2], z, 3);
+	const float32x4_t s0 = SinApproxNEON(vmlaq_n_f32(t, x, 1.1f));
+	const float32x4_t s1 = SinApproxNEON(vsubq_f32(vmulq_n_f32(z, 0.9f), t));
+	return vmlaq_n_f32(vmlaq_n_f32(y, s0, 0.4f), s1, 0.3f);
+}
+
+static void VertexWaveAoSNEON(const MeshVertex* src, MeshVertex* dst, int begin, int end, float t)
+{
+	const float32x4_t vt = vdupq_n_f32(t);
+	int i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		float y[8];
+		vst1q_f32(y, WaveYAoSNEON(src + i, vt));
+		vst1q_f32(y + 4, WaveYAoSNEON(src + i + 4, vt));
+		for (int k = 0; k < 8; ++k)
+			WriteVertexAoS(src[i + k], dst[i + k], y[k]);
+	}
+	VertexWaveAoSScalar(src, dst, i, end, t);
+}
+
+#endif // #if SUPPORT_NEON
+
+
+VertexWaveAoSFunc GetVertexWaveAoSKernel(VertexKernelISA isa)
+{
+	const unsigned int features = GetCpuFeatures();
+	switch (isa)
+	{
+	case kVertexKernelScalar:
+		return VertexWaveAoSScalar;
+#	if SUPPORT_SSE2
+	case kVertexKernelSSE2:
+		return (features & kCpuFeatureSSE2) ? VertexWaveAoSSSE2 : NULL;
+#	endif
+#	if SUPPORT_AVX2
+	case kVertexKernelAVX2:
+		return (features & kCpuFeatureAVX2) ? VertexWaveAoSAVX2 : NULL;
+#	endif
+#	if SUPPORT_NEON
+	case kVertexKernelNEON:
+		return (features & kCpuFeatureNEON) ? VertexWaveAoSNEON : NULL;
+#	endif
+	default:
+		return NULL;
+	}
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// The plugin's vertex wave (VertexKernel.h) with the source mesh as an array of MeshVertex, the way the
+// plugin used to keep it. Only HeadlessHost --bench-vertices uses these, to compare the two layouts.
+
+#include "VertexKernel.h"
+
+typedef void (*VertexWaveAoSFunc)(const MeshVertex* src, MeshVertex* dst, int begin, int end, float t);
+
+// Returns NULL if the kernel is not compiled in, or the CPU does not support it.
+VertexWaveAoSFunc GetVertexWaveAoSKernel(VertexKernelISA isa);
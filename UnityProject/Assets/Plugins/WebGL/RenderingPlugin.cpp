@@ -2,3 +2,9 @@
 #include "../../../../PluginSource/source/RenderingPlugin.cpp"
 #include "../../../../PluginSource/source/RenderAPI.cpp"
 #include "../../../../PluginSource/source/RenderAPI_OpenGLCoreES.cpp"
+#include "../../../../PluginSource/source/CpuFeatures.cpp"
+#include "../../../../PluginSource/source/PlasmaKernel.cpp"
+#include "../../../../PluginSource/source/PluginThreadPool.cpp"
+#include "../../../../PluginSource/source/TextureProducer.cpp"
+#include "../../../../PluginSource/source/PluginProfiling.cpp"
+#include "../../../../PluginSource/source/VertexKernel.cpp"
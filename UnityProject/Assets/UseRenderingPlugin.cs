@@ -47,6 +47,150 @@ public class UseRenderingPlugin : MonoBehaviour
 #endif
     private static extern IntPtr GetRenderEventFunc();
 
+    // Number of threads the plugin uses to fill the texture, including the render thread.
+    // 0 means one per CPU core.
+#if (PLATFORM_IOS || PLATFORM_TVOS || PLATFORM_BRATWURST || PLATFORM_SWITCH) && !UNITY_EDITOR
+    [DllImport("__Internal")]
+#else
+    [DllImport("RenderingPlugin")]
+#endif
+    private static extern void SetWorkerThreadCountFromUnity(int threadCount);
+
+    // With 2 or more, the plugin generates the texture on worker threads into that many buffers
+    // ahead of time, and only uploads it during the render event. GetTextureFramesBehind tells
+    // how many frames old the shown texture is.
+#if (PLATFORM_IOS || PLATFORM_TVOS || PLATFORM_BRATWURST || PLATFORM_SWITCH) && !UNITY_EDITOR
+    [DllImport("__Internal")]
+#else
+    [DllImport("RenderingPlugin")]
+#endif
+    private static extern void SetTextureRingDepthFromUnity(int ringDepth);
+
+#if (PLATFORM_IOS || PLATFORM_TVOS || PLATFORM_BRATWURST || PLATFORM_SWITCH) && !UNITY_EDITOR
+    [DllImport("__Internal")]
+#else
+    [DllImport("RenderingPlugin")]
+#endif
+    private static extern int GetTextureFramesBehind();
+
+    // Work the GPU does itself with compute shaders instead of the CPU (Vulkan only); 1 is the texture,
+    // 2 the mesh
+#if (PLATFORM_IOS || PLATFORM_TVOS || PLATFORM_BRATWURST || PLATFORM_SWITCH) && !UNITY_EDITOR
+    [DllImport("__Internal")]
+#else
+    [DllImport("RenderingPlugin")]
+#endif
+    private static extern void SetPluginComputeMode(int mode);
+
+    // Per stage timings of the plugin's work; must match PluginTimingStats in PluginProfiling.h.
+    const int PluginTimingStages = 16;
+    const int PluginTimingBuckets = 128;
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct PluginStageTiming
+    {
+        public ulong count;
+        public ulong totalNs;
+        public ulong minNs;
+        public ulong maxNs;
+        public ulong p50Ns;
+        public ulong p90Ns;
+        public ulong p99Ns;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = PluginTimingBuckets)]
+        public ulong[] histogram;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct PluginTimingStats
+    {
+        public int enabled;
+        public int stageCount;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = PluginTimingStages)]
+        public PluginStageTiming[] stages;
+    }
+
+#if (PLATFORM_IOS || PLATFORM_TVOS || PLATFORM_BRATWURST || PLATFORM_SWITCH) && !UNITY_EDITOR
+    [DllImport("__Internal")]
+#else
+    [DllImport("RenderingPlugin")]
+#endif
+    private static extern void SetPluginTimingEnabled(int enabled);
+
+#if (PLATFORM_IOS || PLATFORM_TVOS || PLATFORM_BRATWURST || PLATFORM_SWITCH) && !UNITY_EDITOR
+    [DllImport("__Internal")]
+#else
+    [DllImport("RenderingPlugin")]
+#endif
+    private static extern void GetPluginTimingStats(ref PluginTimingStats stats);
+
+#if (PLATFORM_IOS || PLATFORM_TVOS || PLATFORM_BRATWURST || PLATFORM_SWITCH) && !UNITY_EDITOR
+    [DllImport("__Internal")]
+#else
+    [DllImport("RenderingPlugin")]
+#endif
+    private static extern void ResetPluginTimingStats();
+
+#if (PLATFORM_IOS || PLATFORM_TVOS || PLATFORM_BRATWURST || PLATFORM_SWITCH) && !UNITY_EDITOR
+    [DllImport("__Internal")]
+#else
+    [DllImport("RenderingPlugin")]
+#endif
+    private static extern IntPtr GetPluginTimingStageName(int stage);
+
+    // Records what the plugin does on each thread; WritePluginTrace writes the events recorded so far
+    // as a Chrome trace event JSON file (chrome://tracing or https://ui.perfetto.dev).
+#if (PLATFORM_IOS || PLATFORM_TVOS || PLATFORM_BRATWURST || PLATFORM_SWITCH) && !UNITY_EDITOR
+    [DllImport("__Internal")]
+#else
+    [DllImport("RenderingPlugin")]
+#endif
+    private static extern void SetPluginTracingEnabled(int enabled);
+
+#if (PLATFORM_IOS || PLATFORM_TVOS || PLATFORM_BRATWURST || PLATFORM_SWITCH) && !UNITY_EDITOR
+    [DllImport("__Internal")]
+#else
+    [DllImport("RenderingPlugin")]
+#endif
+    private static extern int WritePluginTrace(string path);
+
+    // Directory where the plugin keeps compiled pipelines / shader programs between runs. To write them before
+    // shutdown, issue plugin event 4 and call SavePluginCaches, which waits for it.
+#if (PLATFORM_IOS || PLATFORM_TVOS || PLATFORM_BRATWURST || PLATFORM_SWITCH) && !UNITY_EDITOR
+    [DllImport("__Internal")]
+#else
+    [DllImport("RenderingPlugin")]
+#endif
+    private static extern void SetPluginCacheDirectory(string directory);
+
+#if (PLATFORM_IOS || PLATFORM_TVOS || PLATFORM_BRATWURST || PLATFORM_SWITCH) && !UNITY_EDITOR
+    [DllImport("__Internal")]
+#else
+    [DllImport("RenderingPlugin")]
+#endif
+    private static extern int SavePluginCaches();
+
+    // Device memory the plugin sub-allocates (Vulkan); must match PluginMemoryStats in RenderAPI.h.
+    [StructLayout(LayoutKind.Sequential)]
+    struct PluginMemoryStats
+    {
+        public ulong blockCount;
+        public ulong blockBytes;
+        public ulong allocationCount;
+        public ulong usedBytes;
+        public ulong requestedBytes;
+        public ulong freeRangeCount;
+        public ulong largestFreeRange;
+        public ulong dedicatedCount;
+        public ulong dedicatedBytes;
+    }
+
+#if (PLATFORM_IOS || PLATFORM_TVOS || PLATFORM_BRATWURST || PLATFORM_SWITCH) && !UNITY_EDITOR
+    [DllImport("__Internal")]
+#else
+    [DllImport("RenderingPlugin")]
+#endif
+    private static extern int GetPluginMemoryStats(ref PluginMemoryStats stats);
+
 #if PLATFORM_SWITCH && !UNITY_EDITOR
     [DllImport("__Internal")]
     private static extern void RegisterPlugin();
@@ -95,6 +239,30 @@ public class UseRenderingPlugin : MonoBehaviour
     private void SetRenderTexture(IntPtr rb) { }
 #endif
 
+    // Passed to the plugin on start; 0 means one thread per CPU core
+    public int pluginWorkerThreads = 0;
+
+    // Passed to the plugin on start; 0 generates the texture in the render event
+    public int textureRingDepth = 0;
+
+    // On Vulkan, have a compute shader write the texture on the GPU (it is then a random write
+    // RenderTexture); the CPU fills it otherwise
+    public bool generateTextureOnGpu = false;
+
+    // On Vulkan, have a compute shader move the mesh vertices on the GPU (the vertex buffer is then also
+    // a raw buffer); the CPU writes them otherwise
+    public bool deformMeshOnGpu = false;
+
+    // Have the plugin time its work, and log the timings every few seconds
+    public bool logPluginTimings = false;
+
+    // Have the plugin record a trace, and write it to pluginTracePath when disabled
+    public bool recordPluginTrace = false;
+    public string pluginTracePath = "RenderingPluginTrace.json";
+
+    // Have the plugin keep compiled pipelines / shader programs in Application.temporaryCachePath
+    public bool usePluginCaches = false;
+
     IEnumerator Start()
     {
 #if PLATFORM_SWITCH && !UNITY_EDITOR
@@ -106,6 +274,13 @@ public class UseRenderingPlugin : MonoBehaviour
             CreateRenderTexture();
         }
 
+        SetWorkerThreadCountFromUnity(pluginWorkerThreads);
+        SetTextureRingDepthFromUnity(textureRingDepth);
+        SetPluginComputeMode((generateTextureOnGpu ? 1 : 0) | (deformMeshOnGpu ? 2 : 0));
+        SetPluginTimingEnabled(logPluginTimings ? 1 : 0);
+        SetPluginTracingEnabled(recordPluginTrace ? 1 : 0);
+        if (usePluginCaches)
+            SetPluginCacheDirectory(Application.temporaryCachePath);
         CreateTextureAndPassToPlugin();
         SendMeshBuffersToPlugin();
         yield return StartCoroutine("CallPluginAtEndOfFrames");
@@ -113,6 +288,21 @@ public class UseRenderingPlugin : MonoBehaviour
 
     void OnDisable()
     {
+        if (recordPluginTrace)
+        {
+            SetPluginTracingEnabled(0);
+            if (WritePluginTrace(pluginTracePath) == 0)
+                Debug.LogWarning("Failed to write plugin trace to " + pluginTracePath);
+        }
+
+        // The caches are written on the render thread (eventID == 4); SavePluginCaches waits for that
+        if (usePluginCaches)
+        {
+            GL.IssuePluginEvent(GetRenderEventFunc(), 4);
+            if (SavePluginCaches() == 0)
+                Debug.LogWarning("Failed to write plugin caches to " + Application.temporaryCachePath);
+        }
+
         if (SystemInfo.graphicsDeviceType == GraphicsDeviceType.Direct3D12)
         {
             // Signals the plugin that renderTex will be destroyed
@@ -122,6 +312,18 @@ public class UseRenderingPlugin : MonoBehaviour
 
     private void CreateTextureAndPassToPlugin()
     {
+        if (generateTextureOnGpu && SystemInfo.graphicsDeviceType == GraphicsDeviceType.Vulkan)
+        {
+            // Written by the plugin's compute shader, which needs storage image access
+            RenderTexture rt = new RenderTexture(256, 256, 0, RenderTextureFormat.ARGB32, RenderTextureReadWrite.Linear);
+            rt.enableRandomWrite = true;
+            rt.filterMode = FilterMode.Point;
+            rt.Create();
+            GetComponent<Renderer>().material.mainTexture = rt;
+            SetTextureFromUnity(rt.GetNativeTexturePtr(), rt.width, rt.height);
+            return;
+        }
+
         // Create a texture
         Texture2D tex = new Texture2D(256, 256, TextureFormat.ARGB32, false);
         // Set point filtering just so we can see the pixels clearly
@@ -150,6 +352,10 @@ public class UseRenderingPlugin : MonoBehaviour
             new VertexAttributeDescriptor(VertexAttribute.TexCoord0, VertexAttributeFormat.Float32, 2)
         };
 
+        // The plugin's compute shader writes the vertex buffer as a storage buffer
+        if (deformMeshOnGpu)
+            mesh.vertexBufferTarget |= GraphicsBuffer.Target.Raw;
+
         // Let's be certain we'll get the vertex buffer layout we want in native code
         mesh.SetVertexBufferParams(mesh.vertexCount, desiredVertexLayout);
 
@@ -177,6 +383,32 @@ public class UseRenderingPlugin : MonoBehaviour
         gcUV.Free();
     }
 
+    private void LogPluginTimings()
+    {
+        PluginTimingStats stats = new PluginTimingStats();
+        GetPluginTimingStats(ref stats);
+        ResetPluginTimingStats();
+
+        System.Text.StringBuilder log = new System.Text.StringBuilder("Plugin timings (us):\n");
+        for (int i = 0; i < stats.stageCount && i < PluginTimingStages; ++i)
+        {
+            PluginStageTiming stage = stats.stages[i];
+            if (stage.count == 0)
+                continue;
+            log.AppendFormat("{0}: n={1} mean={2:F1} p50={3:F1} p99={4:F1} max={5:F1}\n",
+                Marshal.PtrToStringAnsi(GetPluginTimingStageName(i)), stage.count,
+                stage.totalNs / 1000.0 / stage.count, stage.p50Ns / 1000.0, stage.p99Ns / 1000.0, stage.maxNs / 1000.0);
+        }
+        PluginMemoryStats memory = new PluginMemoryStats();
+        if (GetPluginMemoryStats(ref memory) != 0)
+        {
+            log.AppendFormat("Memory: {0} blocks ({1} KB), {2} allocations using {3} KB for {4} KB requested, {5} free ranges (largest {6} KB), {7} dedicated ({8} KB)\n",
+                memory.blockCount, memory.blockBytes / 1024, memory.allocationCount, memory.usedBytes / 1024, memory.requestedBytes / 1024,
+                memory.freeRangeCount, memory.largestFreeRange / 1024, memory.dedicatedCount, memory.dedicatedBytes / 1024);
+        }
+        Debug.Log(log.ToString());
+    }
+
     // custom "time" for deterministic results
     int updateTimeCounter = 0;
 
@@ -204,10 +436,20 @@ public class UseRenderingPlugin : MonoBehaviour
             // and eventID == 2 means the callback is called from the submission thread
             GL.IssuePluginEvent(GetRenderEventFunc(), 1);
 
+            // On Vulkan the texture and vertex buffer updates of event 1 are only queued; eventID == 3
+            // records them all at once, outside of a render pass
+            if (SystemInfo.graphicsDeviceType == GraphicsDeviceType.Vulkan)
+            {
+                GL.IssuePluginEvent(GetRenderEventFunc(), 3);
+            }
+
             if (SystemInfo.graphicsDeviceType == GraphicsDeviceType.Direct3D12)
             {
                 GL.IssuePluginEvent(GetRenderEventFunc(), 2);
             }
+
+            if (logPluginTimings && Time.frameCount % 300 == 0)
+                LogPluginTimings();
         }
     }
 }